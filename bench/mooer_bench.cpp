@@ -0,0 +1,144 @@
+// Microbenchmarks for the protocol, audio and transfer code in mooer_core.
+// Prints one JSON document so results can be diffed between releases:
+//   mooer_bench [--filter <substring>] [--min-time <seconds>] [--out <file.json>]
+
+#include "audio_utils.h"
+#include "emulated_pedal.h"
+#include "protocol.h"
+#include "usb_device.h"
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double bytesPerOp;
+};
+
+// Runs `fn` in growing batches until a batch takes at least `minTime`
+Result measure(const std::string& name, double bytesPerOp, double minTime, const std::function<void()>& fn) {
+    fn(); // Warm up caches and lazy allocations
+    uint64_t iterations = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; i++) fn();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= minTime || iterations >= (1ULL << 30)) {
+            return {name, iterations, elapsed * 1e9 / iterations, bytesPerOp};
+        }
+        double scale = elapsed > 0 ? std::min(100.0, 1.5 * minTime / elapsed) : 100.0;
+        iterations = std::max<uint64_t>(iterations + 1, static_cast<uint64_t>(iterations * scale));
+    }
+}
+
+// Keeps results alive so the optimiser can't drop the work
+volatile uint64_t sink;
+
+std::vector<int32_t> testSignal(int frames) {
+    std::vector<int32_t> samples(frames * 2);
+    for (int i = 0; i < frames; i++) {
+        int32_t v = static_cast<int32_t>(std::sin(i * 0.01) * 0.8 * 2147483647.0) & ~0xFF;
+        samples[2 * i] = v;
+        samples[2 * i + 1] = -v;
+    }
+    return samples;
+}
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string outPath;
+    double minTime = 0.2;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+        else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) minTime = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc) outPath = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--filter <substring>] [--min-time <seconds>] [--out <file.json>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    auto run = [&](const std::string& name, double bytes, const std::function<void()>& fn) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+        results.push_back(measure(name, bytes, minTime, fn));
+        fprintf(stderr, "%-32s %12.1f ns/op\n", name.c_str(), results.back().nsPerOp);
+    };
+
+    // Protocol
+    QByteArray crcInput = Protocol::createDownloadCommand(3, 42).mid(3, 9);
+    run("crc16/9B", crcInput.size(), [&]() { sink = Protocol::calculateCRC16(crcInput); });
+    QByteArray crcChunk(1024, 0x5A);
+    run("crc16/1KB", crcChunk.size(), [&]() { sink = Protocol::calculateCRC16(crcChunk); });
+
+    run("command/download", 64, [&]() { sink = Protocol::createDownloadCommand(7, 1234).size(); });
+    run("command/upload", 64, [&]() { sink = Protocol::createUploadCommand(7, 1234).size(); });
+    run("command/delete", 64, [&]() { sink = Protocol::createDeleteCommand(7).size(); });
+    run("command/init_upload", 64, [&]() { sink = Protocol::createInitUploadCommand().size(); });
+    run("command/play", 64, [&]() { sink = Protocol::createPlayCommand(7).size(); });
+
+    // Audio conversion: one second of stereo audio
+    std::vector<int32_t> second = testSignal(44100);
+    QByteArray packed = Protocol::encodeAudioData(second);
+    run("encodeAudioData/1s", packed.size(), [&]() { sink = Protocol::encodeAudioData(second).size(); });
+    run("parseAudioData/1s", packed.size(), [&]() { sink = Protocol::parseAudioData(packed, false).size(); });
+
+    // WAV I/O: ten seconds through the filesystem
+    QTemporaryDir tmp;
+    std::string wavPath = QDir(tmp.path()).filePath("bench.wav").toStdString();
+    std::vector<int32_t> tenSeconds = testSignal(441000);
+    double wavBytes = tenSeconds.size() * 4.0;
+    run("saveWavFile/10s", wavBytes, [&]() { sink = AudioUtils::saveWavFile(wavPath, tenSeconds); });
+    run("loadWavFile/10s", wavBytes, [&]() { sink = AudioUtils::loadWavFile(wavPath).size(); });
+
+    // Transfer engine against the emulated pedal (no latency): protocol overhead per track
+    {
+        EmulatedPedal::Options options;
+        options.tracks = 1;
+        options.trackSeconds = 5.0;
+        USBDevice device;
+        device.attach(std::make_unique<EmulatedPedal>(options), EmulatedPedal::serial());
+        double trackBytes = 5.0 * 44100 * 6;
+        run("transfer/download_5s", trackBytes, [&]() { sink = device.downloadTrackRaw(0).size(); });
+        QByteArray track = device.downloadTrackRaw(0);
+        run("transfer/upload_5s", trackBytes, [&]() { device.uploadTrackRaw(1, track); });
+        run("transfer/list", 0, [&]() { sink = device.listTracks().size(); });
+    }
+
+    QByteArray json = "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        double mbps = r.bytesPerOp > 0 ? r.bytesPerOp / r.nsPerOp * 1e9 / (1024.0 * 1024.0) : 0.0;
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"mb_per_s\": %.2f}%s\n",
+                 r.name.c_str(), (unsigned long long)r.iterations, r.nsPerOp, mbps, i + 1 < results.size() ? "," : "");
+        json += line;
+    }
+    json += "  ]\n}\n";
+
+    if (outPath.empty()) {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    } else {
+        QFile out(QString::fromStdString(outPath));
+        if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size()) {
+            fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
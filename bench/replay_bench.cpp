@@ -0,0 +1,114 @@
+// Replays a MOOER_USB_TRACE capture against the current transfer engine.
+// Each traced operation is re-run through USBDevice on a ReplayTransport that answers with
+// the recorded payloads and original per-transfer latencies, so the difference to the
+// recorded time is the engine's own overhead (or savings). The pedal's settle waits are
+// skipped and reported on their own; the diff compares against the recorded time less them.
+//
+// Usage: replay_bench <trace.mtrace>
+
+#include "usb_device.h"
+#include "usb_trace.h"
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+struct TracedOp {
+    QStringList words;
+    uint64_t recordedUs = 0; // Marker to end of its last transfer
+    int dataReads = 0;       // Reads on the data endpoint, bounds early-stopped streams
+};
+
+std::vector<TracedOp> collectOps(const std::vector<TraceRecord>& records) {
+    std::vector<TracedOp> ops;
+    uint64_t opStart = 0;
+    for (const TraceRecord& r : records) {
+        if (r.kind == TraceRecord::Marker) {
+            TracedOp op;
+            op.words = QString::fromUtf8(r.payload).split(' ', Qt::SkipEmptyParts);
+            ops.push_back(op);
+            opStart = r.startUs;
+        } else if (!ops.empty()) {
+            ops.back().recordedUs = r.startUs + r.durationUs - opStart;
+            if (r.endpoint == Protocol::EP_IN_DATA) ops.back().dataReads++;
+        }
+    }
+    return ops;
+}
+
+void runOp(USBDevice& device, const TracedOp& op) {
+    const QString& name = op.words.value(0);
+    int slot = op.words.value(1).toInt();
+
+    if (name == "list") {
+        device.listTracks();
+    } else if (name == "delete") {
+        device.deleteTrack(slot);
+    } else if (name == "play") {
+        device.playTrack(slot);
+    } else if (name == "stop") {
+        device.stopPlayback(slot);
+    } else if (name == "read") {
+        // Header read + as many chunks as the original session fetched before stopping
+        int chunksLeft = op.dataReads - 1;
+        std::atomic<bool> stop(chunksLeft <= 0);
+        device.readTrackChunks(slot, [&](int, int, const QByteArray&) {
+            if (--chunksLeft <= 0) stop = true;
+            return true;
+        }, op.words.value(2).toInt(), &stop);
+    } else if (name == "upload") {
+        uint32_t size = op.words.value(2).toUInt();
+        QByteArray chunk(1024, 0);
+        device.uploadTrackChunks(slot, size, [&]() { return chunk; });
+    }
+}
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trace.mtrace>\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<TraceRecord> records;
+    if (!UsbTrace::read(QString::fromLocal8Bit(argv[1]), records)) {
+        fprintf(stderr, "Cannot read trace %s\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<TracedOp> ops = collectOps(records);
+    auto* replay = new ReplayTransport(records);
+    USBDevice device;
+    device.attach(std::unique_ptr<Transport>(replay), "REPLAY");
+
+    printf("%-24s %12s %12s %12s %9s\n", "operation", "recorded ms", "settle ms", "replayed ms", "diff");
+    double totalRecorded = 0, totalSettled = 0, totalReplayed = 0;
+    for (const TracedOp& op : ops) {
+        auto settledBefore = replay->settled();
+        auto start = std::chrono::steady_clock::now();
+        try {
+            runOp(device, op);
+        } catch (const std::exception& e) {
+            fprintf(stderr, "%s: %s\n", op.words.join(' ').toUtf8().constData(), e.what());
+        }
+        double replayed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        double settled = std::chrono::duration<double, std::milli>(replay->settled() - settledBefore).count();
+        double recorded = op.recordedUs / 1000.0;
+        totalRecorded += recorded;
+        totalSettled += settled;
+        totalReplayed += replayed;
+
+        double recordedIo = recorded - settled;
+        printf("%-24s %12.1f %12.1f %12.1f %+8.1f%%\n", op.words.join(' ').toUtf8().constData(), recorded, settled,
+               replayed, recordedIo > 0 ? (replayed - recordedIo) / recordedIo * 100.0 : 0.0);
+    }
+
+    double totalRecordedIo = totalRecorded - totalSettled;
+    printf("%-24s %12.1f %12.1f %12.1f %+8.1f%%\n", "total", totalRecorded, totalSettled, totalReplayed,
+           totalRecordedIo > 0 ? (totalReplayed - totalRecordedIo) / totalRecordedIo * 100.0 : 0.0);
+    printf("command mismatches: %llu, unmatched transfers: %llu\n",
+           (unsigned long long)replay->mismatches(), (unsigned long long)replay->missing());
+    return replay->missing() > 0 ? 1 : 0;
+}
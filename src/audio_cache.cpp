@@ -0,0 +1,148 @@
+#include "audio_cache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <iostream>
+
+namespace {
+// Bump when the conversion pipeline changes so stale blobs are never reused
+const char* CACHE_VERSION = "v2";
+}
+
+AudioCache::AudioCache(const QString& dir, qint64 maxBytes) : cacheDir(dir), maxBytes(maxBytes) {
+    if (cacheDir.isEmpty()) {
+        cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/converted";
+    }
+    if (this->maxBytes <= 0) {
+        qint64 maxMB = QSettings().value("audioCacheMaxMB", DEFAULT_MAX_BYTES / (1024 * 1024)).toLongLong();
+        this->maxBytes = maxMB * 1024 * 1024;
+    }
+    QDir().mkpath(cacheDir);
+}
+
+QString AudioCache::refPath(const QString& sourcePath) const {
+    QFileInfo info(sourcePath);
+    if (!info.exists()) return QString();
+
+    QByteArray key = QString("%1|%2|%3|%4")
+        .arg(CACHE_VERSION)
+        .arg(info.absoluteFilePath())
+        .arg(info.size())
+        .arg(info.lastModified().toMSecsSinceEpoch())
+        .toUtf8();
+    return cacheDir + "/" + QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex() + ".ref";
+}
+
+QString AudioCache::blobPath(const QString& contentHash) const {
+    return cacheDir + "/" + contentHash + ".pcm24";
+}
+
+QString AudioCache::contentHash(const QString& sourcePath) const {
+    QFile file(sourcePath);
+    if (!file.open(QIODevice::ReadOnly)) return QString();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray(CACHE_VERSION));
+    if (!hash.addData(&file)) return QString();
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+void AudioCache::writeRef(const QString& ref, const QString& hash) const {
+    QSaveFile out(ref);
+    if (out.open(QIODevice::WriteOnly)) {
+        out.write(hash.toLatin1());
+        out.commit();
+    }
+}
+
+AudioCache::Blob AudioCache::lookup(const std::string& sourcePath) {
+    QString source = QString::fromStdString(sourcePath);
+    QString ref = refPath(source);
+    if (ref.isEmpty()) return Blob();
+
+    QString hash;
+    QFile refFile(ref);
+    if (refFile.open(QIODevice::ReadOnly)) {
+        hash = QString::fromLatin1(refFile.readAll()).trimmed();
+    }
+
+    if (hash.isEmpty() || !QFile::exists(blobPath(hash))) {
+        // Same content may already be cached under another path or an older mtime
+        hash = contentHash(source);
+        pendingRef = ref;
+        pendingHash = hash;
+        if (hash.isEmpty() || !QFile::exists(blobPath(hash))) return Blob();
+        writeRef(ref, hash);
+    }
+
+    // Refresh the mtime; eviction drops the least recently used blobs first
+    QString path = blobPath(hash);
+    QFile touch(path);
+    if (touch.open(QIODevice::Append)) {
+        touch.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+
+    return MappedFile::open(path);
+}
+
+bool AudioCache::store(const std::string& sourcePath, const QByteArray& packed) {
+    if (packed.isEmpty() || packed.size() > maxBytes) return false;
+
+    QString source = QString::fromStdString(sourcePath);
+    QString ref = refPath(source);
+    if (ref.isEmpty()) return false;
+
+    // lookup() already hashed the file on a miss
+    QString hash = (ref == pendingRef) ? pendingHash : contentHash(source);
+    if (hash.isEmpty()) return false;
+
+    QSaveFile out(blobPath(hash));
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    if (out.write(packed) != packed.size() || !out.commit()) {
+        std::cerr << "Failed to write audio cache entry " << blobPath(hash).toStdString() << std::endl;
+        return false;
+    }
+    writeRef(ref, hash);
+
+    evict();
+    return true;
+}
+
+void AudioCache::evict() {
+    QDir dir(cacheDir);
+    QFileInfoList blobs = dir.entryInfoList({"*.pcm24"}, QDir::Files, QDir::Time | QDir::Reversed);
+
+    qint64 total = 0;
+    for (const QFileInfo& info : blobs) total += info.size();
+
+    // Oldest first
+    bool removed = false;
+    for (const QFileInfo& info : blobs) {
+        if (total <= maxBytes) break;
+        if (QFile::remove(info.absoluteFilePath())) {
+            total -= info.size();
+            removed = true;
+        }
+    }
+    if (!removed) return;
+
+    // Drop refs that point at evicted blobs
+    for (const QFileInfo& info : dir.entryInfoList({"*.ref"}, QDir::Files)) {
+        QFile refFile(info.absoluteFilePath());
+        if (!refFile.open(QIODevice::ReadOnly)) continue;
+        QString hash = QString::fromLatin1(refFile.readAll()).trimmed();
+        refFile.close();
+        if (!QFile::exists(blobPath(hash))) QFile::remove(info.absoluteFilePath());
+    }
+}
+
+void AudioCache::clear() {
+    QDir dir(cacheDir);
+    for (const QFileInfo& info : dir.entryInfoList({"*.pcm24", "*.ref"}, QDir::Files)) {
+        QFile::remove(info.absoluteFilePath());
+    }
+}
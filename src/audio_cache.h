@@ -0,0 +1,40 @@
+#ifndef AUDIO_CACHE_H
+#define AUDIO_CACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <string>
+#include "mapped_file.h"
+
+// On-disk cache of device-ready (packed 24-bit stereo) conversions of source audio files.
+// Entries are found by source path + size + mtime, and deduplicated by content hash, so the
+// same file dropped on another slot or pedal skips decoding, resampling and encoding.
+class AudioCache {
+public:
+    static const qint64 DEFAULT_MAX_BYTES = 1024LL * 1024 * 1024;
+
+    using Blob = MappedFile;
+
+    // Empty dir = <cache location>/converted; maxBytes <= 0 reads the "audioCacheMaxMB" setting
+    explicit AudioCache(const QString& dir = QString(), qint64 maxBytes = 0);
+
+    Blob lookup(const std::string& sourcePath);
+    bool store(const std::string& sourcePath, const QByteArray& packed);
+    void clear();
+
+    QString directory() const { return cacheDir; }
+
+private:
+    QString cacheDir;
+    qint64 maxBytes;
+    QString pendingRef;  // Content hash computed by a missed lookup, reused by store()
+    QString pendingHash;
+
+    QString refPath(const QString& sourcePath) const;
+    QString blobPath(const QString& contentHash) const;
+    QString contentHash(const QString& sourcePath) const;
+    void writeRef(const QString& ref, const QString& hash) const;
+    void evict();
+};
+
+#endif // AUDIO_CACHE_H
@@ -0,0 +1,166 @@
+#include "audio_settings_dialog.h"
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QGroupBox>
+#include <QMessageBox>
+#include <QVBoxLayout>
+#include <stdexcept>
+
+AudioSettingsDialog::AudioSettingsDialog(QWidget* parent) : QDialog(parent) {
+    setWindowTitle("Audio Output");
+
+    try {
+        devices = Playback::outputDevices();
+    } catch (const std::exception& e) {
+        QMessageBox::warning(this, "Audio Output", QString("Could not list audio devices: %1").arg(e.what()));
+    }
+    AudioOutputSettings settings = AudioOutputSettings::load();
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    QFormLayout* form = new QFormLayout();
+
+    hostApiCombo = new QComboBox();
+    hostApiCombo->addItem("Default", QString());
+    for (const AudioOutputDevice& d : devices) {
+        QString api = QString::fromStdString(d.hostApi);
+        if (hostApiCombo->findData(api) < 0) hostApiCombo->addItem(api, api);
+    }
+    int apiIndex = hostApiCombo->findData(QString::fromStdString(settings.hostApi));
+    hostApiCombo->setCurrentIndex(apiIndex >= 0 ? apiIndex : 0);
+    form->addRow("Host API:", hostApiCombo);
+
+    deviceCombo = new QComboBox();
+    deviceCombo->setMinimumWidth(320);
+    form->addRow("Device:", deviceCombo);
+
+    deviceLabel = new QLabel();
+    deviceLabel->setWordWrap(true);
+    form->addRow(QString(), deviceLabel);
+
+    bufferSpin = new QSpinBox();
+    bufferSpin->setRange(0, 8192);
+    bufferSpin->setSingleStep(64);
+    bufferSpin->setSuffix(" frames");
+    bufferSpin->setSpecialValueText("Chosen by the host API");
+    bufferSpin->setValue(settings.framesPerBuffer);
+    bufferSpin->setToolTip("Frames per buffer. Smaller buffers lower latency but underrun more easily.");
+    form->addRow("Buffer size:", bufferSpin);
+
+    latencySpin = new QDoubleSpinBox();
+    latencySpin->setRange(0.0, 1000.0);
+    latencySpin->setDecimals(1);
+    latencySpin->setSuffix(" ms");
+    latencySpin->setSpecialValueText("Device default (low latency)");
+    latencySpin->setValue(settings.latencyMs);
+    latencySpin->setToolTip("Suggested output latency; the host API may round it");
+    form->addRow("Latency:", latencySpin);
+
+    exclusiveCheck = new QCheckBox("Exclusive mode");
+    exclusiveCheck->setChecked(settings.exclusive);
+    exclusiveCheck->setToolTip("Take the device for this app alone, skipping the system mixer and its resampling (WASAPI only)");
+    form->addRow(QString(), exclusiveCheck);
+    layout->addLayout(form);
+
+    QGroupBox* streamBox = new QGroupBox("Last playback stream");
+    QVBoxLayout* streamLayout = new QVBoxLayout(streamBox);
+    streamLabel = new QLabel();
+    streamLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    streamLayout->addWidget(streamLabel);
+    layout->addWidget(streamBox);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, this, &AudioSettingsDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    layout->addWidget(buttons);
+
+    connect(hostApiCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &AudioSettingsDialog::onHostApiChanged);
+    connect(deviceCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &AudioSettingsDialog::onDeviceChanged);
+    onHostApiChanged();
+    for (int i = 0; i < deviceCombo->count(); i++) {
+        int index = deviceCombo->itemData(i).toInt();
+        if (index >= 0 && devices[index].name == settings.device) {
+            deviceCombo->setCurrentIndex(i);
+            break;
+        }
+    }
+
+    connect(&refreshTimer, &QTimer::timeout, this, &AudioSettingsDialog::refreshStream);
+    refreshTimer.start(1000);
+    refreshStream();
+}
+
+const AudioOutputDevice* AudioSettingsDialog::selectedDevice() const {
+    int index = deviceCombo->currentData().toInt();
+    if (index >= 0 && index < (int)devices.size()) return &devices[index];
+    // The default output: the system default, shown for its details
+    QString api = hostApiCombo->currentData().toString();
+    for (const AudioOutputDevice& d : devices) {
+        if (d.isDefault && (api.isEmpty() || api == QString::fromStdString(d.hostApi))) return &d;
+    }
+    return nullptr;
+}
+
+void AudioSettingsDialog::onHostApiChanged() {
+    QString api = hostApiCombo->currentData().toString();
+    deviceCombo->blockSignals(true);
+    deviceCombo->clear();
+    deviceCombo->addItem("Default output", -1);
+    for (int i = 0; i < (int)devices.size(); i++) {
+        const AudioOutputDevice& d = devices[i];
+        if (!api.isEmpty() && api != QString::fromStdString(d.hostApi)) continue;
+        QString name = QString::fromStdString(d.name);
+        if (api.isEmpty()) name += QString(" (%1)").arg(QString::fromStdString(d.hostApi));
+        deviceCombo->addItem(name, i);
+    }
+    deviceCombo->blockSignals(false);
+    onDeviceChanged();
+}
+
+void AudioSettingsDialog::onDeviceChanged() {
+    const AudioOutputDevice* d = selectedDevice();
+    exclusiveCheck->setEnabled(d && d->supportsExclusive);
+    if (!d) {
+        deviceLabel->setText(devices.empty() ? "No output devices found." : QString());
+        return;
+    }
+
+    QString text = QString("Runs at %1 Hz by default, latency %2–%3 ms.")
+        .arg(d->defaultSampleRate, 0, 'f', 0)
+        .arg(d->lowLatencyMs, 0, 'f', 1)
+        .arg(d->highLatencyMs, 0, 'f', 1);
+    // Tracks are 44.1 kHz; anything else goes through a resampler
+    if (!d->supportsTrackRate) {
+        text += "\nCannot open at 44.1 kHz; playback will fail on this device.";
+    } else if (d->defaultSampleRate != 44100.0) {
+        text += "\nNot at 44.1 kHz by default: the host may resample, which adds latency.";
+    }
+    deviceLabel->setText(text);
+}
+
+void AudioSettingsDialog::refreshStream() {
+    AudioStreamReport r = Playback::lastStream();
+    if (!r.valid) {
+        streamLabel->setText("Nothing played yet.");
+        return;
+    }
+    // Device names are concatenated, not passed through arg(), so a '%' in them stays literal
+    QString text = QString(r.playing ? "Playing on " : "") + QString::fromStdString(r.device) + " — " +
+                   QString::fromStdString(r.hostApi) + (r.exclusive ? " (exclusive)" : " (shared)") + "\n";
+    QString buffer = r.framesPerBuffer > 0 ? QString("%1 frames").arg(r.framesPerBuffer) : QString("host-chosen buffer");
+    text += QString("%1 Hz, %2, output latency %3 ms").arg(r.sampleRate, 0, 'f', 0).arg(buffer).arg(r.outputLatencyMs, 0, 'f', 1);
+    if (!r.playing) text += " (stopped)";
+    text += QString("\nUnderruns: %1").arg(r.underflows);
+    streamLabel->setText(text);
+}
+
+void AudioSettingsDialog::accept() {
+    AudioOutputSettings settings;
+    settings.hostApi = hostApiCombo->currentData().toString().toStdString();
+    int index = deviceCombo->currentData().toInt();
+    if (index >= 0 && index < (int)devices.size()) settings.device = devices[index].name;
+    settings.framesPerBuffer = bufferSpin->value();
+    settings.latencyMs = latencySpin->value();
+    settings.exclusive = exclusiveCheck->isChecked();
+    AudioOutputSettings::save(settings);
+    QDialog::accept();
+}
@@ -0,0 +1,43 @@
+#ifndef AUDIO_SETTINGS_DIALOG_H
+#define AUDIO_SETTINGS_DIALOG_H
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialog>
+#include <QDoubleSpinBox>
+#include <QLabel>
+#include <QSpinBox>
+#include <QTimer>
+#include <vector>
+#include "playback.h"
+
+// Host API, output device, buffer size and latency for playback. Saved on OK and used from
+// the next playback on; the last stream's negotiated latency and underruns are shown live.
+class AudioSettingsDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit AudioSettingsDialog(QWidget* parent = nullptr);
+
+    void accept() override;
+
+private slots:
+    void onHostApiChanged();
+    void onDeviceChanged();
+    void refreshStream();
+
+private:
+    std::vector<AudioOutputDevice> devices;
+    QComboBox* hostApiCombo;
+    QComboBox* deviceCombo;  // Item data: index into `devices`, -1 for the default output
+    QSpinBox* bufferSpin;
+    QDoubleSpinBox* latencySpin;
+    QCheckBox* exclusiveCheck;
+    QLabel* deviceLabel;
+    QLabel* streamLabel;
+    QTimer refreshTimer;
+
+    const AudioOutputDevice* selectedDevice() const;
+};
+
+#endif // AUDIO_SETTINGS_DIALOG_H
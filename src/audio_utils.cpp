@@ -1,7 +1,11 @@
 #include "audio_utils.h"
+#include "trace_events.h"
+#include "flac_encoder.h"
+#include "protocol.h"
 #include <QAudioDecoder>
 #include <QAudioBuffer>
 #include <QAudioFormat>
+#include <QCryptographicHash>
 #include <QEventLoop>
 #include <QFileInfo>
 #include <QUrl>
@@ -30,6 +34,7 @@ struct WavHeader {
 #pragma pack(pop)
 
 std::vector<int32_t> AudioUtils::loadAudioFile(const std::string& filename) {
+    MOOER_TRACE_SCOPE("audio", "loadAudioFile");
     QString qFilename = QString::fromStdString(filename);
     
     // For WAV files, try the built-in parser first as it's faster and supports 44.1kHz directly
@@ -42,6 +47,7 @@ std::vector<int32_t> AudioUtils::loadAudioFile(const std::string& filename) {
         }
     }
 
+    MOOER_TRACE_SCOPE("audio", "QAudioDecoder");
     QAudioDecoder decoder;
     QAudioFormat format;
     format.setSampleRate(44100);
@@ -85,7 +91,7 @@ std::vector<int32_t> AudioUtils::loadAudioFile(const std::string& filename) {
     });
 
     QObject::connect(&decoder, &QAudioDecoder::finished, &loop, &QEventLoop::quit);
-    QObject::connect(&decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), [&](QAudioDecoder::Error error) {
+    QObject::connect(&decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), [&](QAudioDecoder::Error) {
         errorOccurred = true;
         errorMsg = decoder.errorString();
         loop.quit();
@@ -106,6 +112,7 @@ std::vector<int32_t> AudioUtils::loadAudioFile(const std::string& filename) {
 }
 
 std::vector<int32_t> AudioUtils::loadWavFile(const std::string& filename) {
+    MOOER_TRACE_SCOPE("audio", "loadWavFile");
     std::ifstream file(filename, std::ios::binary);
     if (!file.is_open()) throw std::runtime_error("Cannot open file");
 
@@ -142,9 +149,8 @@ std::vector<int32_t> AudioUtils::loadWavFile(const std::string& filename) {
             left = (int32_t)val << 8; 
         } else if (bytesPerSample == 3) {
             uint8_t* p = rawData.data() + offset;
-            left = (p[0] | (p[1] << 8) | (p[2] << 16));
-            left = (left << 8) >> 8; // Sign extend
-            // Already 24-bit.
+            // Into the top 24 bits, like Protocol::parseAudioData, so encodeAudioData's >> 8 is lossless
+            left = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
         } else if (bytesPerSample == 4) {
              if (header.format_type == 3) { // Float
                  float val = *(float*)(rawData.data() + offset);
@@ -170,8 +176,7 @@ std::vector<int32_t> AudioUtils::loadWavFile(const std::string& filename) {
                 right = (int32_t)val << 8;
             } else if (bytesPerSample == 3) {
                 uint8_t* p = rawData.data() + offset + chOffset;
-                right = (p[0] | (p[1] << 8) | (p[2] << 16));
-                right = (right << 8) >> 8;
+                right = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
             } else if (bytesPerSample == 4) {
                  if (header.format_type == 3) { // Float
                      float val = *(float*)(rawData.data() + offset + chOffset);
@@ -222,3 +227,65 @@ bool AudioUtils::saveWavFile(const std::string& filename, const std::vector<int3
 
     return true;
 }
+
+QByteArray AudioUtils::wav24Header(uint32_t dataSize) {
+    WavHeader header;
+    memcpy(header.riff, "RIFF", 4);
+    memcpy(header.wave, "WAVE", 4);
+    memcpy(header.fmt_chunk_marker, "fmt ", 4);
+    header.length_of_fmt = 16;
+    header.format_type = 1; // PCM
+    header.channels = 2;
+    header.sample_rate = 44100;
+    header.bits_per_sample = 24;
+    header.block_align = 3 * 2; // 24-bit * 2 channels
+    header.byterate = 44100 * header.block_align;
+    memcpy(header.data_chunk_header, "data", 4);
+    header.data_size = dataSize;
+    header.overall_size = header.data_size + 36;
+    return QByteArray(reinterpret_cast<const char*>(&header), sizeof(WavHeader));
+}
+
+bool AudioUtils::saveWav24File(const std::string& filename, const QByteArray& packed) {
+    MOOER_TRACE_SCOPE("audio", "saveWav24File", packed.size());
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    // Device bytes are already little-endian 24-bit L/R pairs, i.e. the WAV data chunk layout
+    uint32_t dataSize = (packed.size() / 6) * 6;
+
+    QByteArray header = wav24Header(dataSize);
+    file.write(header.constData(), header.size());
+    file.write(packed.constData(), dataSize);
+
+    return file.good();
+}
+
+bool AudioUtils::saveFlacFile(const std::string& filename, const QByteArray& packed, int threads) {
+    MOOER_TRACE_SCOPE("audio", "saveFlacFile", packed.size());
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    // STREAMINFO MD5 is defined over the interleaved little-endian samples, which is the packed stream itself
+    uint32_t dataSize = (packed.size() / 6) * 6;
+    QByteArray md5 = QCryptographicHash::hash(QByteArray::fromRawData(packed.constData(), dataSize), QCryptographicHash::Md5);
+
+    std::vector<uint8_t> encoded = FlacEncoder::encodePacked24(
+        reinterpret_cast<const uint8_t*>(packed.constData()), dataSize, 44100,
+        reinterpret_cast<const uint8_t*>(md5.constData()), threads);
+
+    file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    return file.good();
+}
+
+bool AudioUtils::savePackedAudio(const std::string& filename, const QByteArray& packed, OutputFormat format) {
+    switch (format) {
+    case Wav24:
+        return saveWav24File(filename, packed);
+    case Flac:
+        return saveFlacFile(filename, packed);
+    case Wav32:
+    default:
+        return saveWavFile(filename, Protocol::parseAudioData(packed, false));
+    }
+}
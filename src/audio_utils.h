@@ -4,9 +4,12 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <QByteArray>
 
 class AudioUtils {
 public:
+    enum OutputFormat { Wav24, Wav32, Flac };
+
     // Decodes any audio file supported by Qt and returns stereo interleaved 32-bit samples (44100 Hz)
     static std::vector<int32_t> loadAudioFile(const std::string& filename);
 
@@ -16,6 +19,18 @@ public:
     static std::vector<int32_t> loadWavFile(const std::string& filename);
 
     static bool saveWavFile(const std::string& filename, const std::vector<int32_t>& samples);
+
+    // 44-byte header for a 24-bit stereo 44.1 kHz WAV whose data chunk is `dataSize` packed bytes
+    static QByteArray wav24Header(uint32_t dataSize);
+
+    // Writes the device's packed 24-bit stereo stream as-is into a 24-bit PCM WAV
+    static bool saveWav24File(const std::string& filename, const QByteArray& packed);
+
+    // Encodes the packed stream to FLAC, splitting blocks across threads (0 = all cores)
+    static bool saveFlacFile(const std::string& filename, const QByteArray& packed, int threads = 0);
+
+    // Dispatches a packed device stream to the writer for `format`
+    static bool savePackedAudio(const std::string& filename, const QByteArray& packed, OutputFormat format);
 };
 
 #endif // AUDIO_UTILS_H
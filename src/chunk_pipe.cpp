@@ -0,0 +1,54 @@
+#include "chunk_pipe.h"
+
+ChunkPipe::ChunkPipe(size_t capacity)
+    : capacity(capacity ? capacity : 1), totalSize(0), sizeKnown(false), closed(false), aborted(false) {
+}
+
+void ChunkPipe::setTotalSize(uint32_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    totalSize = size;
+    sizeKnown = true;
+    notEmpty.notify_all();
+}
+
+bool ChunkPipe::waitTotalSize(uint32_t& size) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this]() { return sizeKnown || closed || aborted; });
+    if (!sizeKnown || aborted) return false;
+    size = totalSize;
+    return true;
+}
+
+bool ChunkPipe::push(const QByteArray& chunk) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this]() { return chunks.size() < capacity || closed || aborted; });
+    if (closed || aborted) return false;
+    chunks.push_back(chunk);
+    notEmpty.notify_one();
+    return true;
+}
+
+bool ChunkPipe::pop(QByteArray& chunk) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this]() { return !chunks.empty() || closed || aborted; });
+    if (aborted || chunks.empty()) return false;
+    chunk = chunks.front();
+    chunks.pop_front();
+    notFull.notify_one();
+    return true;
+}
+
+void ChunkPipe::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+}
+
+void ChunkPipe::abort() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = true;
+    chunks.clear();
+    notEmpty.notify_all();
+    notFull.notify_all();
+}
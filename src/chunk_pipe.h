@@ -0,0 +1,42 @@
+#ifndef CHUNK_PIPE_H
+#define CHUNK_PIPE_H
+
+#include <QByteArray>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// Bounded blocking queue of raw 1 KB chunks between a producer and a consumer thread.
+// The producer announces the track size first; either side can close the pipe.
+class ChunkPipe {
+public:
+    explicit ChunkPipe(size_t capacity = 64);
+
+    void setTotalSize(uint32_t size);
+    // Blocks until the size is known; false if the pipe was closed first
+    bool waitTotalSize(uint32_t& size);
+
+    // Blocks while full; false once the pipe is closed
+    bool push(const QByteArray& chunk);
+    // Blocks while empty; false once closed and drained
+    bool pop(QByteArray& chunk);
+
+    // Producer is done: queued chunks can still be popped
+    void close();
+    // Consumer gave up: wakes and fails both sides
+    void abort();
+
+private:
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<QByteArray> chunks;
+    size_t capacity;
+    uint32_t totalSize;
+    bool sizeKnown;
+    bool closed;
+    bool aborted;
+};
+
+#endif // CHUNK_PIPE_H
@@ -0,0 +1,481 @@
+// mooer-cli: headless client for scripted transfers.
+// No widgets and no QApplication; a QCoreApplication is only created when an upload has
+// to go through QAudioDecoder or mooerd is running, and PortAudio is only initialised by `play`.
+// While mooerd holds the pedals, transfers are sent to it instead of opening the device.
+
+#include "usb_device.h"
+#include "operations.h"
+#include "playback.h"
+#include "audio_cache.h"
+#include "daemon_client.h"
+#include "link_profile.h"
+#include "metrics.h"
+#include "trace_events.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+std::atomic<bool> interrupted(false);
+
+struct Options {
+    bool json = false;
+    std::string device;   // Serial, or bus:address
+    AudioUtils::OutputFormat format = AudioUtils::Wav24;
+    double from = 0.0;
+    int volume = 100;
+    bool metrics = false;  // Dump this run's metrics to stderr at exit
+    bool quick = false;    // benchmark: round trips only
+    bool refresh = false;  // list: re-read the pedal even if mooerd has the list cached
+};
+
+void usage() {
+    fprintf(stderr,
+        "Usage: mooer-cli [--json] [--metrics] [--trace-events <file>] [--device <serial|bus:addr>] <command> [args]\n"
+        "\n"
+        "Commands:\n"
+        "  devices                       List connected pedals\n"
+        "  list                          List slots (--refresh: bypass mooerd's cached list)\n"
+        "  upload <slot> <file>          Convert and upload an audio file\n"
+        "  download <slot> <file>        Save a slot (--format wav24|wav32|flac)\n"
+        "  delete <slot>                 Delete a slot\n"
+        "  backup <dir>                  Save every occupied slot (--format ...)\n"
+        "  play <slot>                   Play a slot (--from <seconds>, --volume <0-100>)\n"
+        "  benchmark                     Measure the USB link and tune timeouts (--quick: latency only)\n"
+        "  metrics                       Print mooerd's metrics (text exposition format)\n");
+}
+
+// Prints progress with live throughput to stderr, at most a few times per second.
+// In JSON mode every line is a JSON object so scripts can follow along.
+class ProgressPrinter {
+public:
+    ProgressPrinter(const Options& options, const char* unit)
+        : json(options.json), unit(unit), tty(isatty(fileno(stderr))),
+          start(std::chrono::steady_clock::now()), last(start) {}
+
+    ~ProgressPrinter() {
+        if (printed && tty && !json) fputc('\n', stderr);
+    }
+
+    static void callback(size_t current, size_t total, void* userData) {
+        static_cast<ProgressPrinter*>(userData)->update(current, total);
+    }
+
+    void update(size_t current, size_t total) {
+        auto now = std::chrono::steady_clock::now();
+        bool done = total > 0 && current >= total;
+        if (!done && now - last < std::chrono::milliseconds(250)) return;
+        last = now;
+
+        double elapsed = std::chrono::duration<double>(now - start).count();
+        double rate = elapsed > 0 ? current / elapsed : 0.0;
+        double percent = total > 0 ? 100.0 * current / total : 0.0;
+
+        if (json) {
+            QJsonObject line{{"event", "progress"}, {"current", (double)current}, {"total", (double)total},
+                             {"rate", rate}, {"unit", unit}};
+            fprintf(stderr, "%s\n", QJsonDocument(line).toJson(QJsonDocument::Compact).constData());
+        } else if (std::strcmp(unit, "bytes") == 0) {
+            int eta = rate > 0 && total > current ? static_cast<int>((total - current) / rate + 0.5) : 0;
+            fprintf(stderr, "%s%5.1f%%  %.1f / %.1f MB  %.0f KB/s  ETA %d:%02d%s", tty ? "\r" : "", percent,
+                    current / 1048576.0, total / 1048576.0, rate / 1024.0, eta / 60, eta % 60, tty ? "  " : "\n");
+        } else {
+            fprintf(stderr, "%s%5.1f%%  %zu / %zu %s%s", tty ? "\r" : "", percent, current, total, unit, tty ? "  " : "\n");
+        }
+        fflush(stderr);
+        printed = true;
+    }
+
+private:
+    bool json;
+    const char* unit;
+    bool tty;
+    bool printed = false;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point last;
+};
+
+void printResult(const Options& options, const QJsonObject& result, const std::string& text) {
+    if (options.json) {
+        printf("%s\n", QJsonDocument(result).toJson(QJsonDocument::Compact).constData());
+    } else if (!text.empty()) {
+        printf("%s\n", text.c_str());
+    }
+}
+
+QJsonObject deviceJson(const DeviceInfo& d) {
+    return QJsonObject{{"name", QString::fromStdString(d.name)}, {"serial", QString::fromStdString(d.serial)},
+                       {"bus", d.bus}, {"address", d.address}, {"permission", d.hasPermission}};
+}
+
+bool openDevice(USBDevice& device, const Options& options) {
+    for (const DeviceInfo& d : USBDevice::enumerateDevices()) {
+        std::string busAddress = std::to_string(d.bus) + ":" + std::to_string(d.address);
+        if (!options.device.empty() && options.device != d.serial && options.device != busAddress) continue;
+        if (!d.hasPermission) {
+            std::cerr << "No permission to access " << d.name << " (" << busAddress << ")" << std::endl;
+            return false;
+        }
+        return device.connect(d.bus, d.address);
+    }
+    std::cerr << "No pedal found" << std::endl;
+    return false;
+}
+
+int parseSlot(const char* text) {
+    char* end = nullptr;
+    long slot = strtol(text, &end, 10);
+    if (!*text || *end || slot < 0 || slot >= Protocol::MAX_TRACKS) {
+        throw std::runtime_error(std::string("Invalid slot: ") + text);
+    }
+    return static_cast<int>(slot);
+}
+
+// Only files QAudioDecoder has to handle need an application instance; 44.1 kHz WAVs are
+// read by the built-in loader. The checks match the ones AudioUtils::loadWavFile rejects on,
+// so a file skipped here never falls back to the decoder.
+std::unique_ptr<QCoreApplication> appForDecoding(const std::string& file, int& argc, char** argv) {
+    if (QCoreApplication::instance()) return nullptr;
+    QFile in(QString::fromStdString(file));
+    if (QFileInfo(in).suffix().toLower() == "wav" && in.open(QIODevice::ReadOnly)) {
+        QByteArray header = in.read(28);
+        if (header.size() == 28 && header.startsWith("RIFF") && header.mid(8, 4) == "WAVE" &&
+            qFromLittleEndian<uint32_t>(reinterpret_cast<const uchar*>(header.constData() + 24)) == 44100) {
+            return nullptr;
+        }
+    }
+    return std::make_unique<QCoreApplication>(argc, argv);
+}
+
+int run(const Options& options, const std::vector<std::string>& args, int& argc, char** argv) {
+    const std::string& cmd = args[0];
+
+    if (cmd == "devices") {
+        QJsonArray list;
+        std::string text;
+        for (const DeviceInfo& d : USBDevice::enumerateDevices()) {
+            list.append(deviceJson(d));
+            text += d.name + "  serial=" + (d.serial.empty() ? "-" : d.serial) + "  usb=" +
+                    std::to_string(d.bus) + ":" + std::to_string(d.address) + (d.hasPermission ? "" : "  (no permission)") + "\n";
+        }
+        if (!text.empty()) text.pop_back();
+        printResult(options, QJsonObject{{"devices", list}}, text);
+        return 0;
+    }
+
+    if (cmd == "metrics") {
+        throw std::runtime_error("metrics reads a running mooerd; use --metrics to dump this run's metrics");
+    }
+
+    auto need = [&](size_t n) {
+        if (args.size() < n + 1) throw std::invalid_argument(cmd + " needs " + std::to_string(n) + " argument(s)");
+    };
+
+    USBDevice device;
+    if (!openDevice(device, options)) return 1;
+
+    if (cmd == "list") {
+        QJsonArray slots;
+        std::string text;
+        for (const TrackInfo& t : device.listTracks()) {
+            slots.append(QJsonObject{{"slot", t.slot}, {"has_track", t.has_track},
+                                     {"size", (double)t.size}, {"duration", t.duration}});
+            if (t.has_track) {
+                char line[96];
+                snprintf(line, sizeof(line), "%2d  %02d:%02d  %7.2f MB\n", t.slot,
+                         (int)t.duration / 60, (int)t.duration % 60, t.size / 1048576.0);
+                text += line;
+            }
+        }
+        if (!text.empty()) text.pop_back();
+        printResult(options, QJsonObject{{"slots", slots}}, text.empty() ? "No tracks" : text);
+    } else if (cmd == "upload") {
+        need(2);
+        int slot = parseSlot(args[1].c_str());
+        auto app = appForDecoding(args[2], argc, argv);
+        ProgressPrinter progress(options, "bytes");
+        Operations::upload(device, slot, args[2], ProgressPrinter::callback, &progress);
+        printResult(options, QJsonObject{{"uploaded", QString::fromStdString(args[2])}, {"slot", slot}},
+                    "Uploaded " + args[2] + " to slot " + std::to_string(slot));
+    } else if (cmd == "download") {
+        need(2);
+        int slot = parseSlot(args[1].c_str());
+        ProgressPrinter progress(options, "bytes");
+        Operations::download(device, slot, args[2], options.format, ProgressPrinter::callback, &progress);
+        printResult(options, QJsonObject{{"downloaded", QString::fromStdString(args[2])}, {"slot", slot}},
+                    "Saved slot " + std::to_string(slot) + " to " + args[2]);
+    } else if (cmd == "delete") {
+        need(1);
+        int slot = parseSlot(args[1].c_str());
+        Operations::remove(device, slot);
+        printResult(options, QJsonObject{{"deleted", slot}}, "Deleted slot " + std::to_string(slot));
+    } else if (cmd == "backup") {
+        need(1);
+        std::vector<std::string> files;
+        {
+            ProgressPrinter progress(options, "bytes");
+            files = Operations::backup(device, args[1], options.format, &interrupted, ProgressPrinter::callback, &progress);
+        }
+        QJsonArray list;
+        std::string text;
+        for (const auto& f : files) {
+            list.append(QString::fromStdString(f));
+            text += f + "\n";
+        }
+        if (!text.empty()) text.pop_back();
+        printResult(options, QJsonObject{{"files", list}}, text);
+        if (interrupted) return 130;
+    } else if (cmd == "play") {
+        need(1);
+        int slot = parseSlot(args[1].c_str());
+        uint32_t size = 0;
+        double duration = 0.0;
+        for (const TrackInfo& t : device.listTracks()) {
+            if (t.slot == slot && t.has_track) {
+                size = t.size;
+                duration = t.duration;
+            }
+        }
+        if (size == 0) throw std::runtime_error("Slot " + std::to_string(slot) + " is empty");
+
+        std::atomic<int> volume(options.volume);
+        try {
+            ProgressPrinter progress(options, "chunks");
+            Playback::play(device, slot, size, duration, options.from, interrupted, &volume,
+                           ProgressPrinter::callback, &progress);
+        } catch (...) {
+            Playback::terminate();
+            throw;
+        }
+        Playback::terminate();
+        AudioStreamReport stream = Playback::lastStream();
+        printResult(options, QJsonObject{{"played", slot}, {"stopped", interrupted.load()},
+                                         {"device", QString::fromStdString(stream.device)},
+                                         {"outputLatencyMs", stream.outputLatencyMs},
+                                         {"underflows", static_cast<qint64>(stream.underflows)}}, "");
+    } else if (cmd == "benchmark") {
+        LinkProfile profile;
+        {
+            ProgressPrinter progress(options, "steps");
+            profile = LinkProfile::measure(device, options.quick, ProgressPrinter::callback, &progress);
+        }
+        printResult(options, QJsonObject{{"rtt_median_us", profile.rttMedianUs}, {"rtt_p99_us", profile.rttP99Us},
+                                         {"download_chunks_per_sec", profile.downloadChunksPerSec},
+                                         {"upload_chunks_per_sec", profile.uploadChunksPerSec},
+                                         {"chunk_timeout_ms", profile.chunkTimeoutMs()},
+                                         {"pipeline_depth", (double)profile.pipelineDepth()}},
+                    profile.describe());
+    } else {
+        std::cerr << "Unknown command: " << cmd << std::endl;
+        usage();
+        return 2;
+    }
+    return 0;
+}
+
+// Same commands, executed by mooerd. Audio is converted and written here; only the
+// packed track bytes cross the socket (through shared memory).
+int runViaDaemon(const Options& options, const std::vector<std::string>& args, int& argc, char** argv) {
+    const std::string& cmd = args[0];
+    DaemonClient client;
+    if (!client.connectToDaemon()) throw std::runtime_error("Cannot connect to mooerd");
+
+    auto need = [&](size_t n) {
+        if (args.size() < n + 1) throw std::invalid_argument(cmd + " needs " + std::to_string(n) + " argument(s)");
+    };
+
+    if (cmd == "devices") {
+        QJsonArray list = client.devices();
+        std::string text;
+        for (const QJsonValue& v : list) {
+            QJsonObject d = v.toObject();
+            std::string serial = d.value("serial").toString().toStdString();
+            text += d.value("name").toString().toStdString() + "  serial=" + (serial.empty() ? "-" : serial) +
+                    "  usb=" + std::to_string(d.value("bus").toInt()) + ":" + std::to_string(d.value("address").toInt()) +
+                    "  (mooerd)\n";
+        }
+        if (!text.empty()) text.pop_back();
+        printResult(options, QJsonObject{{"devices", list}}, text);
+    } else if (cmd == "list") {
+        QJsonArray slots;
+        std::string text;
+        for (const TrackInfo& t : client.listTracks(options.device, options.refresh)) {
+            slots.append(QJsonObject{{"slot", t.slot}, {"has_track", t.has_track},
+                                     {"size", (double)t.size}, {"duration", t.duration}});
+            if (t.has_track) {
+                char line[96];
+                snprintf(line, sizeof(line), "%2d  %02d:%02d  %7.2f MB\n", t.slot,
+                         (int)t.duration / 60, (int)t.duration % 60, t.size / 1048576.0);
+                text += line;
+            }
+        }
+        if (!text.empty()) text.pop_back();
+        printResult(options, QJsonObject{{"slots", slots}}, text.empty() ? "No tracks" : text);
+    } else if (cmd == "upload") {
+        need(2);
+        int slot = parseSlot(args[1].c_str());
+        auto app = appForDecoding(args[2], argc, argv);
+        AudioCache cache;
+        AudioCache::Blob cached = cache.lookup(args[2]);
+        QByteArray packed;
+        if (cached.isValid()) {
+            packed = QByteArray(cached.bytes().constData(), cached.bytes().size());
+        } else {
+            packed = Protocol::encodeAudioData(AudioUtils::loadAudioFile(args[2]));
+            cache.store(args[2], packed);
+        }
+        ProgressPrinter progress(options, "bytes");
+        client.upload(options.device, slot, packed, ProgressPrinter::callback, &progress);
+        printResult(options, QJsonObject{{"uploaded", QString::fromStdString(args[2])}, {"slot", slot}},
+                    "Uploaded " + args[2] + " to slot " + std::to_string(slot));
+    } else if (cmd == "download") {
+        need(2);
+        int slot = parseSlot(args[1].c_str());
+        QByteArray data;
+        {
+            ProgressPrinter progress(options, "bytes");
+            data = client.download(options.device, slot, ProgressPrinter::callback, &progress);
+        }
+        if (!AudioUtils::savePackedAudio(args[2], data, options.format)) {
+            throw std::runtime_error("Failed to write " + args[2]);
+        }
+        printResult(options, QJsonObject{{"downloaded", QString::fromStdString(args[2])}, {"slot", slot}},
+                    "Saved slot " + std::to_string(slot) + " to " + args[2]);
+    } else if (cmd == "delete") {
+        need(1);
+        int slot = parseSlot(args[1].c_str());
+        client.remove(options.device, slot);
+        printResult(options, QJsonObject{{"deleted", slot}}, "Deleted slot " + std::to_string(slot));
+    } else if (cmd == "backup") {
+        need(1);
+        QDir dir(QString::fromStdString(args[1]));
+        if (!dir.mkpath(".")) throw std::runtime_error("Cannot create " + args[1]);
+        const char* ext = (options.format == AudioUtils::Flac) ? "flac" : "wav";
+        QJsonArray list;
+        std::string text;
+        for (const TrackInfo& t : client.listTracks(options.device, true)) {
+            if (!t.has_track || interrupted) continue;
+            std::string path = dir.filePath(QString("slot_%1.%2").arg(t.slot, 2, 10, QChar('0')).arg(ext)).toStdString();
+            QByteArray data;
+            {
+                ProgressPrinter progress(options, "bytes");
+                data = client.download(options.device, t.slot, ProgressPrinter::callback, &progress);
+            }
+            if (!AudioUtils::savePackedAudio(path, data, options.format)) {
+                throw std::runtime_error("Failed to write " + path);
+            }
+            list.append(QString::fromStdString(path));
+            text += path + "\n";
+        }
+        if (!text.empty()) text.pop_back();
+        printResult(options, QJsonObject{{"files", list}}, text);
+        if (interrupted) return 130;
+    } else if (cmd == "metrics") {
+        QString text = client.metrics();
+        if (options.json) printResult(options, QJsonObject{{"metrics", text}}, "");
+        else printf("%s", text.toUtf8().constData());
+    } else if (cmd == "play") {
+        throw std::runtime_error("Playback is not available through mooerd; stop the daemon to play from the command line");
+    } else if (cmd == "benchmark") {
+        throw std::runtime_error("mooerd holds the pedal; stop the daemon to benchmark the link");
+    } else {
+        std::cerr << "Unknown command: " << cmd << std::endl;
+        usage();
+        return 2;
+    }
+    return 0;
+}
+}
+
+int main(int argc, char** argv) {
+    // Same names as the GUI so the conversion cache, mirror and settings are shared
+    QCoreApplication::setOrganizationName("MooerLooperManager");
+    QCoreApplication::setApplicationName("MooerLooperManager");
+
+    Options options;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::invalid_argument(a + " needs a value");
+            return argv[++i];
+        };
+        try {
+            if (a == "--json") options.json = true;
+            else if (a == "--metrics") options.metrics = true;
+            else if (a == "--trace-events") TraceEvents::start(value());
+            else if (a == "--device") options.device = value();
+            else if (a == "--from") options.from = std::stod(value());
+            else if (a == "--quick") options.quick = true;
+            else if (a == "--refresh") options.refresh = true;
+            else if (a == "--volume") options.volume = std::max(0, std::min(100, std::stoi(value())));
+            else if (a == "--format") {
+                std::string f = value();
+                if (f == "wav24") options.format = AudioUtils::Wav24;
+                else if (f == "wav32") options.format = AudioUtils::Wav32;
+                else if (f == "flac") options.format = AudioUtils::Flac;
+                else throw std::invalid_argument("Unknown format " + f);
+            } else if (a == "-h" || a == "--help") {
+                usage();
+                return 0;
+            } else {
+                args.push_back(a);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            usage();
+            return 2;
+        }
+    }
+    if (args.empty()) {
+        usage();
+        return 2;
+    }
+
+    signal(SIGINT, [](int) { interrupted = true; });
+    if (!TraceEvents::isEnabled()) TraceEvents::startFromEnvironment();
+    TraceEvents::setThreadName("main");
+
+    try {
+        // MOOER_NO_DAEMON forces direct USB access even if the socket is there
+        std::unique_ptr<QCoreApplication> daemonApp;
+        bool viaDaemon = false;
+        if (!getenv("MOOER_NO_DAEMON") && DaemonClient::socketExists()) {
+            daemonApp = std::make_unique<QCoreApplication>(argc, argv);
+            viaDaemon = DaemonClient::isRunning();
+        }
+        int status = viaDaemon ? runViaDaemon(options, args, argc, argv) : run(options, args, argc, argv);
+        if (options.metrics) fprintf(stderr, "%s", Metrics::exposition().c_str());
+        TraceEvents::stop();
+        return status;
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
+        usage();
+        return 2;
+    } catch (const std::exception& e) {
+        if (options.json) {
+            printf("%s\n", QJsonDocument(QJsonObject{{"error", e.what()}}).toJson(QJsonDocument::Compact).constData());
+        }
+        std::cerr << "Error: " << e.what() << std::endl;
+        // Failed runs are the ones worth measuring
+        if (options.metrics) fprintf(stderr, "%s", Metrics::exposition().c_str());
+        TraceEvents::stop();
+        return 1;
+    }
+}
@@ -0,0 +1,136 @@
+#include "daemon_client.h"
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSharedMemory>
+#include <QUuid>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+QString DaemonClient::socketName() {
+    const char* user = getenv("USER");
+    return QString("mooerd-%1").arg(user ? QString::fromLocal8Bit(user) : QString("default"));
+}
+
+bool DaemonClient::isRunning() {
+    QLocalSocket probe;
+    probe.connectToServer(socketName());
+    bool ok = probe.waitForConnected(200);
+    probe.abort();
+    return ok;
+}
+
+bool DaemonClient::socketExists() {
+#ifdef Q_OS_WIN
+    return true;
+#else
+    // QLocalServer puts relative names in the temp directory
+    return QFile::exists(QDir::temp().filePath(socketName()));
+#endif
+}
+
+DaemonClient::DaemonClient() : nextId(1) {
+}
+
+bool DaemonClient::connectToDaemon(int timeoutMs) {
+    socket.connectToServer(socketName());
+    return socket.waitForConnected(timeoutMs);
+}
+
+QJsonObject DaemonClient::readMessage() {
+    while (true) {
+        int newline = buffer.indexOf('\n');
+        if (newline >= 0) {
+            QByteArray line = buffer.left(newline);
+            buffer.remove(0, newline + 1);
+            QJsonDocument doc = QJsonDocument::fromJson(line);
+            if (doc.isObject()) return doc.object();
+            continue;
+        }
+        // Transfers can take minutes; only a dropped connection ends the wait
+        if (socket.state() != QLocalSocket::ConnectedState && socket.bytesAvailable() == 0) {
+            throw std::runtime_error("Lost connection to mooerd");
+        }
+        socket.waitForReadyRead(1000);
+        buffer.append(socket.readAll());
+    }
+}
+
+QJsonObject DaemonClient::request(QJsonObject message, USBDevice::ProgressCallback callback, void* userData) {
+    int id = nextId++;
+    message["id"] = id;
+    socket.write(QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n");
+    socket.waitForBytesWritten(5000);
+
+    while (true) {
+        QJsonObject reply = readMessage();
+        if (reply.value("id").toInt() != id) continue;
+        if (reply.value("event").toString() == "progress") {
+            if (callback) callback(reply.value("current").toDouble(), reply.value("total").toDouble(), userData);
+            continue;
+        }
+        if (reply.contains("error")) {
+            throw std::runtime_error(reply.value("error").toString().toStdString());
+        }
+        return reply;
+    }
+}
+
+QJsonArray DaemonClient::devices() {
+    return request(QJsonObject{{"op", "devices"}}).value("devices").toArray();
+}
+
+std::vector<TrackInfo> DaemonClient::listTracks(const std::string& device, bool refresh) {
+    QJsonObject reply = request(QJsonObject{{"op", "list"}, {"device", QString::fromStdString(device)}, {"refresh", refresh}});
+    std::vector<TrackInfo> tracks;
+    for (const QJsonValue& v : reply.value("slots").toArray()) {
+        QJsonObject t = v.toObject();
+        tracks.push_back({t.value("slot").toInt(), t.value("has_track").toBool(),
+                          t.value("duration").toDouble(), static_cast<uint32_t>(t.value("size").toDouble())});
+    }
+    return tracks;
+}
+
+void DaemonClient::upload(const std::string& device, int slot, const QByteArray& packed,
+                          USBDevice::ProgressCallback callback, void* userData) {
+    // The segment must outlive the request: the daemon reads it while uploading
+    QSharedMemory shm("mooer-" + QUuid::createUuid().toString(QUuid::WithoutBraces));
+    if (!shm.create(std::max<qsizetype>(packed.size(), 1))) {
+        throw std::runtime_error("Cannot create shared memory: " + shm.errorString().toStdString());
+    }
+    memcpy(shm.data(), packed.constData(), packed.size());
+
+    request(QJsonObject{{"op", "upload"}, {"device", QString::fromStdString(device)}, {"slot", slot},
+                        {"shm", shm.key()}, {"size", (double)packed.size()}}, callback, userData);
+}
+
+QByteArray DaemonClient::download(const std::string& device, int slot,
+                                  USBDevice::ProgressCallback callback, void* userData) {
+    QJsonObject reply = request(QJsonObject{{"op", "download"}, {"device", QString::fromStdString(device)}, {"slot", slot}},
+                                callback, userData);
+
+    QString key = reply.value("shm").toString();
+    qint64 size = static_cast<qint64>(reply.value("size").toDouble());
+    QSharedMemory shm(key);
+    QByteArray data;
+    if (shm.attach(QSharedMemory::ReadOnly)) {
+        if (shm.size() >= size) data = QByteArray(static_cast<const char*>(shm.constData()), size);
+        shm.detach();
+    }
+    request(QJsonObject{{"op", "release"}, {"shm", key}});
+
+    if (data.size() != size) {
+        throw std::runtime_error("Cannot read track from mooerd shared memory");
+    }
+    return data;
+}
+
+void DaemonClient::remove(const std::string& device, int slot) {
+    request(QJsonObject{{"op", "delete"}, {"device", QString::fromStdString(device)}, {"slot", slot}});
+}
+
+QString DaemonClient::metrics() {
+    return request(QJsonObject{{"op", "metrics"}}).value("text").toString();
+}
@@ -0,0 +1,51 @@
+#ifndef DAEMON_CLIENT_H
+#define DAEMON_CLIENT_H
+
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QString>
+#include <string>
+#include <vector>
+#include "usb_device.h"
+
+// Blocking client for mooerd. Requests and replies are JSON lines over a local socket:
+//   -> {"id": 1, "op": "list", "device": "<serial|bus:addr>", ...}
+//   <- {"id": 1, "event": "progress", "current": n, "total": m}   (zero or more)
+//   <- {"id": 1, "ok": true, ...}  or  {"id": 1, "error": "..."}
+// Track audio is exchanged through QSharedMemory segments named in the messages.
+class DaemonClient {
+public:
+    static QString socketName();
+    // True if a daemon is accepting connections
+    static bool isRunning();
+    // Cheap check for the socket file, usable before any Qt application exists
+    static bool socketExists();
+
+    DaemonClient();
+
+    bool connectToDaemon(int timeoutMs = 500);
+
+    QJsonArray devices();
+    std::vector<TrackInfo> listTracks(const std::string& device, bool refresh = false);
+    void upload(const std::string& device, int slot, const QByteArray& packed,
+                USBDevice::ProgressCallback callback = nullptr, void* userData = nullptr);
+    QByteArray download(const std::string& device, int slot,
+                        USBDevice::ProgressCallback callback = nullptr, void* userData = nullptr);
+    void remove(const std::string& device, int slot);
+    // The daemon's Metrics::exposition()
+    QString metrics();
+
+    // Sends one request and waits for its final reply; throws std::runtime_error on errors
+    QJsonObject request(QJsonObject message, USBDevice::ProgressCallback callback = nullptr, void* userData = nullptr);
+
+private:
+    QLocalSocket socket;
+    int nextId;
+    QByteArray buffer;
+
+    QJsonObject readMessage();
+};
+
+#endif // DAEMON_CLIENT_H
@@ -0,0 +1,34 @@
+#include <QCoreApplication>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "daemon_server.h"
+#include "trace_events.h"
+
+// mooerd: keeps connected pedals claimed and serves mooer-cli over a local socket
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setOrganizationName("MooerLooperManager");
+    app.setApplicationName("MooerLooperManager");
+
+    int streamPort = -1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--stream-port") == 0 && i + 1 < argc) {
+            streamPort = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: mooerd [--stream-port <port>]" << std::endl;
+            return 2;
+        }
+    }
+
+    TraceEvents::startFromEnvironment();
+    int status;
+    {
+        DaemonServer server;
+        if (!server.listen()) return 1;
+        if (streamPort >= 0 && !server.listenStream(static_cast<quint16>(streamPort))) return 1;
+        status = app.exec();
+    }
+    TraceEvents::stop();
+    return status;
+}
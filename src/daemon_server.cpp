@@ -0,0 +1,385 @@
+#include "daemon_server.h"
+#include "daemon_client.h"
+#include "operations.h"
+#include "pedal_mirror.h"
+#include "metrics.h"
+#include "trace_events.h"
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+// Loops can be recorded on the pedal itself, which we are not told about
+const auto LIST_MAX_AGE = std::chrono::seconds(30);
+
+QJsonArray tracksJson(const std::vector<TrackInfo>& tracks) {
+    QJsonArray slots;
+    for (const TrackInfo& t : tracks) {
+        slots.append(QJsonObject{{"slot", t.slot}, {"has_track", t.has_track},
+                                 {"size", (double)t.size}, {"duration", t.duration}});
+    }
+    return slots;
+}
+
+void setTrack(std::vector<TrackInfo>& tracks, int slot, uint32_t size) {
+    if (slot < 0 || slot >= (int)tracks.size()) return;
+    tracks[slot].has_track = size > 0;
+    tracks[slot].size = size;
+    tracks[slot].duration = (double)size / (6.0 * 44100.0);
+}
+}
+
+DaemonServer::DaemonServer(QObject* parent) : QObject(parent), segmentCounter(0) {
+    connect(&server, &QLocalServer::newConnection, this, &DaemonServer::onNewConnection);
+    // Pick up pedals plugged in while running
+    connect(&rescanTimer, &QTimer::timeout, this, &DaemonServer::rescanDevices);
+    rescanTimer.start(5000);
+}
+
+DaemonServer::~DaemonServer() {
+    // Pedal threads may still be feeding streams; join them before the stream server goes
+    for (auto& pedal : pedals) stopPedal(pedal.get());
+}
+
+bool DaemonServer::listen() {
+    if (DaemonClient::isRunning()) {
+        std::cerr << "mooerd is already running" << std::endl;
+        return false;
+    }
+    QLocalServer::removeServer(DaemonClient::socketName());
+    server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server.listen(DaemonClient::socketName())) {
+        std::cerr << "Cannot listen on " << DaemonClient::socketName().toStdString() << ": "
+                  << server.errorString().toStdString() << std::endl;
+        return false;
+    }
+    rescanDevices();
+    return true;
+}
+
+bool DaemonServer::listenStream(quint16 port) {
+    // Stream reads are queued like any other job, so they never overlap a transfer
+    streamServer = std::make_unique<StreamServer>([this](const QString& device,
+                                                         std::function<void(USBDevice&, const StreamServer::SlotObserver&)> work) {
+        Pedal* pedal = findPedal(device);
+        if (!pedal) return false;
+        enqueue(pedal, [this, pedal, work]() {
+            work(pedal->device, [this, pedal](int slot, uint32_t size) { noteSlot(pedal, slot, size); });
+        });
+        return true;
+    });
+    return streamServer->listen(port);
+}
+
+void DaemonServer::rescanDevices() {
+    std::vector<DeviceInfo> found = USBDevice::enumerateDevices();
+
+    // Unplugged pedals
+    for (auto it = pedals.begin(); it != pedals.end();) {
+        bool present = false;
+        for (const DeviceInfo& d : found) {
+            if (d.bus == (*it)->info.bus && d.address == (*it)->info.address) present = true;
+        }
+        if (!present) {
+            std::cerr << "Released " << (*it)->info.name << std::endl;
+            stopPedal(it->get());
+            it = pedals.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (const DeviceInfo& d : found) {
+        if (!d.hasPermission) continue;
+        bool known = false;
+        for (const auto& p : pedals) {
+            if (p->info.bus == d.bus && p->info.address == d.address) known = true;
+        }
+        if (known) continue;
+
+        auto pedal = std::make_unique<Pedal>();
+        pedal->info = d;
+        if (!pedal->device.connect(d.bus, d.address)) continue;
+
+        Pedal* p = pedal.get();
+        p->thread = std::thread([p]() {
+            TraceEvents::setThreadName("Pedal " + p->info.serial);
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(p->mutex);
+                    p->wake.wait(lock, [p]() { return p->quit || !p->jobs.empty(); });
+                    if (p->jobs.empty()) return;
+                    job = std::move(p->jobs.front());
+                    p->jobs.pop_front();
+                }
+                job();
+            }
+        });
+        std::cerr << "Claimed " << d.name << " (" << (int)d.bus << ":" << (int)d.address << ")" << std::endl;
+        pedals.push_back(std::move(pedal));
+    }
+}
+
+void DaemonServer::stopPedal(Pedal* pedal) {
+    {
+        std::lock_guard<std::mutex> lock(pedal->mutex);
+        pedal->quit = true;
+    }
+    pedal->wake.notify_all();
+    // Jobs still queued run against the closing device and report their errors
+    if (pedal->thread.joinable()) pedal->thread.join();
+    pedal->device.disconnect();
+}
+
+void DaemonServer::enqueue(Pedal* pedal, std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(pedal->mutex);
+        pedal->jobs.push_back(std::move(job));
+    }
+    pedal->wake.notify_one();
+}
+
+void DaemonServer::noteSlot(Pedal* pedal, int slot, uint32_t size) {
+    std::lock_guard<std::mutex> lock(pedal->mutex);
+    if (!pedal->tracksValid || slot < 0 || slot >= (int)pedal->tracks.size()) return;
+    if (pedal->tracks[slot].size == size) return;
+    setTrack(pedal->tracks, slot, size);
+    pedal->tracksValid = false;
+}
+
+void DaemonServer::requerySlot(Pedal* pedal, int slot) {
+    // After a failed transfer the link itself is often gone: no reply is not an empty slot
+    bool answered = false;
+    TrackInfo t = pedal->device.queryTrack(slot, &answered);
+    std::lock_guard<std::mutex> lock(pedal->mutex);
+    if (answered) setTrack(pedal->tracks, slot, t.has_track ? t.size : 0);
+    else pedal->tracksValid = false;
+}
+
+void DaemonServer::slotWritten(Pedal* pedal, int slot) {
+    DeviceInfo info = pedal->info;
+    QMetaObject::invokeMethod(this, [this, info, slot]() {
+        if (streamServer) streamServer->dropSlot(slot, [&](const QString& device) { return names(device, info); });
+    }, Qt::QueuedConnection);
+}
+
+bool DaemonServer::names(const QString& device, const DeviceInfo& info) const {
+    if (device.isEmpty()) {
+        return !pedals.empty() && pedals.front()->info.bus == info.bus && pedals.front()->info.address == info.address;
+    }
+    QString busAddress = QString("%1:%2").arg(info.bus).arg(info.address);
+    return device == QString::fromStdString(info.serial) || device == busAddress;
+}
+
+DaemonServer::Pedal* DaemonServer::findPedal(const QString& device) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        for (const auto& p : pedals) {
+            if (names(device, p->info)) return p.get();
+        }
+        rescanDevices();
+    }
+    return nullptr;
+}
+
+void DaemonServer::onNewConnection() {
+    while (QLocalSocket* client = server.nextPendingConnection()) {
+        connect(client, &QLocalSocket::readyRead, this, &DaemonServer::onReadyRead);
+        connect(client, &QLocalSocket::disconnected, this, &DaemonServer::onDisconnected);
+    }
+}
+
+void DaemonServer::onDisconnected() {
+    QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
+    if (!client) return;
+    buffers.erase(client);
+    segments.erase(client);
+    client->deleteLater();
+}
+
+void DaemonServer::onReadyRead() {
+    QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
+    if (!client) return;
+
+    QByteArray& buffer = buffers[client];
+    buffer.append(client->readAll());
+    int newline;
+    while ((newline = buffer.indexOf('\n')) >= 0) {
+        QByteArray line = buffer.left(newline);
+        buffer.remove(0, newline + 1);
+        QJsonDocument doc = QJsonDocument::fromJson(line);
+        if (doc.isObject()) handle(client, doc.object());
+    }
+}
+
+void DaemonServer::send(QPointer<QLocalSocket> client, const QJsonObject& message) {
+    QMetaObject::invokeMethod(this, [client, message]() {
+        if (client) client->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n");
+    }, Qt::QueuedConnection);
+}
+
+void DaemonServer::handle(QLocalSocket* socket, const QJsonObject& message) {
+    QPointer<QLocalSocket> client(socket);
+    int id = message.value("id").toInt();
+    QString op = message.value("op").toString();
+
+    auto fail = [this, client, id](const QString& error) {
+        send(client, QJsonObject{{"id", id}, {"error", error}});
+    };
+
+    if (op == "ping") {
+        send(client, QJsonObject{{"id", id}, {"ok", true}});
+        return;
+    }
+    if (op == "devices") {
+        rescanDevices();
+        QJsonArray list;
+        for (const auto& p : pedals) {
+            list.append(QJsonObject{{"name", QString::fromStdString(p->info.name)},
+                                    {"serial", QString::fromStdString(p->info.serial)},
+                                    {"bus", p->info.bus}, {"address", p->info.address}, {"permission", true}});
+        }
+        send(client, QJsonObject{{"id", id}, {"ok", true}, {"devices", list}});
+        return;
+    }
+    if (op == "metrics") {
+        send(client, QJsonObject{{"id", id}, {"ok", true}, {"text", QString::fromStdString(Metrics::exposition())}});
+        return;
+    }
+    if (op == "release") {
+        segments[socket].erase(message.value("shm").toString());
+        send(client, QJsonObject{{"id", id}, {"ok", true}});
+        return;
+    }
+
+    Pedal* pedal = findPedal(message.value("device").toString());
+    if (!pedal) {
+        fail("No pedal found");
+        return;
+    }
+    int slot = message.value("slot").toInt(-1);
+    // Sent to the pedal as a single byte, so anything out of range would address another slot
+    if ((op == "upload" || op == "download" || op == "delete") && (slot < 0 || slot >= Protocol::MAX_TRACKS)) {
+        fail(QString("Invalid slot: %1").arg(message.value("slot").toVariant().toString()));
+        return;
+    }
+
+    // Progress from the pedal thread, a few events per second
+    struct Progress {
+        DaemonServer* server;
+        QPointer<QLocalSocket> client;
+        int id;
+        std::chrono::steady_clock::time_point last;
+    };
+    auto progressCallback = [](size_t current, size_t total, void* userData) {
+        Progress* p = static_cast<Progress*>(userData);
+        auto now = std::chrono::steady_clock::now();
+        if (current < total && now - p->last < std::chrono::milliseconds(100)) return;
+        p->last = now;
+        p->server->send(p->client, QJsonObject{{"id", p->id}, {"event", "progress"},
+                                               {"current", (double)current}, {"total", (double)total}});
+    };
+
+    if (op == "list") {
+        {
+            std::lock_guard<std::mutex> lock(pedal->mutex);
+            bool fresh = std::chrono::steady_clock::now() - pedal->tracksTime < LIST_MAX_AGE;
+            if (pedal->tracksValid && fresh && !message.value("refresh").toBool()) {
+                // Cached listing: no USB traffic, answered immediately
+                send(client, QJsonObject{{"id", id}, {"ok", true}, {"slots", tracksJson(pedal->tracks)}});
+                return;
+            }
+        }
+        enqueue(pedal, [this, pedal, client, id, fail]() {
+            try {
+                auto tracks = pedal->device.listTracks();
+                {
+                    std::lock_guard<std::mutex> lock(pedal->mutex);
+                    pedal->tracks = tracks;
+                    pedal->tracksValid = true;
+                    pedal->tracksTime = std::chrono::steady_clock::now();
+                }
+                send(client, QJsonObject{{"id", id}, {"ok", true}, {"slots", tracksJson(tracks)}});
+            } catch (const std::exception& e) {
+                fail(e.what());
+            }
+        });
+    } else if (op == "upload") {
+        QString key = message.value("shm").toString();
+        qint64 size = static_cast<qint64>(message.value("size").toDouble());
+        enqueue(pedal, [this, pedal, client, id, slot, key, size, fail, progressCallback]() {
+            try {
+                QSharedMemory shm(key);
+                if (!shm.attach(QSharedMemory::ReadOnly) || shm.size() < size) {
+                    throw std::runtime_error("Cannot attach upload shared memory");
+                }
+                QByteArray packed(static_cast<const char*>(shm.constData()), size);
+                shm.detach();
+
+                Progress progress{this, client, id, {}};
+                PedalMirror mirror(pedal->device.getSerial());
+                mirror.invalidate(slot);
+                pedal->device.uploadTrackRaw(slot, packed, progressCallback, &progress);
+                mirror.store(slot, packed);
+                slotWritten(pedal, slot);
+                {
+                    std::lock_guard<std::mutex> lock(pedal->mutex);
+                    setTrack(pedal->tracks, slot, packed.size());
+                }
+                send(client, QJsonObject{{"id", id}, {"ok", true}});
+            } catch (const std::exception& e) {
+                slotWritten(pedal, slot);
+                // The slot may hold a partial track now; re-read just its header
+                requerySlot(pedal, slot);
+                fail(e.what());
+            }
+        });
+    } else if (op == "download") {
+        enqueue(pedal, [this, pedal, client, id, slot, fail, progressCallback]() {
+            try {
+                Progress progress{this, client, id, {}};
+                QByteArray data = pedal->device.downloadTrackRaw(slot, progressCallback, &progress);
+                noteSlot(pedal, slot, data.size());
+                PedalMirror(pedal->device.getSerial()).store(slot, data);
+
+                // Segments are owned by the server thread, next to the client they belong to
+                QMetaObject::invokeMethod(this, [this, client, id, data]() {
+                    if (!client) return;
+                    QString key = QString("mooerd-%1-%2").arg(QCoreApplication::applicationPid()).arg(++segmentCounter);
+                    auto shm = std::make_unique<QSharedMemory>(key);
+                    if (!shm->create(std::max<qsizetype>(data.size(), 1))) {
+                        send(client, QJsonObject{{"id", id}, {"error", "Cannot create shared memory: " + shm->errorString()}});
+                        return;
+                    }
+                    memcpy(shm->data(), data.constData(), data.size());
+                    segments[client.data()][key] = std::move(shm);
+                    send(client, QJsonObject{{"id", id}, {"ok", true}, {"shm", key}, {"size", (double)data.size()}});
+                }, Qt::QueuedConnection);
+            } catch (const std::exception& e) {
+                fail(e.what());
+            }
+        });
+    } else if (op == "delete") {
+        enqueue(pedal, [this, pedal, client, id, slot, fail]() {
+            try {
+                Operations::remove(pedal->device, slot);
+                slotWritten(pedal, slot);
+                {
+                    std::lock_guard<std::mutex> lock(pedal->mutex);
+                    setTrack(pedal->tracks, slot, 0);
+                }
+                send(client, QJsonObject{{"id", id}, {"ok", true}});
+            } catch (const std::exception& e) {
+                slotWritten(pedal, slot);
+                requerySlot(pedal, slot);
+                fail(e.what());
+            }
+        });
+    } else {
+        fail("Unknown op: " + op);
+    }
+}
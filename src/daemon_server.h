@@ -0,0 +1,86 @@
+#ifndef DAEMON_SERVER_H
+#define DAEMON_SERVER_H
+
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QPointer>
+#include <QSharedMemory>
+#include <QTimer>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "usb_device.h"
+#include "stream_server.h"
+
+// mooerd: owns the pedals (interfaces stay claimed) and their track lists, and serves
+// DaemonClient requests over a local socket. Each pedal has one I/O thread running
+// jobs in arrival order, so requests from different clients queue instead of clashing.
+class DaemonServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit DaemonServer(QObject* parent = nullptr);
+    ~DaemonServer();
+
+    bool listen();
+    // Optional HTTP endpoint on localhost serving slots as WAV/PCM streams
+    bool listenStream(quint16 port);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void rescanDevices();
+
+private:
+    struct Pedal {
+        DeviceInfo info;
+        USBDevice device;
+
+        std::mutex mutex;          // Guards tracks and the job queue
+        std::condition_variable wake;
+        std::deque<std::function<void()>> jobs;
+        std::vector<TrackInfo> tracks;
+        bool tracksValid = false;
+        std::chrono::steady_clock::time_point tracksTime;  // When `tracks` was last read in full
+        bool quit = false;
+        std::thread thread;
+    };
+
+    QLocalServer server;
+    QTimer rescanTimer;
+    std::vector<std::unique_ptr<Pedal>> pedals;
+    std::map<QLocalSocket*, QByteArray> buffers;
+    // Download segments handed to clients, kept until released or the client goes away
+    std::map<QLocalSocket*, std::map<QString, std::unique_ptr<QSharedMemory>>> segments;
+    int segmentCounter;
+    std::unique_ptr<StreamServer> streamServer;
+
+    void handle(QLocalSocket* client, const QJsonObject& message);
+    Pedal* findPedal(const QString& device);
+    // Whether a request's device string (serial, bus:addr, empty = first pedal) names this pedal
+    bool names(const QString& device, const DeviceInfo& info) const;
+    void enqueue(Pedal* pedal, std::function<void()> job);
+    void stopPedal(Pedal* pedal);
+    // A transfer read a slot's header. If it disagrees with the cached list, the pedal was
+    // changed behind our back (e.g. a loop recorded on it): the next `list` re-reads it.
+    void noteSlot(Pedal* pedal, int slot, uint32_t size);
+    // Re-reads the header of a slot a failed upload or delete may have half written; without
+    // a reply the whole cached list is dropped instead
+    void requerySlot(Pedal* pedal, int slot);
+    // An upload or delete touched the slot: later streams of it read the pedal again
+    void slotWritten(Pedal* pedal, int slot);
+
+    // Thread-safe: replies are delivered on the server thread, and dropped if the client left
+    void send(QPointer<QLocalSocket> client, const QJsonObject& message);
+};
+
+#endif // DAEMON_SERVER_H
@@ -0,0 +1,227 @@
+#include "device_registry.h"
+#include "usb_context.h"
+#include <iostream>
+
+namespace {
+bool sameDevice(const DeviceInfo& a, const DeviceInfo& b) {
+    return a.bus == b.bus && a.address == b.address && a.name == b.name && a.serial == b.serial &&
+           a.hasPermission == b.hasPermission;
+}
+}
+
+DeviceRegistry::DeviceRegistry(QObject* parent)
+    : QThread(parent), callbackHandle(0), stopFlag(false), rescanRequested(false), published(false) {}
+
+DeviceRegistry::~DeviceRegistry() {
+    stop();
+    release(events);
+}
+
+void DeviceRegistry::stop() {
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        stopFlag = true;
+    }
+    eventSignal.notify_all();
+    wait();
+}
+
+void DeviceRegistry::rescan() {
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        rescanRequested = true;
+    }
+    eventSignal.notify_all();
+}
+
+std::vector<DeviceInfo> DeviceRegistry::devices() const {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    return snapshot;
+}
+
+int DeviceRegistry::hotplugCallback(libusb_context* ctx, libusb_device* dev,
+                                    libusb_hotplug_event event, void* userData) {
+    Q_UNUSED(ctx);
+    // Runs inside libusb event handling. No blocking calls are allowed here, so the device
+    // is only queued; it is opened once the burst is over.
+    DeviceRegistry* registry = static_cast<DeviceRegistry*>(userData);
+    Event e;
+    e.key = Key(libusb_get_bus_number(dev), libusb_get_device_address(dev));
+    e.device = event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED ? libusb_ref_device(dev) : nullptr;
+    {
+        std::lock_guard<std::mutex> lock(registry->eventMutex);
+        registry->events.push_back(e);
+        registry->lastEvent = std::chrono::steady_clock::now();
+    }
+    registry->eventSignal.notify_all();
+    return 0;  // Keep the callback registered
+}
+
+void DeviceRegistry::run() {
+    libusb_context* ctx = UsbContext::get();
+    bool hotplug = ctx && libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG);
+    if (hotplug) {
+        // ENUMERATE reports the pedals already attached as arrivals, right here
+        int rc = libusb_hotplug_register_callback(
+            ctx,
+            static_cast<libusb_hotplug_event>(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+            LIBUSB_HOTPLUG_ENUMERATE,
+            Protocol::VENDOR_ID,
+            LIBUSB_HOTPLUG_MATCH_ANY,  // Any product ID
+            LIBUSB_HOTPLUG_MATCH_ANY,  // Any device class
+            hotplugCallback,
+            this,
+            &callbackHandle
+        );
+        if (rc != LIBUSB_SUCCESS) {
+            std::cerr << "Failed to register hotplug callback: " << libusb_error_name(rc) << std::endl;
+            hotplug = false;
+        }
+    } else {
+        std::cerr << "Hotplug not supported on this platform" << std::endl;
+    }
+
+    if (hotplug) {
+        UsbContext::acquireEvents();
+        std::vector<Event> batch;
+        {
+            std::lock_guard<std::mutex> lock(eventMutex);
+            batch.swap(events);
+        }
+        applyEvents(batch);
+    } else {
+        scanAll();
+    }
+    publish();
+
+    const auto debounce = std::chrono::milliseconds(DEBOUNCE_MS);
+    std::unique_lock<std::mutex> lock(eventMutex);
+    while (!stopFlag) {
+        if (!rescanRequested) {
+            if (events.empty()) {
+                eventSignal.wait(lock, [this] { return stopFlag || rescanRequested || !events.empty(); });
+            } else {
+                // New events push the deadline back; re-checked on the next pass
+                eventSignal.wait_until(lock, lastEvent + debounce, [this] { return stopFlag || rescanRequested; });
+            }
+            if (stopFlag) break;
+        }
+
+        std::vector<Event> batch;
+        if (rescanRequested) {
+            rescanRequested = false;
+            batch.swap(events);
+            lock.unlock();
+            // A full scan supersedes whatever was still queued
+            release(batch);
+            cache.clear();
+            scanAll();
+            publish(true);
+            lock.lock();
+        } else if (!events.empty() && std::chrono::steady_clock::now() - lastEvent >= debounce) {
+            batch.swap(events);
+            lock.unlock();
+            applyEvents(batch);
+            publish();
+            lock.lock();
+        }
+    }
+    lock.unlock();
+
+    if (hotplug) {
+        libusb_hotplug_deregister_callback(ctx, callbackHandle);
+        callbackHandle = 0;
+        UsbContext::releaseEvents();
+    }
+}
+
+void DeviceRegistry::applyEvents(const std::vector<Event>& batch) {
+    // Only the last event of each device counts: arrive+leave within a burst is a no-op
+    std::map<Key, libusb_device*> latest;
+    for (const Event& e : batch) {
+        auto it = latest.find(e.key);
+        if (it != latest.end() && it->second) libusb_unref_device(it->second);
+        latest[e.key] = e.device;
+    }
+
+    for (const auto& entry : latest) {
+        if (!entry.second) {
+            cache.erase(entry.first);
+            continue;
+        }
+        // An arrival is a new device even at a cached address, so it is always re-read
+        DeviceInfo info;
+        if (USBDevice::describeDevice(entry.second, info)) cache[entry.first] = info;
+        libusb_unref_device(entry.second);
+    }
+}
+
+void DeviceRegistry::release(const std::vector<Event>& batch) {
+    for (const Event& e : batch) {
+        if (e.device) libusb_unref_device(e.device);
+    }
+}
+
+void DeviceRegistry::scanAll() {
+    libusb_context* ctx = UsbContext::get();
+    if (!ctx) return;
+    libusb_device** list;
+    ssize_t count = libusb_get_device_list(ctx, &list);
+    if (count < 0) {
+        std::cerr << "Failed to list USB devices: " << libusb_error_name(static_cast<int>(count)) << std::endl;
+        return;
+    }
+
+    std::map<Key, DeviceInfo> found;
+    for (ssize_t i = 0; i < count; i++) {
+        Key key(libusb_get_bus_number(list[i]), libusb_get_device_address(list[i]));
+        auto cached = cache.find(key);
+        if (cached != cache.end()) {
+            found[key] = cached->second;
+            continue;
+        }
+        DeviceInfo info;
+        if (USBDevice::describeDevice(list[i], info)) found[key] = info;
+    }
+    libusb_free_device_list(list, 1);
+    cache.swap(found);
+}
+
+void DeviceRegistry::publish(bool always) {
+    std::vector<DeviceInfo> current;
+    for (const auto& entry : cache) current.push_back(entry.second);
+    DeviceInfo emulated;
+    if (USBDevice::emulatedDevice(emulated)) current.push_back(emulated);
+
+    std::vector<DeviceInfo> previous = devices();
+    std::vector<DeviceInfo> added, removed;
+    for (const DeviceInfo& d : current) {
+        bool known = false;
+        for (const DeviceInfo& p : previous) {
+            if (sameDevice(d, p)) {
+                known = true;
+                break;
+            }
+        }
+        if (!known) added.push_back(d);
+    }
+    for (const DeviceInfo& p : previous) {
+        bool present = false;
+        for (const DeviceInfo& d : current) {
+            if (d.bus == p.bus && d.address == p.address) {
+                present = true;
+                break;
+            }
+        }
+        if (!present) removed.push_back(p);
+    }
+    // The first list is always published, even when empty
+    if (published && !always && added.empty() && removed.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        snapshot = current;
+    }
+    published = true;
+    emit devicesChanged(current, added, removed);
+}
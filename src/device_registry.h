@@ -0,0 +1,78 @@
+#ifndef DEVICE_REGISTRY_H
+#define DEVICE_REGISTRY_H
+
+#include <QThread>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <libusb-1.0/libusb.h>
+#include "usb_device.h"
+
+// Keeps the list of attached pedals up to date on its own thread. Hotplug callbacks arrive on
+// the shared UsbContext event thread and only queue the libusb_device they carry; this thread
+// then opens just the pedals that actually arrived to read their strings, the others stay
+// cached by bus/address. A burst of events (hub reset, flaky cable) is folded into one
+// devicesChanged() once the bus has been quiet for DEBOUNCE_MS.
+class DeviceRegistry : public QThread {
+    Q_OBJECT
+
+public:
+    static constexpr int DEBOUNCE_MS = 150;
+
+    explicit DeviceRegistry(QObject* parent = nullptr);
+    ~DeviceRegistry();
+
+    void stop();
+    // Drops the cache and re-reads every pedal, e.g. after the udev rule changed permissions.
+    // Always answered with a devicesChanged(). Also the only way to notice changes where
+    // libusb has no hotplug support.
+    void rescan();
+    // Last published list, sorted by bus/address
+    std::vector<DeviceInfo> devices() const;
+
+signals:
+    // `added` also holds entries whose name, serial or permission changed
+    void devicesChanged(std::vector<DeviceInfo> devices, std::vector<DeviceInfo> added,
+                        std::vector<DeviceInfo> removed);
+
+protected:
+    void run() override;
+
+private:
+    using Key = std::pair<uint8_t, uint8_t>;  // Bus, address
+    struct Event {
+        Key key;
+        libusb_device* device;  // Referenced while queued; null for a departure
+    };
+
+    libusb_hotplug_callback_handle callbackHandle;
+
+    // Guarded by eventMutex; the callback and rescan()/stop() wake the registry thread
+    std::mutex eventMutex;
+    std::condition_variable eventSignal;
+    std::vector<Event> events;
+    std::chrono::steady_clock::time_point lastEvent;
+    bool stopFlag;
+    bool rescanRequested;
+
+    // Registry thread only
+    std::map<Key, DeviceInfo> cache;
+    bool published;
+
+    mutable std::mutex snapshotMutex;
+    std::vector<DeviceInfo> snapshot;
+
+    static int hotplugCallback(libusb_context* ctx, libusb_device* dev,
+                               libusb_hotplug_event event, void* userData);
+    // Folds the events per device and describes the net arrivals
+    void applyEvents(const std::vector<Event>& batch);
+    static void release(const std::vector<Event>& batch);
+    void scanAll();
+    // Emits devicesChanged if the list differs from the last one (or `always`, after a rescan)
+    void publish(bool always = false);
+};
+
+#endif // DEVICE_REGISTRY_H
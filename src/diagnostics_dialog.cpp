@@ -0,0 +1,55 @@
+#include "diagnostics_dialog.h"
+#include "metrics.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QVBoxLayout>
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget* parent) : QDialog(parent) {
+    setWindowTitle("Diagnostics");
+    resize(820, 480);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    view = new QPlainTextEdit();
+    view->setReadOnly(true);
+    view->setLineWrapMode(QPlainTextEdit::NoWrap);
+    view->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    layout->addWidget(view);
+
+    QHBoxLayout* buttons = new QHBoxLayout();
+    QPushButton* copyBtn = new QPushButton("Copy Full Metrics");
+    copyBtn->setToolTip("Copy every metric in text exposition format, e.g. for a bug report");
+    connect(copyBtn, &QPushButton::clicked, this, []() {
+        QApplication::clipboard()->setText(QString::fromStdString(Metrics::exposition()));
+    });
+    QPushButton* resetBtn = new QPushButton("Reset");
+    connect(resetBtn, &QPushButton::clicked, this, [this]() {
+        Metrics::reset();
+        refresh();
+    });
+    QPushButton* closeBtn = new QPushButton("Close");
+    connect(closeBtn, &QPushButton::clicked, this, &QDialog::accept);
+    buttons->addWidget(copyBtn);
+    buttons->addWidget(resetBtn);
+    buttons->addStretch();
+    buttons->addWidget(closeBtn);
+    layout->addLayout(buttons);
+
+    connect(&refreshTimer, &QTimer::timeout, this, &DiagnosticsDialog::refresh);
+    refreshTimer.start(1000);
+    refresh();
+}
+
+void DiagnosticsDialog::refresh() {
+    QString text = QString::fromStdString(Metrics::summary());
+    text = text.isEmpty() ? "No USB activity yet." : "Latencies in microseconds\n\n" + text;
+    if (text == view->toPlainText()) return;
+
+    // Keep the scroll position while the numbers change
+    int scroll = view->verticalScrollBar()->value();
+    view->setPlainText(text);
+    view->verticalScrollBar()->setValue(scroll);
+}
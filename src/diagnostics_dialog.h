@@ -0,0 +1,24 @@
+#ifndef DIAGNOSTICS_DIALOG_H
+#define DIAGNOSTICS_DIALOG_H
+
+#include <QDialog>
+#include <QPlainTextEdit>
+#include <QTimer>
+
+// Live view of the process metrics (USB latency histograms, timeouts, bytes), refreshed
+// every second, with the text exposition one click away for bug reports
+class DiagnosticsDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(QWidget* parent = nullptr);
+
+private slots:
+    void refresh();
+
+private:
+    QPlainTextEdit* view;
+    QTimer refreshTimer;
+};
+
+#endif // DIAGNOSTICS_DIALOG_H
@@ -0,0 +1,233 @@
+#include "emulated_pedal.h"
+#include "protocol.h"
+#include <QtEndian>
+#include <QString>
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+const int EP_OUT_DATA = 0x03;
+const int CHUNK_SIZE = 1024;
+}
+
+EmulatedPedal::Options EmulatedPedal::Options::parse(const std::string& spec) {
+    Options options;
+    for (const QString& item : QString::fromStdString(spec).split(',', Qt::SkipEmptyParts)) {
+        QString key = item.section('=', 0, 0).trimmed();
+        QString value = item.section('=', 1).trimmed();
+        if (key == "latency") options.latency = std::chrono::microseconds(value.toLongLong());
+        else if (key == "jitter") options.jitter = std::chrono::microseconds(value.toLongLong());
+        else if (key == "settle") options.settle = std::chrono::milliseconds(value.toLongLong());
+        else if (key == "errors") options.errorRate = value.toDouble();
+        else if (key == "timeouts") options.timeoutRate = value.toDouble();
+        else if (key == "late") options.lateRate = value.toDouble();
+        else if (key == "lateby") options.lateBy = std::chrono::milliseconds(value.toLongLong());
+        else if (key == "seed") options.seed = value.toUInt();
+        else if (key == "tracks") options.tracks = value.toInt();
+        else if (key == "seconds") options.trackSeconds = value.toDouble();
+    }
+    return options;
+}
+
+EmulatedPedal::EmulatedPedal(const Options& options)
+    : options(options), rng(options.seed), slots(Protocol::MAX_TRACKS), pendingSlot(-1), pendingChunk(-1) {
+    // Deterministic test tones so downloads and playback have real content
+    for (int t = 0; t < std::min(options.tracks, Protocol::MAX_TRACKS); t++) {
+        int frames = static_cast<int>(options.trackSeconds * 44100.0);
+        std::vector<int32_t> samples(frames * 2);
+        double freq = 220.0 * (t + 1);
+        for (int i = 0; i < frames; i++) {
+            int32_t v = static_cast<int32_t>(std::sin(2.0 * M_PI * freq * i / 44100.0) * 0.5 * 2147483647.0);
+            samples[2 * i] = v;
+            samples[2 * i + 1] = v;
+        }
+        setTrack(t, Protocol::encodeAudioData(samples));
+    }
+}
+
+void EmulatedPedal::setTrack(int slot, const QByteArray& packed) {
+    if (slot < 0 || slot >= (int)slots.size()) return;
+    slots[slot].exists = true;
+    slots[slot].data = packed;
+}
+
+QByteArray EmulatedPedal::track(int slot) const {
+    if (slot < 0 || slot >= (int)slots.size()) return QByteArray();
+    return slots[slot].data;
+}
+
+bool EmulatedPedal::hasTrack(int slot) const {
+    return slot >= 0 && slot < (int)slots.size() && slots[slot].exists;
+}
+
+int EmulatedPedal::transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) {
+    *transferred = 0;
+    counters.transfers++;
+
+    auto delay = options.latency;
+    if (options.jitter.count() > 0) {
+        delay += std::chrono::microseconds(std::uniform_int_distribution<long long>(0, options.jitter.count())(rng));
+    }
+    if (delay.count() > 0) std::this_thread::sleep_for(delay);
+
+    // Injected faults drop the transfer entirely, like a lost packet
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    if (options.errorRate > 0 && chance(rng) < options.errorRate) {
+        counters.injectedErrors++;
+        return LIBUSB_ERROR_IO;
+    }
+    if (options.timeoutRate > 0 && chance(rng) < options.timeoutRate) {
+        counters.injectedTimeouts++;
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+
+    if (!(endpoint & LIBUSB_ENDPOINT_IN)) {
+        QByteArray payload(reinterpret_cast<const char*>(data), length);
+        if (endpoint == Protocol::EP_OUT) handleCommand(payload);
+        else if (endpoint == EP_OUT_DATA) handleData(payload);
+        else return LIBUSB_ERROR_PIPE;
+        counters.bytesOut += length;
+        *transferred = length;
+        return 0;
+    }
+
+    std::deque<Reply>* queue = nullptr;
+    if (endpoint == Protocol::EP_IN_STATUS) queue = &statusQueue;
+    else if (endpoint == Protocol::EP_IN_DATA) queue = &dataQueue;
+    else return LIBUSB_ERROR_PIPE;
+
+    if (queue->empty()) return LIBUSB_ERROR_TIMEOUT;
+
+    // Replies stay in order: a late one holds back everything behind it. Timeout 0 waits forever.
+    auto wait = queue->front().ready - std::chrono::steady_clock::now();
+    if (wait.count() > 0) {
+        if (timeout > 0 && wait > std::chrono::milliseconds(timeout)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+            return LIBUSB_ERROR_TIMEOUT;
+        }
+        std::this_thread::sleep_for(wait);
+    }
+
+    QByteArray response = queue->front().data;
+    queue->pop_front();
+    int n = std::min<int>(length, response.size());
+    memcpy(data, response.constData(), n);
+    counters.bytesIn += n;
+    *transferred = n;
+    return 0;
+}
+
+void EmulatedPedal::queueReply(std::deque<Reply>& queue, const QByteArray& data) {
+    Reply reply{data, std::chrono::steady_clock::now()};
+    if (options.lateRate > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng) < options.lateRate) {
+        counters.lateReplies++;
+        reply.ready += options.lateBy;
+    }
+    queue.push_back(reply);
+}
+
+QByteArray EmulatedPedal::status(uint8_t subcommand, bool ok) {
+    QByteArray resp(64, 0);
+    resp[0] = 0x3F; resp[1] = 0xAA; resp[2] = 0x55;
+    resp[3] = 0x01;
+    resp[5] = subcommand;
+    resp[6] = ok ? 0x00 : 0x01;
+    return resp;
+}
+
+void EmulatedPedal::handleCommand(const QByteArray& cmd) {
+    if (cmd.size() < 8 || (uint8_t)cmd[0] != 0x3F || (uint8_t)cmd[1] != 0xAA || (uint8_t)cmd[2] != 0x55) {
+        counters.crcErrors++;
+        queueReply(statusQueue, status(0, false));
+        return;
+    }
+
+    // Length byte covers the payload after the subcommand; CRC spans bytes 3 .. 3 + len + 1
+    int len = (uint8_t)cmd[3];
+    int crcOffset = 3 + len + 2;
+    if (crcOffset + 2 > cmd.size()) {
+        counters.crcErrors++;
+        queueReply(statusQueue, status(0, false));
+        return;
+    }
+    uint16_t crc = ((uint8_t)cmd[crcOffset] << 8) | (uint8_t)cmd[crcOffset + 1];
+    uint8_t sub = (uint8_t)cmd[5];
+    if (crc != Protocol::calculateCRC16(cmd.mid(3, len + 2))) {
+        counters.crcErrors++;
+        queueReply(statusQueue, status(sub, false));
+        return;
+    }
+
+    const uchar* raw = reinterpret_cast<const uchar*>(cmd.constData());
+    switch (sub) {
+    case 0x82: { // Download / query
+        int slot = raw[6];
+        int chunk = qFromLittleEndian<uint16_t>(raw + 8);
+        QByteArray resp(CHUNK_SIZE, 0);
+        if (slot < (int)slots.size() && slots[slot].exists) {
+            const QByteArray& track = slots[slot].data;
+            if (chunk == 0) {
+                resp[0] = 0x01;
+                qToLittleEndian<uint32_t>(track.size(), reinterpret_cast<uchar*>(resp.data() + 4));
+            } else {
+                qint64 offset = (qint64)(chunk - 1) * CHUNK_SIZE;
+                if (offset < track.size()) {
+                    int n = std::min<qint64>(CHUNK_SIZE, track.size() - offset);
+                    memcpy(resp.data(), track.constData() + offset, n);
+                }
+            }
+        }
+        queueReply(dataQueue, resp);
+        break;
+    }
+    case 0x84: // Upload: the chunk itself follows on the data endpoint
+        pendingSlot = raw[6];
+        pendingChunk = qFromLittleEndian<uint16_t>(raw + 8);
+        queueReply(statusQueue, status(sub, pendingSlot < (int)slots.size()));
+        break;
+    case 0x86: // Init upload
+        pendingSlot = -1;
+        pendingChunk = -1;
+        queueReply(statusQueue, status(sub, true));
+        break;
+    case 0x88: { // Delete
+        int slot = qFromLittleEndian<uint16_t>(raw + 6);
+        if (slot < (int)slots.size()) slots[slot] = Slot();
+        queueReply(statusQueue, status(sub, slot < (int)slots.size()));
+        break;
+    }
+    case 0x8A: // Play / stop
+        queueReply(dataQueue, QByteArray(CHUNK_SIZE, 0));
+        break;
+    default:
+        queueReply(statusQueue, status(sub, false));
+        break;
+    }
+}
+
+void EmulatedPedal::handleData(const QByteArray& data) {
+    if (pendingSlot < 0 || pendingSlot >= (int)slots.size()) {
+        queueReply(statusQueue, status(0x84, false));
+        return;
+    }
+
+    Slot& slot = slots[pendingSlot];
+    if (pendingChunk == 0) {
+        // Meta chunk: little-endian size; the slot exists from here on
+        uint32_t size = data.size() >= 4 ? qFromLittleEndian<uint32_t>(reinterpret_cast<const uchar*>(data.constData())) : 0;
+        slot.exists = true;
+        slot.data = QByteArray();
+        slot.data.append(size, '\0');
+    } else if (slot.exists) {
+        qint64 offset = (qint64)(pendingChunk - 1) * CHUNK_SIZE;
+        if (offset < slot.data.size()) {
+            int n = std::min<qint64>(data.size(), slot.data.size() - offset);
+            memcpy(slot.data.data() + offset, data.constData(), n);
+        }
+    }
+    pendingChunk = -1;
+    queueReply(statusQueue, status(0x84, true));
+}
@@ -0,0 +1,89 @@
+#ifndef EMULATED_PEDAL_H
+#define EMULATED_PEDAL_H
+
+#include <QByteArray>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include "transport.h"
+
+// In-process GL100/GL200 speaking the looper protocol (0x82 download/query, 0x84 upload,
+// 0x86 init upload, 0x88 delete, 0x8A play) with CRC-checked commands. Latency, jitter and
+// error/timeout injection are seeded, so transfer timings are reproducible without hardware.
+class EmulatedPedal : public Transport {
+public:
+    // Bus/address that USBDevice::connect() maps to an emulated pedal
+    static const uint8_t BUS = 0xFF;
+    static const uint8_t ADDRESS = 0xFF;
+
+    struct Options {
+        std::chrono::microseconds latency{0};  // Added to every transfer
+        std::chrono::microseconds jitter{0};   // Uniform extra delay in [0, jitter]
+        std::chrono::milliseconds settle{0};   // Replaces the pedal's fixed settle waits
+        double errorRate = 0.0;                // Fraction of transfers failing with LIBUSB_ERROR_IO
+        double timeoutRate = 0.0;              // Fraction of transfers failing with LIBUSB_ERROR_TIMEOUT
+        double lateRate = 0.0;                 // Fraction of replies that only become readable after lateBy
+        std::chrono::milliseconds lateBy{0};
+        uint32_t seed = 1;
+        int tracks = 0;                        // Slots pre-filled with generated audio
+        double trackSeconds = 10.0;
+
+        // "latency=300,jitter=100,settle=0,errors=0.001,timeouts=0,late=0.05,lateby=200,seed=7,tracks=4,seconds=30"
+        // (latency/jitter in us, settle and lateby in ms)
+        static Options parse(const std::string& spec);
+    };
+
+    struct Stats {
+        uint64_t transfers = 0;
+        uint64_t bytesOut = 0;
+        uint64_t bytesIn = 0;
+        uint64_t crcErrors = 0;
+        uint64_t injectedErrors = 0;
+        uint64_t injectedTimeouts = 0;
+        uint64_t lateReplies = 0;
+    };
+
+    explicit EmulatedPedal(const Options& options = Options());
+
+    int transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) override;
+    void settle(std::chrono::milliseconds) override { std::this_thread::sleep_for(options.settle); }
+
+    void setTrack(int slot, const QByteArray& packed);
+    QByteArray track(int slot) const;
+    bool hasTrack(int slot) const;
+    const Stats& stats() const { return counters; }
+
+    static std::string serial() { return "EMULATED"; }
+
+private:
+    struct Slot {
+        bool exists = false;
+        QByteArray data;
+    };
+
+    struct Reply {
+        QByteArray data;
+        std::chrono::steady_clock::time_point ready;  // A read before this waits, or times out
+    };
+
+    Options options;
+    Stats counters;
+    std::mt19937 rng;
+    std::vector<Slot> slots;
+    std::deque<Reply> statusQueue; // Responses for EP_IN_STATUS
+    std::deque<Reply> dataQueue;   // Responses for EP_IN_DATA
+
+    // Upload in progress: the next write to the data endpoint belongs to this slot/chunk
+    int pendingSlot;
+    int pendingChunk;
+
+    void queueReply(std::deque<Reply>& queue, const QByteArray& data);
+    void handleCommand(const QByteArray& cmd);
+    void handleData(const QByteArray& data);
+    static QByteArray status(uint8_t subcommand, bool ok);
+};
+
+#endif // EMULATED_PEDAL_H
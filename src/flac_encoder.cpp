@@ -0,0 +1,393 @@
+#include "flac_encoder.h"
+#include "trace_events.h"
+#include <algorithm>
+#include <thread>
+#include <cstring>
+
+namespace {
+
+// Big-endian bit packer; FLAC fields are MSB first
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out(out), acc(0), bits(0) {}
+
+    void put(uint64_t value, int count) {
+        // count <= 32, so acc never holds more than 39 pending bits
+        if (count == 0) return;
+        acc = (acc << count) | (value & ((1ull << count) - 1));
+        bits += count;
+        while (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<uint8_t>(acc >> bits));
+        }
+    }
+
+    void putUnary(uint64_t zeros) {
+        while (zeros >= 32) {
+            put(0, 32);
+            zeros -= 32;
+        }
+        put(1, static_cast<int>(zeros) + 1);
+    }
+
+    void putRice(uint64_t folded, int k) {
+        putUnary(folded >> k);
+        put(folded, k);
+    }
+
+    void alignToByte() {
+        if (bits > 0) put(0, 8 - bits);
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint64_t acc;
+    int bits;
+};
+
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    CrcTables() {
+        for (int i = 0; i < 256; i++) {
+            uint8_t c8 = static_cast<uint8_t>(i);
+            for (int b = 0; b < 8; b++) c8 = (c8 & 0x80) ? static_cast<uint8_t>((c8 << 1) ^ 0x07) : static_cast<uint8_t>(c8 << 1);
+            crc8[i] = c8;
+
+            uint16_t c16 = static_cast<uint16_t>(i << 8);
+            for (int b = 0; b < 8; b++) c16 = (c16 & 0x8000) ? static_cast<uint16_t>((c16 << 1) ^ 0x8005) : static_cast<uint16_t>(c16 << 1);
+            crc16[i] = c16;
+        }
+    }
+};
+
+const CrcTables& crcTables() {
+    static const CrcTables tables;
+    return tables;
+}
+
+uint8_t crc8(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) crc = crcTables().crc8[crc ^ data[i]];
+    return crc;
+}
+
+uint16_t crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) crc = static_cast<uint16_t>((crc << 8) ^ crcTables().crc16[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+inline uint64_t fold(int64_t r) {
+    return (static_cast<uint64_t>(r) << 1) ^ static_cast<uint64_t>(r >> 63);
+}
+
+inline int64_t fixedResidual(const int32_t* x, int i, int order) {
+    switch (order) {
+    case 0: return x[i];
+    case 1: return static_cast<int64_t>(x[i]) - x[i - 1];
+    case 2: return static_cast<int64_t>(x[i]) - 2ll * x[i - 1] + x[i - 2];
+    case 3: return static_cast<int64_t>(x[i]) - 3ll * x[i - 1] + 3ll * x[i - 2] - x[i - 3];
+    default: return static_cast<int64_t>(x[i]) - 4ll * x[i - 1] + 6ll * x[i - 2] - 4ll * x[i - 3] + x[i - 4];
+    }
+}
+
+const int MAX_FIXED_ORDER = 4;
+const int MAX_PARTITION_ORDER = 8;
+const int MAX_RICE_PARAM = 30; // 31 is the escape code in the 5-bit method
+
+// Rice parameter minimising count*(k+1) + sum>>k for one partition
+int riceParam(uint64_t sum, uint64_t count, uint64_t& bits) {
+    int k = 0;
+    while (k < MAX_RICE_PARAM && (count << (k + 1)) < sum) k++;
+    int best = k;
+    bits = count * (k + 1) + (sum >> k);
+    for (int c = std::max(0, k - 2); c <= std::min(MAX_RICE_PARAM, k + 1); c++) {
+        uint64_t b = count * (c + 1) + (sum >> c);
+        if (b < bits) { bits = b; best = c; }
+    }
+    return best;
+}
+
+struct ResidualPlan {
+    int partitionOrder = 0;
+    std::vector<int> params;
+    bool wideParams = false;
+    uint64_t bits = 0;
+};
+
+// Chooses partition order and per-partition Rice parameters for folded residuals.
+// `folded` holds blockSize - order values; partition 0 is shortened by `order`.
+ResidualPlan planResidual(const std::vector<uint64_t>& folded, int blockSize, int order) {
+    ResidualPlan best;
+    best.bits = UINT64_MAX;
+
+    for (int p = 0; p <= MAX_PARTITION_ORDER; p++) {
+        if (blockSize % (1 << p) != 0) break;
+        int partLen = blockSize >> p;
+        if (partLen <= order) break;
+
+        ResidualPlan plan;
+        plan.partitionOrder = p;
+        plan.bits = 2 + 4;
+        size_t pos = 0;
+        for (int i = 0; i < (1 << p); i++) {
+            size_t count = (i == 0) ? partLen - order : partLen;
+            uint64_t sum = 0;
+            for (size_t j = 0; j < count; j++) sum += folded[pos + j];
+            pos += count;
+
+            uint64_t bits;
+            int k = riceParam(sum, count, bits);
+            if (k > 14) plan.wideParams = true;
+            plan.params.push_back(k);
+            plan.bits += bits;
+        }
+        plan.bits += static_cast<uint64_t>(plan.params.size()) * (plan.wideParams ? 5 : 4);
+
+        if (plan.bits < best.bits) best = std::move(plan);
+    }
+    return best;
+}
+
+struct SubframePlan {
+    enum Type { Constant, Verbatim, Fixed } type = Verbatim;
+    int order = 0;
+    ResidualPlan residual;
+    uint64_t bits = 0;
+};
+
+SubframePlan planSubframe(const int32_t* x, int n, int bps) {
+    SubframePlan best;
+    best.type = SubframePlan::Verbatim;
+    best.bits = 8 + static_cast<uint64_t>(n) * bps;
+
+    bool constant = true;
+    for (int i = 1; i < n && constant; i++) constant = (x[i] == x[0]);
+    if (constant) {
+        best.type = SubframePlan::Constant;
+        best.bits = 8 + bps;
+        return best;
+    }
+
+    std::vector<uint64_t> folded(n);
+    for (int order = 0; order <= MAX_FIXED_ORDER && order < n; order++) {
+        folded.resize(n - order);
+        for (int i = order; i < n; i++) folded[i - order] = fold(fixedResidual(x, i, order));
+
+        ResidualPlan residual = planResidual(folded, n, order);
+        uint64_t bits = 8 + static_cast<uint64_t>(order) * bps + residual.bits;
+        if (bits < best.bits) {
+            best.type = SubframePlan::Fixed;
+            best.order = order;
+            best.residual = std::move(residual);
+            best.bits = bits;
+        }
+    }
+    return best;
+}
+
+void writeSubframe(BitWriter& bw, const SubframePlan& plan, const int32_t* x, int n, int bps) {
+    if (plan.type == SubframePlan::Constant) {
+        bw.put(0x00, 8);
+        bw.put(static_cast<uint32_t>(x[0]), bps);
+        return;
+    }
+    if (plan.type == SubframePlan::Verbatim) {
+        bw.put(0x02, 8);
+        for (int i = 0; i < n; i++) bw.put(static_cast<uint32_t>(x[i]), bps);
+        return;
+    }
+
+    bw.put((0x08 | plan.order) << 1, 8);
+    for (int i = 0; i < plan.order; i++) bw.put(static_cast<uint32_t>(x[i]), bps);
+
+    const ResidualPlan& r = plan.residual;
+    bw.put(r.wideParams ? 1 : 0, 2);
+    bw.put(r.partitionOrder, 4);
+
+    int partLen = n >> r.partitionOrder;
+    int i = plan.order;
+    for (size_t p = 0; p < r.params.size(); p++) {
+        int end = static_cast<int>(p + 1) * partLen;
+        int k = r.params[p];
+        bw.put(k, r.wideParams ? 5 : 4);
+        for (; i < end; i++) bw.putRice(fold(fixedResidual(x, i, plan.order)), k);
+    }
+}
+
+void putUtf8(std::vector<uint8_t>& out, uint32_t v) {
+    if (v < 0x80) {
+        out.push_back(static_cast<uint8_t>(v));
+        return;
+    }
+    int extra = (v < 0x800) ? 1 : (v < 0x10000) ? 2 : (v < 0x200000) ? 3 : (v < 0x4000000) ? 4 : 5;
+    uint8_t lead = static_cast<uint8_t>((0xFF00 >> (extra + 1)) & 0xFF);
+    out.push_back(static_cast<uint8_t>(lead | (v >> (6 * extra))));
+    for (int i = extra - 1; i >= 0; i--) {
+        out.push_back(static_cast<uint8_t>(0x80 | ((v >> (6 * i)) & 0x3F)));
+    }
+}
+
+int blockSizeCode(int n) {
+    for (int code = 8; code <= 15; code++) {
+        if (n == (256 << (code - 8))) return code;
+    }
+    return (n <= 256) ? 6 : 7;
+}
+
+int sampleRateCode(uint32_t rate) {
+    switch (rate) {
+    case 44100: return 0x9;
+    case 48000: return 0xA;
+    case 96000: return 0xB;
+    default: return 0x0; // Take it from STREAMINFO
+    }
+}
+
+inline int32_t unpack24(const uint8_t* p) {
+    int32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v << 8) >> 8;
+}
+
+} // namespace
+
+void FlacEncoder::encodeFrame(std::vector<uint8_t>& out, const int32_t* left, const int32_t* right,
+                              int blockSize, uint32_t frameNumber, uint32_t sampleRate) {
+    size_t frameStart = out.size();
+
+    std::vector<int32_t> side(blockSize), mid(blockSize);
+    for (int i = 0; i < blockSize; i++) {
+        side[i] = left[i] - right[i];
+        mid[i] = (left[i] + right[i]) >> 1;
+    }
+
+    SubframePlan pl = planSubframe(left, blockSize, 24);
+    SubframePlan pr = planSubframe(right, blockSize, 24);
+    SubframePlan ps = planSubframe(side.data(), blockSize, 25);
+    SubframePlan pm = planSubframe(mid.data(), blockSize, 24);
+
+    // Channel assignment: 0x1 independent, 0x8 left/side, 0x9 side/right, 0xA mid/side
+    int assignment = 0x1;
+    uint64_t bestBits = pl.bits + pr.bits;
+    if (pl.bits + ps.bits < bestBits) { assignment = 0x8; bestBits = pl.bits + ps.bits; }
+    if (ps.bits + pr.bits < bestBits) { assignment = 0x9; bestBits = ps.bits + pr.bits; }
+    if (pm.bits + ps.bits < bestBits) { assignment = 0xA; bestBits = pm.bits + ps.bits; }
+
+    // Frame header
+    int bsCode = blockSizeCode(blockSize);
+    out.push_back(0xFF);
+    out.push_back(0xF8); // Sync + fixed blocking strategy
+    out.push_back(static_cast<uint8_t>((bsCode << 4) | sampleRateCode(sampleRate)));
+    out.push_back(static_cast<uint8_t>((assignment << 4) | (0x6 << 1))); // 24 bits per sample
+    putUtf8(out, frameNumber);
+    if (bsCode == 6) {
+        out.push_back(static_cast<uint8_t>(blockSize - 1));
+    } else if (bsCode == 7) {
+        out.push_back(static_cast<uint8_t>((blockSize - 1) >> 8));
+        out.push_back(static_cast<uint8_t>((blockSize - 1) & 0xFF));
+    }
+    out.push_back(crc8(out.data() + frameStart, out.size() - frameStart));
+
+    BitWriter bw(out);
+    switch (assignment) {
+    case 0x8:
+        writeSubframe(bw, pl, left, blockSize, 24);
+        writeSubframe(bw, ps, side.data(), blockSize, 25);
+        break;
+    case 0x9:
+        writeSubframe(bw, ps, side.data(), blockSize, 25);
+        writeSubframe(bw, pr, right, blockSize, 24);
+        break;
+    case 0xA:
+        writeSubframe(bw, pm, mid.data(), blockSize, 24);
+        writeSubframe(bw, ps, side.data(), blockSize, 25);
+        break;
+    default:
+        writeSubframe(bw, pl, left, blockSize, 24);
+        writeSubframe(bw, pr, right, blockSize, 24);
+        break;
+    }
+    bw.alignToByte();
+
+    uint16_t crc = crc16(out.data() + frameStart, out.size() - frameStart);
+    out.push_back(static_cast<uint8_t>(crc >> 8));
+    out.push_back(static_cast<uint8_t>(crc & 0xFF));
+}
+
+std::vector<uint8_t> FlacEncoder::encodePacked24(const uint8_t* data, size_t size,
+                                                 uint32_t sampleRate, const uint8_t* md5, int threads) {
+    const uint64_t totalFrames = size / 6;
+    const uint32_t blockCount = static_cast<uint32_t>((totalFrames + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads <= 0) threads = 1;
+    threads = static_cast<int>(std::min<uint32_t>(static_cast<uint32_t>(threads), std::max<uint32_t>(blockCount, 1)));
+
+    // Each worker encodes a contiguous run of blocks into its own buffer
+    std::vector<std::vector<uint8_t>> parts(threads);
+    std::vector<uint32_t> minFrame(threads, UINT32_MAX), maxFrame(threads, 0);
+
+    auto encodeRange = [&](int t) {
+        uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(blockCount) * t / threads);
+        uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(blockCount) * (t + 1) / threads);
+        std::vector<int32_t> left(BLOCK_SIZE), right(BLOCK_SIZE);
+        MOOER_TRACE_SCOPE("audio", "encodeFlacBlocks", last - first);
+        std::vector<uint8_t>& out = parts[t];
+        out.reserve(static_cast<size_t>(last - first) * BLOCK_SIZE * 4);
+
+        for (uint32_t b = first; b < last; b++) {
+            uint64_t frame0 = static_cast<uint64_t>(b) * BLOCK_SIZE;
+            int n = static_cast<int>(std::min<uint64_t>(BLOCK_SIZE, totalFrames - frame0));
+            const uint8_t* p = data + frame0 * 6;
+            for (int i = 0; i < n; i++, p += 6) {
+                left[i] = unpack24(p);
+                right[i] = unpack24(p + 3);
+            }
+            size_t before = out.size();
+            encodeFrame(out, left.data(), right.data(), n, b, sampleRate);
+            uint32_t frameBytes = static_cast<uint32_t>(out.size() - before);
+            minFrame[t] = std::min(minFrame[t], frameBytes);
+            maxFrame[t] = std::max(maxFrame[t], frameBytes);
+        }
+    };
+
+    if (threads == 1) {
+        encodeRange(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; t++) pool.emplace_back(encodeRange, t);
+        for (auto& th : pool) th.join();
+    }
+
+    uint32_t minFrameSize = *std::min_element(minFrame.begin(), minFrame.end());
+    uint32_t maxFrameSize = *std::max_element(maxFrame.begin(), maxFrame.end());
+    if (blockCount == 0) minFrameSize = maxFrameSize = 0;
+
+    std::vector<uint8_t> out;
+    size_t payload = 0;
+    for (const auto& part : parts) payload += part.size();
+    out.reserve(4 + 4 + 34 + payload);
+
+    out.insert(out.end(), {'f', 'L', 'a', 'C'});
+    out.push_back(0x80); // Last metadata block, type 0 (STREAMINFO)
+    out.push_back(0x00);
+    out.push_back(0x00);
+    out.push_back(34);
+
+    BitWriter bw(out);
+    bw.put(BLOCK_SIZE, 16);
+    bw.put(BLOCK_SIZE, 16);
+    bw.put(minFrameSize, 24);
+    bw.put(maxFrameSize, 24);
+    bw.put(sampleRate, 20);
+    bw.put(2 - 1, 3);
+    bw.put(24 - 1, 5);
+    bw.put(totalFrames >> 32, 4);
+    bw.put(totalFrames & 0xFFFFFFFF, 32);
+    for (int i = 0; i < 16; i++) bw.put(md5 ? md5[i] : 0, 8);
+
+    for (const auto& part : parts) out.insert(out.end(), part.begin(), part.end());
+    return out;
+}
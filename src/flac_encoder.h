@@ -0,0 +1,24 @@
+#ifndef FLAC_ENCODER_H
+#define FLAC_ENCODER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class FlacEncoder {
+public:
+    static const int BLOCK_SIZE = 4096;
+
+    // Encodes the pedal's packed stream (stereo, 24-bit little endian, 6 bytes per frame)
+    // into a complete FLAC file image. Frames are independent, so blocks are spread
+    // across `threads` workers (0 = hardware concurrency) and concatenated in order.
+    // `md5` is the STREAMINFO signature of the packed bytes; nullptr leaves it unset.
+    static std::vector<uint8_t> encodePacked24(const uint8_t* data, size_t size, uint32_t sampleRate = 44100,
+                                               const uint8_t* md5 = nullptr, int threads = 0);
+
+private:
+    static void encodeFrame(std::vector<uint8_t>& out, const int32_t* left, const int32_t* right,
+                            int blockSize, uint32_t frameNumber, uint32_t sampleRate);
+};
+
+#endif // FLAC_ENCODER_H
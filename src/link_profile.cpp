@@ -0,0 +1,162 @@
+#include "link_profile.h"
+#include "pedal_mirror.h"
+#include "trace_events.h"
+#include <QSettings>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+const int RTT_SAMPLES = 32;
+const int BENCH_CHUNKS = 256;
+const int MIN_CHUNK_TIMEOUT_MS = 100;
+const size_t DEFAULT_PIPELINE_DEPTH = 64;
+const size_t MAX_PIPELINE_DEPTH = 1024;
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsBetween(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+}
+
+QString settingsGroup(const std::string& serial) {
+    return "linkProfiles/" + QString::fromStdString(serial);
+}
+}
+
+int LinkProfile::chunkTimeoutMs() const {
+    if (!isValid()) return USBDevice::DEFAULT_TIMEOUT_MS;
+    // A chunk normally takes no longer than a header query; allow 8x the worst one seen
+    double worstUs = rttP99Us;
+    if (downloadChunksPerSec > 0) worstUs = std::max(worstUs, 1e6 / downloadChunksPerSec);
+    int ms = static_cast<int>(std::ceil(worstUs * 8 / 1000));
+    return std::clamp(ms, MIN_CHUNK_TIMEOUT_MS, USBDevice::DEFAULT_TIMEOUT_MS);
+}
+
+size_t LinkProfile::pipelineDepth() const {
+    if (downloadChunksPerSec <= 0) return DEFAULT_PIPELINE_DEPTH;
+    // The target spends ~1 s settling before it takes the first chunk
+    size_t depth = static_cast<size_t>(std::ceil(downloadChunksPerSec * 1.5));
+    return std::clamp(depth, DEFAULT_PIPELINE_DEPTH, MAX_PIPELINE_DEPTH);
+}
+
+std::string LinkProfile::describe() const {
+    if (!isValid()) return "not measured";
+    // Chunks are 1 KB, so chunks/s reads as KB/s
+    char text[256];
+    snprintf(text, sizeof(text), "round trip %.2f ms (p99 %.2f ms), download %.0f KB/s, upload %.0f KB/s, chunk timeout %d ms",
+             rttMedianUs / 1000, rttP99Us / 1000, downloadChunksPerSec, uploadChunksPerSec, chunkTimeoutMs());
+    return text;
+}
+
+LinkProfile LinkProfile::load(const std::string& serial) {
+    LinkProfile profile;
+    if (serial.empty()) return profile;
+    QSettings settings;
+    settings.beginGroup(settingsGroup(serial));
+    profile.rttMedianUs = settings.value("rttMedianUs", 0.0).toDouble();
+    profile.rttP99Us = settings.value("rttP99Us", 0.0).toDouble();
+    profile.downloadChunksPerSec = settings.value("downloadChunksPerSec", 0.0).toDouble();
+    profile.uploadChunksPerSec = settings.value("uploadChunksPerSec", 0.0).toDouble();
+    profile.measured = settings.value("measured").toDateTime();
+    return profile;
+}
+
+void LinkProfile::save(const std::string& serial, const LinkProfile& profile) {
+    if (serial.empty()) return;
+    QSettings settings;
+    settings.beginGroup(settingsGroup(serial));
+    settings.setValue("rttMedianUs", profile.rttMedianUs);
+    settings.setValue("rttP99Us", profile.rttP99Us);
+    settings.setValue("downloadChunksPerSec", profile.downloadChunksPerSec);
+    settings.setValue("uploadChunksPerSec", profile.uploadChunksPerSec);
+    settings.setValue("measured", profile.measured);
+}
+
+LinkProfile LinkProfile::measure(USBDevice& device, bool quick, USBDevice::ProgressCallback callback, void* userData,
+                                 const std::function<void()>& checkpoint) {
+    MOOER_TRACE_SCOPE("usb", "measureLink");
+    LinkProfile profile = load(device.getSerial());
+    int previousTimeout = device.getChunkTimeout();
+    // Measure with the full timeout so an old profile can't cut a slower link short
+    device.setChunkTimeout(USBDevice::DEFAULT_TIMEOUT_MS);
+
+    size_t steps = quick ? RTT_SAMPLES : RTT_SAMPLES + Protocol::MAX_TRACKS + 2 * BENCH_CHUNKS;
+    size_t step = 0;
+    auto advance = [&]() {
+        step++;
+        if (callback) callback(step, steps, userData);
+        if (checkpoint) checkpoint();
+    };
+
+    int scratch = -1;
+    try {
+        // 1. Command round trips (header query of slot 0)
+        std::vector<double> rtts;
+        for (int i = 0; i < RTT_SAMPLES; i++) {
+            Clock::time_point start = Clock::now();
+            device.queryTrack(0);
+            rtts.push_back(secondsBetween(start, Clock::now()) * 1e6);
+            advance();
+        }
+        std::sort(rtts.begin(), rtts.end());
+        profile.rttMedianUs = rtts[rtts.size() / 2];
+        profile.rttP99Us = rtts[std::min(rtts.size() - 1, static_cast<size_t>(std::ceil(rtts.size() * 0.99)) - 1)];
+
+        if (!quick) {
+            std::vector<TrackInfo> tracks = device.listTracks();
+            step += Protocol::MAX_TRACKS;
+            int occupied = -1;
+            for (const TrackInfo& t : tracks) {
+                if (t.has_track && occupied < 0) occupied = t.slot;
+                if (!t.has_track) scratch = t.slot;
+            }
+
+            // 2. Upload rate: silence into the scratch slot, timed between the first and last chunk pulled
+            if (scratch >= 0) {
+                PedalMirror(device.getSerial()).invalidate(scratch);
+                QByteArray silence(1024, '\0');
+                int pulled = 0;
+                Clock::time_point first, last;
+                device.uploadTrackChunks(scratch, BENCH_CHUNKS * 1024, [&]() {
+                    last = Clock::now();
+                    if (pulled++ == 0) first = last;
+                    advance();
+                    return silence;
+                });
+                if (pulled > 1) profile.uploadChunksPerSec = (pulled - 1) / secondsBetween(first, last);
+            }
+
+            // 3. Download rate: an existing track, or the one just uploaded
+            int source = occupied >= 0 ? occupied : scratch;
+            if (source >= 0) {
+                int received = 0;
+                Clock::time_point first, last;
+                device.readTrackChunks(source, [&](int, int, const QByteArray&) {
+                    last = Clock::now();
+                    if (received++ == 0) first = last;
+                    advance();
+                    return received < BENCH_CHUNKS;
+                });
+                if (received > 1) profile.downloadChunksPerSec = (received - 1) / secondsBetween(first, last);
+            }
+
+            if (scratch >= 0) device.deleteTrack(scratch);
+        }
+    } catch (...) {
+        device.setChunkTimeout(previousTimeout);
+        // Don't leave a partial scratch track behind
+        if (scratch >= 0) {
+            try { device.deleteTrack(scratch); } catch (...) {}
+        }
+        throw;
+    }
+
+    profile.measured = QDateTime::currentDateTime();
+    save(device.getSerial(), profile);
+    device.setChunkTimeout(profile.chunkTimeoutMs());
+    if (callback) callback(steps, steps, userData);
+    return profile;
+}
@@ -0,0 +1,40 @@
+#ifndef LINK_PROFILE_H
+#define LINK_PROFILE_H
+
+#include <QDateTime>
+#include <functional>
+#include <string>
+#include "usb_device.h"
+
+// Measured speed of one pedal's USB link (cable, hub, port), stored per serial.
+// Later transfers derive their timeouts and pipeline depth from it instead of
+// assuming the worst case.
+struct LinkProfile {
+    double rttMedianUs = 0;        // Header query round trip
+    double rttP99Us = 0;
+    double downloadChunksPerSec = 0;
+    double uploadChunksPerSec = 0;
+    QDateTime measured;
+
+    bool isValid() const { return rttMedianUs > 0; }
+
+    // Per-chunk read timeout: generous against the slowest round trip seen, far below the 5 s default
+    int chunkTimeoutMs() const;
+    // Clone pipe capacity (chunks): enough to keep the source reading through the target's settle delays
+    size_t pipelineDepth() const;
+    std::string describe() const;
+
+    // Invalid profile if the pedal was never measured or has no serial
+    static LinkProfile load(const std::string& serial);
+    static void save(const std::string& serial, const LinkProfile& profile);
+
+    // Times header queries and, unless `quick`, a download and an upload of 256 chunks.
+    // The upload goes to the last empty slot and is deleted afterwards; without a free
+    // slot the upload rate keeps its previous value. Applies and saves the result.
+    // `checkpoint` runs after every step and may throw to abandon the measurement.
+    static LinkProfile measure(USBDevice& device, bool quick = false,
+                               USBDevice::ProgressCallback callback = nullptr, void* userData = nullptr,
+                               const std::function<void()>& checkpoint = nullptr);
+};
+
+#endif // LINK_PROFILE_H
@@ -1,11 +1,30 @@
 #include <QApplication>
+#include <QTimer>
 #include "mainwindow.h"
+#include "trace_events.h"
+#include "startup_profile.h"
+#include <cstring>
 
 int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--profile-startup") == 0) StartupProfile::enable();
+    }
     QApplication app(argc, argv);
+    StartupProfile::mark("QApplication");
     app.setOrganizationName("MooerLooperManager");
     app.setApplicationName("MooerLooperManager");
-    MainWindow w;
-    w.show();
-    return app.exec();
+    TraceEvents::startFromEnvironment();
+    TraceEvents::setThreadName("GUI");
+    int status;
+    {
+        MainWindow w;
+        w.show();
+        StartupProfile::mark("shown");
+        // Queued behind the show so the first frame is not held up by libusb, but not tied to
+        // a paint: a window started minimised or off-screen still finds its pedals
+        QTimer::singleShot(0, &w, &MainWindow::startDeviceDiscovery);
+        status = app.exec();
+    }
+    TraceEvents::stop();
+    return status;
 }
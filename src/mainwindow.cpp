@@ -12,85 +12,31 @@
 #include <QFileInfo>
 #include <QSettings>
 #include <QShortcut>
+#include <QInputDialog>
+#include <QCheckBox>
+#include "slot_planner.h"
+#include "daemon_client.h"
+#include "diagnostics_dialog.h"
+#include "audio_settings_dialog.h"
 #include <iostream>
-#include <portaudio.h>
-
-// HotplugMonitor implementation
-HotplugMonitor::HotplugMonitor(QObject* parent)
-    : QThread(parent), ctx(nullptr), callbackHandle(0), stopFlag(false) {
-    libusb_init(&ctx);
-}
-
-HotplugMonitor::~HotplugMonitor() {
-    stop();
-    if (ctx) {
-        libusb_exit(ctx);
-    }
-}
-
-void HotplugMonitor::stop() {
-    stopFlag = true;
-    if (ctx && callbackHandle) {
-        libusb_hotplug_deregister_callback(ctx, callbackHandle);
-        callbackHandle = 0;
-    }
-    if (isRunning()) {
-        // Interrupt the blocking libusb_handle_events call
-        libusb_interrupt_event_handler(ctx);
-        wait();
-    }
-}
-
-int HotplugMonitor::hotplugCallback(libusb_context* ctx, libusb_device* dev,
-                                     libusb_hotplug_event event, void* userData) {
-    Q_UNUSED(ctx);
-    Q_UNUSED(dev);
-    Q_UNUSED(event);
-    HotplugMonitor* monitor = static_cast<HotplugMonitor*>(userData);
-    emit monitor->deviceChanged();
-    return 0;  // Keep the callback registered
+#include <algorithm>
+#include <climits>
+#include "playback.h"
+#include "startup_profile.h"
+
+namespace {
+// Time udev gets to apply a freshly installed rule before permissions are re-read
+const int UDEV_SETTLE_MS = 1000;
 }
 
-void HotplugMonitor::run() {
-    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
-        std::cerr << "Hotplug not supported on this platform" << std::endl;
-        return;
-    }
-
-    int rc = libusb_hotplug_register_callback(
-        ctx,
-        static_cast<libusb_hotplug_event>(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
-        LIBUSB_HOTPLUG_NO_FLAGS,
-        Protocol::VENDOR_ID,
-        LIBUSB_HOTPLUG_MATCH_ANY,  // Any product ID
-        LIBUSB_HOTPLUG_MATCH_ANY,  // Any device class
-        hotplugCallback,
-        this,
-        &callbackHandle
-    );
-
-    if (rc != LIBUSB_SUCCESS) {
-        std::cerr << "Failed to register hotplug callback: " << libusb_error_name(rc) << std::endl;
-        return;
-    }
-
-    while (!stopFlag) {
-        int rc = libusb_handle_events(ctx);
-        if (rc < 0 && rc != LIBUSB_ERROR_INTERRUPTED) {
-            std::cerr << "libusb_handle_events error: " << libusb_error_name(rc) << std::endl;
-            break;
-        }
-    }
-}
-
-// FileDropTableWidget implementation
-void FileDropTableWidget::dragEnterEvent(QDragEnterEvent* event) {
+// FileDropTableView implementation
+void FileDropTableView::dragEnterEvent(QDragEnterEvent* event) {
     if (event->mimeData()->hasUrls()) {
         event->acceptProposedAction();
     }
 }
 
-void FileDropTableWidget::dragMoveEvent(QDragMoveEvent* event) {
+void FileDropTableView::dragMoveEvent(QDragMoveEvent* event) {
     if (event->mimeData()->hasUrls()) {
         event->acceptProposedAction();
         QPoint pos = event->position().toPoint();
@@ -103,12 +49,12 @@ void FileDropTableWidget::dragMoveEvent(QDragMoveEvent* event) {
     }
 }
 
-void FileDropTableWidget::dragLeaveEvent(QDragLeaveEvent* event) {
+void FileDropTableView::dragLeaveEvent(QDragLeaveEvent* event) {
     Q_UNUSED(event);
     clearSelection();
 }
 
-void FileDropTableWidget::dropEvent(QDropEvent* event) {
+void FileDropTableView::dropEvent(QDropEvent* event) {
     clearSelection();
     const QMimeData* mimeData = event->mimeData();
     if (mimeData->hasUrls()) {
@@ -125,14 +71,8 @@ void FileDropTableWidget::dropEvent(QDropEvent* event) {
             QPoint pos = event->position().toPoint();
             int row = rowAt(pos.y());
             if (row < 0) {
-                // Find first empty slot (duration shows "—" for empty slots)
-                for (int r = 0; r < rowCount(); r++) {
-                    QTableWidgetItem* durItem = item(r, 0);
-                    if (durItem && durItem->text() == QString::fromUtf8("\u2014")) {
-                        row = r;
-                        break;
-                    }
-                }
+                auto* tracks = qobject_cast<TrackTableModel*>(model());
+                row = tracks ? tracks->firstEmptySlot() : -1;
                 if (row < 0) {
                     QMessageBox::warning(nullptr, "No Empty Slots",
                         "All slots are occupied. Delete a track first.");
@@ -146,88 +86,143 @@ void FileDropTableWidget::dropEvent(QDropEvent* event) {
 
 // MainWindow implementation
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), worker(nullptr), hotplugMonitor(nullptr),
-      playbackVolume(100), currentPlayingSlot(-1), currentPlayingDuration(0.0), currentProgressTime(0.0), 
-      isSeeking(false), isPaused(false),
-      cancelBtn(nullptr) {
-    Pa_Initialize();
+    : QMainWindow(parent), deviceRegistry(nullptr),
+      playbackVolume(100), isSeeking(false), cancelBtn(nullptr) {
+    // PortAudio is initialized by the first playback; device discovery is queued by main() once
+    // the window is shown (startDeviceDiscovery)
     lastFileDialogDir = QSettings().value("lastFileDialogDir").toString();
     playbackVolume = QSettings().value("playbackVolume", 100).toInt();
     setupUi();
+    StartupProfile::mark("window built");
+
+    // Workers only publish progress; it is picked up here at display rate
+    progressTimer = new QTimer(this);
+    connect(progressTimer, &QTimer::timeout, this, &MainWindow::onProgressTimer);
+    progressTimer->start(50);
+
+    // The seek slider and time follow the audio clock at display rate while playing
+    transportTimer = new QTimer(this);
+    transportTimer->setTimerType(Qt::PreciseTimer);
+    transportTimer->setInterval(16);
+    connect(transportTimer, &QTimer::timeout, this, &MainWindow::onTransportTimer);
+
+    // Descriptors are read on the registry thread; the first list arrives via onDevicesChanged
+    deviceRegistry = new DeviceRegistry(this);
+    connect(deviceRegistry, &DeviceRegistry::devicesChanged, this, &MainWindow::onDevicesChanged);
+}
 
-    hotplugMonitor = new HotplugMonitor(this);
-    connect(hotplugMonitor, &HotplugMonitor::deviceChanged, this, [this]() {
-        if (device.isConnected()) {
-            // Check if our connected device was removed
-            auto devices = USBDevice::enumerateDevices();
-            bool found = false;
-            for (const auto& d : devices) {
-                if (d.bus == device.getBus() && d.address == device.getAddress()) {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                stopExistingWorker();
-                device.disconnect();
-                connectBtn->setText("Connect");
-                statusLabel->setText("Device disconnected");
-                statusLabel->setStyleSheet("color: red; font-weight: bold;");
-                refreshBtn->setEnabled(false);
-                deviceCombo->setEnabled(true);
-                trackTable->setRowCount(0);
-                currentPlayingSlot = -1;
-                setActionsEnabled(true);
-                refreshDeviceList();
-            }
-        } else {
-            refreshDeviceList();
-        }
-    });
-    hotplugMonitor->start();
+void MainWindow::paintEvent(QPaintEvent* event) {
+    QMainWindow::paintEvent(event);
+    if (painted) return;
+    painted = true;
+    StartupProfile::mark("first paint");
+}
 
-    // Auto-connect if exactly one device with permissions is available
-    if (deviceList.size() == 1 && deviceList[0].hasPermission) {
-        deviceCombo->setCurrentIndex(0);
-        onConnectClicked();
-    }
+void MainWindow::startDeviceDiscovery() {
+    if (deviceRegistry->isRunning()) return;
+    deviceRegistry->start();
+    StartupProfile::mark("device registry started");
 }
 
 MainWindow::~MainWindow() {
-    if (hotplugMonitor) {
-        hotplugMonitor->stop();
+    if (deviceRegistry) {
+        deviceRegistry->stop();
+    }
+    for (const auto& session : sessions) {
+        stopExistingWorker(session.get());
+    }
+    for (const QPointer<Worker>& worker : abandonedConnects) {
+        delete worker.data();  // Waits for the thread, then drops the session it kept
+    }
+    Playback::terminate();
+}
+
+PedalSession* MainWindow::currentSession() const {
+    QWidget* page = deviceTabs->currentWidget();
+    for (const auto& session : sessions) {
+        if (session->trackTable == page) return session.get();
+    }
+    return nullptr;
+}
+
+PedalSession* MainWindow::sessionForWorker(QObject* worker) const {
+    if (!worker) return nullptr;
+    for (const auto& session : sessions) {
+        if (session->worker == worker) return session.get();
+    }
+    return nullptr;
+}
+
+PedalSession* MainWindow::sessionForDevice(const DeviceInfo& info) const {
+    for (const auto& session : sessions) {
+        if (session->info.bus == info.bus && session->info.address == info.address) return session.get();
+    }
+    return nullptr;
+}
+
+bool MainWindow::isCloneTarget(PedalSession* session) const {
+    for (const auto& s : sessions) {
+        if (s->cloneTarget == session) return true;
     }
-    stopExistingWorker();
-    Pa_Terminate();
+    return false;
+}
+
+bool MainWindow::isConnecting(PedalSession* session) const {
+    return session && session->worker && session->worker->getOperation() == Worker::Connect;
+}
+
+bool MainWindow::isLocked(PedalSession* session) const {
+    return isCloneTarget(session) || isConnecting(session);
 }
 
-bool MainWindow::stopExistingWorker() {
-    if (worker) {
+void MainWindow::startWorker(PedalSession* session, Worker* w) {
+    session->worker = w;
+    session->progressCurrent = 0;
+    session->progressTotal = 0;
+    session->progressUpdates = 0;
+    session->meter.start();
+    connect(w, &Worker::tracksLoaded, this, &MainWindow::onTracksLoaded);
+    connect(w, &Worker::tracksUpdated, this, &MainWindow::onTracksUpdated);
+    connect(w, &Worker::linkMeasured, this, &MainWindow::onLinkMeasured);
+    connect(w, &Worker::phaseChanged, this, &MainWindow::onWorkerPhase);
+    connect(w, &Worker::finished, this, &MainWindow::onWorkerFinished);
+    connect(w, &Worker::error, this, &MainWindow::onWorkerError);
+    w->start();
+}
+
+bool MainWindow::stopExistingWorker(PedalSession* session) {
+    if (session && session->worker) {
+        Worker* w = session->worker;
         // Disconnect first to avoid any signals being processed while we are stopping/deleting
-        disconnect(worker, nullptr, nullptr, nullptr);
+        disconnect(w, nullptr, nullptr, nullptr);
 
-        worker->stop();
+        w->stop();
 
         // If playing, send an explicit stop command to the device to abort internal state
-        if (worker->getOperation() == Worker::Play && currentPlayingSlot != -1) {
-            device.stopPlayback(currentPlayingSlot);
+        if (w->getOperation() == Worker::Play && session->currentPlayingSlot != -1) {
+            session->device.stopPlayback(session->currentPlayingSlot);
         }
 
-        worker->wait();
+        w->wait();
+        pollProgress(session);
 
-        if (worker->getOperation() == Worker::Play) {
-            playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPlay));
-            playPauseBtn->setToolTip("Play Selected Track");
-            stopBtn->setEnabled(false);
-            currentPlayingSlot = -1;
-            isPaused = false;
-            currentProgressTime = 0.0;
-            statusLabel->setText("Connected");
+        if (w->getOperation() == Worker::Play) {
+            session->currentPlayingSlot = -1;
+            session->isPaused = false;
+            session->currentProgressTime = 0.0;
+            session->status = "Connected";
         }
 
-        seekSlider->setVisible(false); cancelBtn->setVisible(false); timeLabel->setVisible(false);
-        delete worker;
-        worker = nullptr;
+        delete w;
+        session->worker = nullptr;
+        if (PedalSession* target = session->cloneTarget) {
+            session->cloneTarget = nullptr;
+            target->status = "Connected";
+            updateTabTitle(target);
+            setActionsEnabled(target, true);
+        }
+        updateTabTitle(session);
+        if (session == currentSession()) updateSessionUi();
     }
     return true;
 }
@@ -260,52 +255,37 @@ void MainWindow::setupUi() {
     connect(refreshBtn, &QPushButton::clicked, this, &MainWindow::onRefreshClicked);
     refreshBtn->setEnabled(false);
 
+    QPushButton* diagnosticsBtn = new QPushButton("Diagnostics");
+    diagnosticsBtn->setToolTip("USB latency, timeout and throughput metrics (Ctrl+Shift+D)");
+    connect(diagnosticsBtn, &QPushButton::clicked, this, &MainWindow::onDiagnosticsClicked);
+    QPushButton* audioBtn = new QPushButton("Audio Output");
+    audioBtn->setToolTip("Playback device, host API, buffer size and latency");
+    connect(audioBtn, &QPushButton::clicked, this, &MainWindow::onAudioSettingsClicked);
+
     topLayout->addWidget(connectBtn);
     topLayout->addWidget(statusLabel);
     topLayout->addStretch();
+    benchmarkBtn = new QPushButton("Benchmark Link");
+    benchmarkBtn->setToolTip("Measure this pedal's USB latency and transfer rates and tune timeouts to them");
+    connect(benchmarkBtn, &QPushButton::clicked, this, &MainWindow::onBenchmarkClicked);
+    benchmarkBtn->setEnabled(false);
+
+    topLayout->addWidget(diagnosticsBtn);
+    topLayout->addWidget(audioBtn);
+    topLayout->addWidget(benchmarkBtn);
     topLayout->addWidget(refreshBtn);
     mainLayout->addLayout(topLayout);
 
     refreshDeviceList();
-
-    trackTable = new FileDropTableWidget();
-    trackTable->setColumnCount(3);
-    trackTable->setHorizontalHeaderLabels({"Duration", "Size", "Actions"});
-    trackTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
-    trackTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
-    trackTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Stretch);
-
-    trackTable->verticalHeader()->setVisible(true);
-    trackTable->verticalHeader()->setDefaultSectionSize(40);
-    trackTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-    trackTable->setSelectionMode(QAbstractItemView::SingleSelection);
-    trackTable->setContextMenuPolicy(Qt::CustomContextMenu);
-    trackTable->setAcceptDrops(true);
-
-    connect(trackTable, &FileDropTableWidget::customContextMenuRequested, this, &MainWindow::onCustomContextMenuRequested);
-    connect(trackTable, &FileDropTableWidget::fileDropped, this, &MainWindow::onFileDropped);
-    connect(trackTable, &QTableWidget::cellDoubleClicked, this, [this](int row, int) {
-        if (row >= 0 && row < (int)cachedTracks.size() && cachedTracks[row].has_track) {
-            onPlayClicked(row);
-        }
-    });
-    // Update Play/Pause button state when selection changes
-    connect(trackTable, &QTableWidget::itemSelectionChanged, this, [this]() {
-        int row = trackTable->currentRow();
-        bool hasTrack = (row >= 0 && row < (int)cachedTracks.size() && cachedTracks[row].has_track);
-        
-        // If playing, button is Stop (enabled). If not playing, button is Play (enabled only if track exists)
-        if (currentPlayingSlot != -1) {
-            playPauseBtn->setEnabled(true); 
-            // If the selected row is DIFFERENT from playing row, clicking Play will switch tracks.
-            // If it is the SAME row, it's effectively a Stop button.
-            // We'll handle this logic in the button click handler.
-        } else {
-             playPauseBtn->setEnabled(hasTrack);
-        }
+    connect(deviceCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, [this](int) {
+        updateConnectButton();
     });
 
-    mainLayout->addWidget(trackTable);
+    // One tab per connected pedal
+    deviceTabs = new QTabWidget();
+    deviceTabs->setDocumentMode(true);
+    connect(deviceTabs, &QTabWidget::currentChanged, this, &MainWindow::onCurrentTabChanged);
+    mainLayout->addWidget(deviceTabs);
 
     QHBoxLayout* progressLayout = new QHBoxLayout();
     
@@ -321,16 +301,22 @@ void MainWindow::setupUi() {
     stopBtn->setToolTip("Stop");
     stopBtn->setEnabled(false);
     connect(stopBtn, &QPushButton::clicked, this, [this]() {
-        stopExistingWorker();
-        setActionsEnabled(true);
+        PedalSession* session = currentSession();
+        if (!session) return;
+        double duration = session->currentPlayingDuration;
+        stopExistingWorker(session);
+        session->currentPlayingSlot = -1;
+        session->isPaused = false;
+        updateSessionUi();
         // Reset seek slider to 0
         if (seekSlider->isVisible()) seekSlider->setValue(0);
-        timeLabel->setText("00:00 / " + QString::asprintf("%02d:%02d", (int)currentPlayingDuration / 60, (int)currentPlayingDuration % 60));
+        timeLabel->setText("00:00 / " + QString::asprintf("%02d:%02d", (int)duration / 60, (int)duration % 60));
     });
     progressLayout->addWidget(stopBtn);
 
     progressBar = new QProgressBar();
     progressBar->setVisible(false);
+    progressBar->setRange(0, 1000);
     
     seekSlider = new QSlider(Qt::Horizontal);
     seekSlider->setVisible(false);
@@ -342,30 +328,17 @@ void MainWindow::setupUi() {
     });
     connect(seekSlider, &QSlider::sliderReleased, this, [this]() {
         isSeeking = false;
+        PedalSession* session = currentSession();
         // Calculate new position
-        if (currentPlayingDuration > 0 && currentPlayingSlot != -1) {
+        if (session && session->currentPlayingDuration > 0 && session->currentPlayingSlot != -1) {
              int val = seekSlider->value();
              double ratio = (double)val / seekSlider->maximum();
-             double startTime = ratio * currentPlayingDuration;
+             double startTime = ratio * session->currentPlayingDuration;
              
              // Restart playback at new position
-             int slot = currentPlayingSlot;
-             stopExistingWorker();
-             
-             // Manually restart play with offset
-             currentPlayingSlot = slot;
-             worker = new Worker(&device, Worker::Play, slot, "", currentPlayingDuration, &playbackVolume, startTime);
-             connect(worker, &Worker::progress, this, &MainWindow::onProgress);
-             connect(worker, &Worker::finished, this, &MainWindow::onWorkerFinished);
-             connect(worker, &Worker::error, this, &MainWindow::onWorkerError);
-             worker->start();
-             
-             seekSlider->setVisible(true); cancelBtn->setVisible(false);
-             timeLabel->setVisible(true);
-             setActionsEnabled(false);
-             
-             playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPause));
-             playPauseBtn->setEnabled(true);
+             int slot = session->currentPlayingSlot;
+             stopExistingWorker(session);
+             startPlayback(session, slot, startTime);
         }
     });
 
@@ -375,11 +348,22 @@ void MainWindow::setupUi() {
     cancelBtn = new QPushButton("Cancel");
     cancelBtn->setVisible(false);
     connect(cancelBtn, &QPushButton::clicked, this, [this]() {
-        stopExistingWorker();
-        currentPlayingSlot = -1; // Explicitly reset since we cancelled
-        setActionsEnabled(true);
+        PedalSession* session = currentSession();
+        if (isConnecting(session)) {
+            closeSession(session, "Not Connected");
+            return;
+        }
+        stopExistingWorker(session);
+        if (session) {
+            session->currentPlayingSlot = -1; // Explicitly reset since we cancelled
+            updateSessionUi();
+        }
     });
+    rateLabel = new QLabel();
+    rateLabel->setVisible(false);
+
     progressLayout->addWidget(progressBar, 1);
+    progressLayout->addWidget(rateLabel);
     progressLayout->addWidget(seekSlider, 1);
     progressLayout->addWidget(timeLabel);
     progressLayout->addWidget(cancelBtn);
@@ -416,7 +400,9 @@ void MainWindow::setupUi() {
 
     auto* shortcutDelete = new QShortcut(QKeySequence::Delete, this);
     connect(shortcutDelete, &QShortcut::activated, this, [this]() {
-        int row = trackTable->currentRow();
+        PedalSession* session = currentSession();
+        if (!session) return;
+        int row = session->trackTable->currentRow();
         if (row >= 0) onDeleteClicked(row);
     });
 
@@ -425,68 +411,255 @@ void MainWindow::setupUi() {
 
     auto* shortcutUp = new QShortcut(QKeySequence(Qt::Key_Up), this);
     connect(shortcutUp, &QShortcut::activated, this, [this]() {
-        int row = trackTable->currentRow();
-        if (row > 0) trackTable->setCurrentCell(row - 1, 0);
+        PedalSession* session = currentSession();
+        if (!session) return;
+        int row = session->trackTable->currentRow();
+        if (row > 0) session->trackTable->selectRow(row - 1);
     });
 
     auto* shortcutDown = new QShortcut(QKeySequence(Qt::Key_Down), this);
     connect(shortcutDown, &QShortcut::activated, this, [this]() {
-        int row = trackTable->currentRow();
-        if (row < trackTable->rowCount() - 1) trackTable->setCurrentCell(row + 1, 0);
+        PedalSession* session = currentSession();
+        if (!session) return;
+        int row = session->trackTable->currentRow();
+        if (row < session->trackTable->rowCount() - 1) session->trackTable->selectRow(row + 1);
+    });
+
+    auto* shortcutDiagnostics = new QShortcut(QKeySequence("Ctrl+Shift+D"), this);
+    connect(shortcutDiagnostics, &QShortcut::activated, this, &MainWindow::onDiagnosticsClicked);
+
+    // Tabs can be cycled with the usual shortcuts when several pedals are connected
+    auto* shortcutNextTab = new QShortcut(QKeySequence::NextChild, this);
+    connect(shortcutNextTab, &QShortcut::activated, this, [this]() {
+        if (deviceTabs->count() > 1) deviceTabs->setCurrentIndex((deviceTabs->currentIndex() + 1) % deviceTabs->count());
+    });
+}
+
+void MainWindow::onDiagnosticsClicked() {
+    if (!diagnosticsDialog) diagnosticsDialog = new DiagnosticsDialog(this);
+    diagnosticsDialog->show();
+    diagnosticsDialog->raise();
+    diagnosticsDialog->activateWindow();
+}
+
+void MainWindow::onAudioSettingsClicked() {
+    for (const auto& session : sessions) {
+        if (session->worker && session->worker->getOperation() == Worker::Play) {
+            QMessageBox::information(this, "Audio Output", "Stop playback to change the audio output.");
+            return;
+        }
+    }
+    // Lists the devices, so this is where PortAudio starts up if nothing has played yet
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    AudioSettingsDialog dialog(this);
+    QApplication::restoreOverrideCursor();
+    dialog.exec();
+}
+
+FileDropTableView* MainWindow::createTrackTable(PedalSession* session) {
+    FileDropTableView* trackTable = new FileDropTableView();
+    session->trackModel = new TrackTableModel(trackTable);
+    trackTable->setModel(session->trackModel);
+
+    QVector<QIcon> icons(TrackTableModel::ActionCount);
+    icons[TrackTableModel::DownloadAction] = styledIcon(QStyle::SP_ArrowDown);
+    icons[TrackTableModel::UploadAction] = styledIcon(QStyle::SP_ArrowUp);
+    icons[TrackTableModel::DeleteAction] = styledIcon(QStyle::SP_DialogCloseButton);
+    auto* actions = new TrackActionDelegate(icons, trackTable);
+    trackTable->setItemDelegateForColumn(TrackTableModel::ActionsColumn, actions);
+    // Queued so dialogs opened by an action don't run inside the view's mouse handler
+    connect(actions, &TrackActionDelegate::actionTriggered, this, [this](int row, int action) {
+        if (action == TrackTableModel::DownloadAction) onDownloadClicked(row);
+        else if (action == TrackTableModel::UploadAction) onUploadClicked(row);
+        else if (action == TrackTableModel::DeleteAction) onDeleteClicked(row);
+    }, Qt::QueuedConnection);
+
+    trackTable->horizontalHeader()->setSectionResizeMode(TrackTableModel::DurationColumn, QHeaderView::ResizeToContents);
+    trackTable->horizontalHeader()->setSectionResizeMode(TrackTableModel::SizeColumn, QHeaderView::ResizeToContents);
+    trackTable->horizontalHeader()->setSectionResizeMode(TrackTableModel::ActionsColumn, QHeaderView::Stretch);
+
+    trackTable->verticalHeader()->setVisible(true);
+    trackTable->verticalHeader()->setDefaultSectionSize(40);
+    trackTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    trackTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    trackTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    trackTable->setContextMenuPolicy(Qt::CustomContextMenu);
+    trackTable->setAcceptDrops(true);
+
+    // Only the visible tab can raise these, so they always act on currentSession()
+    connect(trackTable, &FileDropTableView::customContextMenuRequested, this, &MainWindow::onCustomContextMenuRequested);
+    connect(trackTable, &FileDropTableView::fileDropped, this, &MainWindow::onFileDropped);
+    connect(trackTable, &QTableView::doubleClicked, this, [this](const QModelIndex& index) {
+        PedalSession* session = currentSession();
+        // Double clicks on the action buttons are button clicks
+        if (index.column() == TrackTableModel::ActionsColumn) return;
+        if (session && session->trackModel->hasTrack(index.row())) {
+            onPlayClicked(index.row());
+        }
     });
+    // Update Play/Pause button state when selection changes
+    connect(trackTable->selectionModel(), &QItemSelectionModel::selectionChanged, this, [this]() {
+        PedalSession* session = currentSession();
+        if (!session) return;
+        int row = session->trackTable->currentRow();
+        bool hasTrack = session->trackModel->hasTrack(row);
+        
+        // If playing, button is Stop (enabled). If not playing, button is Play (enabled only if track exists)
+        if (session->currentPlayingSlot != -1) {
+            playPauseBtn->setEnabled(true); 
+            // If the selected row is DIFFERENT from playing row, clicking Play will switch tracks.
+            // If it is the SAME row, it's effectively a Stop button.
+            // We'll handle this logic in the button click handler.
+        } else {
+             playPauseBtn->setEnabled(hasTrack && !session->worker);
+        }
+    });
+
+    return trackTable;
+}
+
+void MainWindow::onCurrentTabChanged(int index) {
+    Q_UNUSED(index);
+    PedalSession* session = currentSession();
+    if (session) {
+        // Keep the device selector in step with the visible pedal
+        for (int i = 0; i < (int)deviceList.size(); i++) {
+            if (deviceList[i].bus == session->info.bus && deviceList[i].address == session->info.address) {
+                deviceCombo->setCurrentIndex(i);
+                break;
+            }
+        }
+    }
+    updateSessionUi();
+}
+
+void MainWindow::setSessionStatus(PedalSession* session, const QString& text) {
+    session->status = text;
+    if (session == currentSession()) {
+        statusLabel->setText(text);
+        statusLabel->setStyleSheet("color: green; font-weight: bold;");
+    }
+}
+
+void MainWindow::updateTabTitle(PedalSession* session) {
+    int index = deviceTabs->indexOf(session->trackTable);
+    if (index < 0) return;
+
+    QString title = QString::fromStdString(session->info.name);
+    if (!session->info.serial.empty()) {
+        title += QString(" [%1]").arg(QString::fromStdString(session->info.serial));
+    }
+    // Background pedals show their progress in the tab
+    if (isCloneTarget(session)) {
+        title += " (receiving)";
+    } else if (session->worker && session->worker->getOperation() != Worker::Play && session->progressTotal > 0) {
+        title += QString(" (%1%)").arg((int)(100.0 * session->progressCurrent / session->progressTotal));
+    } else if (session->worker && session->worker->getOperation() == Worker::Play) {
+        title += QString::fromUtf8(" ▶");
+    }
+    deviceTabs->setTabText(index, title);
+}
+
+// Syncs the shared status/transport widgets with the visible pedal
+void MainWindow::updateSessionUi() {
+    PedalSession* session = currentSession();
+    if (!session) {
+        refreshBtn->setEnabled(false);
+        benchmarkBtn->setEnabled(false);
+        progressBar->setVisible(false); rateLabel->setVisible(false); seekSlider->setVisible(false); cancelBtn->setVisible(false); timeLabel->setVisible(false);
+        playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPlay));
+        playPauseBtn->setToolTip("Play Selected Track");
+        playPauseBtn->setEnabled(false);
+        stopBtn->setEnabled(false);
+        transportTimer->stop();
+        updateConnectButton();
+        return;
+    }
+
+    statusLabel->setText(session->status);
+    statusLabel->setStyleSheet("color: green; font-weight: bold;");
+
+    Worker* w = session->worker;
+    bool isPlaying = (w && w->getOperation() == Worker::Play);
+    bool isWorking = (w && !isPlaying);
+    bool inTransport = isPlaying || session->isPaused;
+
+    progressBar->setVisible(isWorking);
+    cancelBtn->setVisible(isWorking);
+    if (isWorking) {
+        // Unknown totals (listing, delete) show a busy indicator; known ones are scaled
+        // to permille so 64-bit byte counts fit the bar
+        progressBar->setRange(0, session->progressTotal > 0 ? 1000 : 0);
+        if (session->progressTotal > 0) {
+            progressBar->setValue(static_cast<int>(1000 * std::min(session->progressCurrent, session->progressTotal) / session->progressTotal));
+        }
+    }
+    updateRateLabel(session);
+
+    if (isPlaying) transportTimer->start();
+    else transportTimer->stop();
+    seekSlider->setVisible(inTransport);
+    timeLabel->setVisible(inTransport);
+    if (inTransport) {
+        double duration = session->currentPlayingDuration;
+        double elapsed = session->currentProgressTime;
+        if (!isSeeking && duration > 0) {
+            seekSlider->setValue(static_cast<int>((elapsed / duration) * seekSlider->maximum()));
+        }
+        timeLabel->setText(QString::asprintf("%02d:%02d / %02d:%02d",
+            (int)elapsed / 60, (int)elapsed % 60, (int)duration / 60, (int)duration % 60));
+    }
+
+    if (isPlaying) {
+        playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPause));
+        playPauseBtn->setToolTip("Pause");
+    } else if (session->isPaused) {
+        playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPlay));
+        playPauseBtn->setToolTip("Resume");
+    } else {
+        playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPlay));
+        playPauseBtn->setToolTip("Play Selected Track");
+    }
+
+    setActionsEnabled(session, !w && !isCloneTarget(session));
+    if (session->isPaused) stopBtn->setEnabled(true);
+    updateConnectButton();
 }
 
 void MainWindow::onPlayPauseAction() {
-    int row = trackTable->currentRow();
-    if (row < 0 || row >= (int)cachedTracks.size() || !cachedTracks[row].has_track) {
+    PedalSession* session = currentSession();
+    if (!session || isLocked(session)) return;
+
+    int row = session->trackTable->currentRow();
+    if (!session->trackModel->hasTrack(row)) {
         // If no valid track selected, but playing/paused, maybe Stop? 
         // For now, just return to keep it simple, or stop if user expects it.
-        if (currentPlayingSlot != -1 || isPaused) stopExistingWorker();
+        if (session->currentPlayingSlot != -1 || session->isPaused) stopExistingWorker(session);
         return;
     }
 
     // If we selected a DIFFERENT track than the one currently active (playing or paused)
-    if (row != currentPlayingSlot) {
+    if (row != session->currentPlayingSlot) {
         onPlayClicked(row);
         return;
     }
 
-    if (isPaused) {
+    if (session->isPaused) {
         // Resume
-        int slot = currentPlayingSlot;
-        if (worker) {
-             disconnect(worker, nullptr, nullptr, nullptr);
-             worker->stop();
-             worker->wait();
-             delete worker;
-             worker = nullptr;
-        }
-        isPaused = false;
-        
-        worker = new Worker(&device, Worker::Play, slot, "", currentPlayingDuration, &playbackVolume, currentProgressTime);
-        connect(worker, &Worker::progress, this, &MainWindow::onProgress);
-        connect(worker, &Worker::finished, this, &MainWindow::onWorkerFinished);
-        connect(worker, &Worker::error, this, &MainWindow::onWorkerError);
-        worker->start();
-        
-        playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPause));
-        playPauseBtn->setToolTip("Pause");
-        stopBtn->setEnabled(true);
-        
-    } else if (currentPlayingSlot != -1) {
+        startPlayback(session, session->currentPlayingSlot, session->currentProgressTime);
+    } else if (session->currentPlayingSlot != -1) {
         // Pause
-        isPaused = true;
-        if (worker) {
-             disconnect(worker, nullptr, nullptr, nullptr);
-             worker->stop();
-             worker->wait();
-             delete worker;
-             worker = nullptr;
+        updatePlaybackPosition(session);
+        session->isPaused = true;
+        if (session->worker) {
+             disconnect(session->worker, nullptr, nullptr, nullptr);
+             session->worker->stop();
+             session->worker->wait();
+             delete session->worker;
+             session->worker = nullptr;
         }
-        // UI Update
-        playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPlay));
-        playPauseBtn->setToolTip("Resume");
-        stopBtn->setEnabled(true);
+        updateTabTitle(session);
+        updateSessionUi();
     } else {
         // Play from start (row == currentPlayingSlot, which is -1)
         onPlayClicked(row);
@@ -495,13 +668,16 @@ void MainWindow::onPlayPauseAction() {
 
 
 void MainWindow::onCustomContextMenuRequested(const QPoint& pos) {
-    int row = trackTable->rowAt(pos.y());
+    PedalSession* session = currentSession();
+    if (!session) return;
+
+    int row = session->trackTable->rowAt(pos.y());
     if (row < 0) return;
 
-    bool hasTrack = (row >= 0 && row < (int)cachedTracks.size() && cachedTracks[row].has_track);
+    bool hasTrack = session->trackModel->hasTrack(row);
 
     QMenu menu(this);
-    QAction* actPlay = menu.addAction(currentPlayingSlot == row ? "Stop" : "Play");
+    QAction* actPlay = menu.addAction(session->currentPlayingSlot == row ? "Stop" : "Play");
     actPlay->setEnabled(hasTrack);
 
     menu.addSeparator();
@@ -513,13 +689,38 @@ void MainWindow::onCustomContextMenuRequested(const QPoint& pos) {
     QAction* actDelete = menu.addAction("Delete");
     actDelete->setEnabled(hasTrack);
 
-    QAction* selectedAction = menu.exec(trackTable->viewport()->mapToGlobal(pos));
+    menu.addSeparator();
+    QAction* actMove = menu.addAction("Move to...");
+    actMove->setEnabled(hasTrack);
+    QAction* actSwap = menu.addAction("Swap with...");
+    actSwap->setEnabled(hasTrack);
+    QAction* actInsertGap = menu.addAction("Insert Empty Slot Here");
+    actInsertGap->setEnabled(hasTrack);
+
+    // Copy straight to another connected pedal
+    QMap<QAction*, PedalSession*> cloneActions;
+    if (sessions.size() > 1) {
+        QMenu* cloneMenu = menu.addMenu("Clone to");
+        cloneMenu->setEnabled(hasTrack);
+        for (const auto& other : sessions) {
+            if (other.get() == session) continue;
+            QAction* act = cloneMenu->addAction(deviceTabs->tabText(deviceTabs->indexOf(other->trackTable)));
+            act->setEnabled(!other->worker && !isCloneTarget(other.get()));
+            cloneActions.insert(act, other.get());
+        }
+    }
+
+    QAction* selectedAction = menu.exec(session->trackTable->viewport()->mapToGlobal(pos));
     if (!selectedAction) return;
 
     if (selectedAction == actPlay) onPlayClicked(row);
     else if (selectedAction == actUpload) onUploadClicked(row);
     else if (selectedAction == actDownload) onDownloadClicked(row);
     else if (selectedAction == actDelete) onDeleteClicked(row);
+    else if (selectedAction == actMove) onMoveClicked(row, false);
+    else if (selectedAction == actSwap) onMoveClicked(row, true);
+    else if (selectedAction == actInsertGap) onInsertGapClicked(row);
+    else if (cloneActions.contains(selectedAction)) startClone(session, row, cloneActions.value(selectedAction));
 }
 
 void MainWindow::onFileDropped(int row, QString filePath) {
@@ -527,15 +728,22 @@ void MainWindow::onFileDropped(int row, QString filePath) {
 }
 
 void MainWindow::refreshDeviceList() {
+    // Keep the current selection across rebuilds
+    int previous = deviceCombo->currentIndex();
+    uint8_t selectedBus = 0, selectedAddress = 0;
+    if (previous >= 0 && previous < (int)deviceList.size()) {
+        selectedBus = deviceList[previous].bus;
+        selectedAddress = deviceList[previous].address;
+    }
+
+    deviceCombo->blockSignals(true);
     deviceCombo->clear();
-    deviceList = USBDevice::enumerateDevices();
 
     if (deviceList.empty()) {
-        deviceCombo->addItem("No devices found");
-        connectBtn->setEnabled(false);
+        deviceCombo->addItem(devicesListed ? "No devices found" : "Looking for devices...");
     } else {
-        connectBtn->setEnabled(true);
-        for (const auto& dev : deviceList) {
+        for (int i = 0; i < (int)deviceList.size(); i++) {
+            const DeviceInfo& dev = deviceList[i];
             QString displayName = QString::fromStdString(dev.name);
             if (!dev.serial.empty()) {
                 displayName += QString(" [%1]").arg(QString::fromStdString(dev.serial));
@@ -546,197 +754,337 @@ void MainWindow::refreshDeviceList() {
                 displayName += " - No permission";
             }
             deviceCombo->addItem(displayName);
+            if (dev.bus == selectedBus && dev.address == selectedAddress) {
+                deviceCombo->setCurrentIndex(i);
+            }
         }
     }
+    deviceCombo->blockSignals(false);
+    updateConnectButton();
 }
 
-void MainWindow::onRefreshDevicesClicked() {
-    if (device.isConnected()) {
-        QMessageBox::warning(this, "Warning", "Disconnect before refreshing device list");
+// Connect adds the selected pedal as a new tab; Disconnect closes the selected pedal's tab
+void MainWindow::updateConnectButton() {
+    int idx = deviceCombo->currentIndex();
+    if (idx < 0 || idx >= (int)deviceList.size()) {
+        connectBtn->setText("Connect");
+        connectBtn->setEnabled(false);
         return;
     }
-    refreshDeviceList();
+
+    PedalSession* session = sessionForDevice(deviceList[idx]);
+    bool connecting = isConnecting(session);
+    connectBtn->setText(connecting ? "Cancel" : session ? "Disconnect" : "Connect");
+    connectBtn->setEnabled(!session || connecting || (!session->worker && !isCloneTarget(session)));
 }
 
-void MainWindow::onConnectClicked() {
-    if (device.isConnected()) {
-        device.disconnect();
-        connectBtn->setText("Connect");
-        statusLabel->setText("Not Connected");
-        statusLabel->setStyleSheet("color: red; font-weight: bold;");
-        refreshBtn->setEnabled(false);
-        deviceCombo->setEnabled(true);
-        trackTable->setRowCount(0);
-        currentPlayingSlot = -1;
-    } else {
-        int idx = deviceCombo->currentIndex();
-        if (idx < 0 || idx >= (int)deviceList.size()) {
-            QMessageBox::critical(this, "Error", "No device selected");
-            return;
-        }
+void MainWindow::onDevicesChanged(std::vector<DeviceInfo> devices, std::vector<DeviceInfo> added,
+                                  std::vector<DeviceInfo> removed) {
+    Q_UNUSED(added);
+    bool firstList = !devicesListed;
+    devicesListed = true;
+    deviceList = devices;
+    refreshDeviceList();
 
-        const DeviceInfo& selectedDevice = deviceList[idx];
+    // Drop sessions whose pedal has been unplugged
+    std::vector<PedalSession*> closing;
+    for (const auto& session : sessions) {
+        for (const DeviceInfo& d : removed) {
+            if (d.bus == session->info.bus && d.address == session->info.address) {
+                closing.push_back(session.get());
+                break;
+            }
+        }
+    }
+    for (PedalSession* session : closing) {
+        closeSession(session, "Device disconnected");
+    }
 
-        if (!selectedDevice.hasPermission) {
-#ifdef __linux__
-            int ret = QMessageBox::question(this, "Permission Required",
-                "Cannot access this USB device due to insufficient permissions.\n\n"
-                "Would you like to install the udev rule to fix this?\n"
-                "(This will require administrator privileges)",
-                QMessageBox::Yes | QMessageBox::No);
-
-            if (ret == QMessageBox::Yes) {
-                statusLabel->setText("Installing udev rule...");
-                if (USBDevice::installUdevRule()) {
-                    // Wait for udev to apply the new rules
-                    statusLabel->setText("Waiting for udev...");
-                    QApplication::processEvents();
-                    QThread::sleep(1);
-
-                    refreshDeviceList();
-                    // Retry connection with updated device list
-                    if (idx < (int)deviceList.size() && deviceList[idx].hasPermission) {
-                        statusLabel->setText("Connecting...");
-                        onConnectClicked();
-                        return;
-                    }
-                } else {
-                    QMessageBox::critical(this, "Error", "Failed to install udev rule");
-                }
-                statusLabel->setText("Not Connected");
+    if (connectAfterRescan) {
+        connectAfterRescan = false;
+        for (int i = 0; i < (int)deviceList.size(); i++) {
+            if (deviceList[i].bus == rescanBus && deviceList[i].address == rescanAddress && deviceList[i].hasPermission) {
+                deviceCombo->setCurrentIndex(i);
+                statusLabel->setText("Connecting...");
+                onConnectClicked();
+                return;
             }
-            return;
-#else
-            QMessageBox::critical(this, "Error", "Cannot access device - permission denied");
-            return;
-#endif
         }
+        if (sessions.empty()) statusLabel->setText("Not Connected");
+    }
 
-        connectBtn->setEnabled(false);
-        deviceCombo->setEnabled(false);
-        statusLabel->setText("Connecting...");
-        QApplication::setOverrideCursor(Qt::WaitCursor);
-        QApplication::processEvents();
+    if (firstList) {
+        StartupProfile::mark("devices listed");
+        StartupProfile::report();
+        // Auto-connect if exactly one device with permissions is available
+        if (deviceList.size() == 1 && deviceList[0].hasPermission) {
+            deviceCombo->setCurrentIndex(0);
+            onConnectClicked();
+        }
+    }
+}
 
-        bool ok = device.connect(selectedDevice.bus, selectedDevice.address);
+void MainWindow::onRefreshDevicesClicked() {
+    deviceRegistry->rescan();
+}
 
-        while (QApplication::overrideCursor()) {
-            QApplication::restoreOverrideCursor();
-        }
+void MainWindow::openSession(const DeviceInfo& info) {
+    auto session = std::make_unique<PedalSession>();
+    session->info = info;
+    session->trackTable = createTrackTable(session.get());
+    PedalSession* added = session.get();
+    sessions.push_back(std::move(session));
+
+    deviceTabs->addTab(added->trackTable, QString());
+    updateTabTitle(added);
+    deviceTabs->setCurrentWidget(added->trackTable);
+
+    // Open, claim, the optional link probe and the first listing all run on the worker;
+    // the tab fills in slot by slot and Cancel/Disconnect abandon it at any point
+    added->trackModel->beginListing(Protocol::MAX_TRACKS);
+    Worker* w = new Worker(&added->device, Worker::Connect);
+    w->setConnectTarget(info.bus, info.address);
+    w->setQuick(QSettings().value("probeLinkOnConnect", false).toBool());
+    startWorker(added, w);
+    setSessionStatus(added, "Connecting...");
+    updateSessionUi();
+}
 
-        if (ok) {
-            connectBtn->setEnabled(true);
-            connectBtn->setText("Disconnect");
-            statusLabel->setText("Connected");
-            statusLabel->setStyleSheet("color: green; font-weight: bold;");
-            refreshBtn->setEnabled(true);
-            onRefreshClicked();
-        } else {
-            connectBtn->setEnabled(true);
-            deviceCombo->setEnabled(true);
-            statusLabel->setText("Not Connected");
-            QMessageBox::critical(this, "Error", "Failed to connect");
+void MainWindow::closeSession(PedalSession* session, const QString& reason) {
+    for (const auto& s : sessions) {
+        if (s->cloneTarget == session) stopExistingWorker(s.get());
+    }
+    Worker* connecting = isConnecting(session) ? session->worker : nullptr;
+    if (connecting) {
+        // Not waited for: an open or probe round trip can block for seconds. The worker stops
+        // at its next checkpoint, releases the pedal itself and takes the session with it.
+        disconnect(connecting, nullptr, nullptr, nullptr);
+        connecting->stop();
+        session->worker = nullptr;
+    } else {
+        stopExistingWorker(session);
+        session->device.disconnect();
+    }
+
+    FileDropTableView* table = session->trackTable;
+    auto it = std::find_if(sessions.begin(), sessions.end(),
+                           [session](const std::unique_ptr<PedalSession>& s) { return s.get() == session; });
+    // Remove from the list before the tab so currentChanged never sees the closing session
+    std::unique_ptr<PedalSession> closing;
+    if (it != sessions.end()) {
+        closing = std::move(*it);
+        sessions.erase(it);
+    }
+    int index = deviceTabs->indexOf(table);
+    if (index >= 0) deviceTabs->removeTab(index);
+    table->deleteLater();
+
+    if (connecting) {
+        // The worker still uses closing->device until its thread ends
+        std::shared_ptr<PedalSession> keep(std::move(closing));
+        QPointer<Worker> worker(connecting);
+        auto retire = [worker, keep]() {
+            if (worker) worker->deleteLater();
+        };
+        connect(connecting, &QThread::finished, this, retire);
+        if (connecting->isFinished()) retire();
+        abandonedConnects.erase(std::remove(abandonedConnects.begin(), abandonedConnects.end(), QPointer<Worker>()),
+                                abandonedConnects.end());
+        abandonedConnects.push_back(worker);
+    }
+
+    if (sessions.empty()) {
+        statusLabel->setText(reason);
+        statusLabel->setStyleSheet("color: red; font-weight: bold;");
+    }
+    updateSessionUi();
+}
+
+void MainWindow::onConnectClicked() {
+    int idx = deviceCombo->currentIndex();
+    if (idx < 0 || idx >= (int)deviceList.size()) {
+        QMessageBox::critical(this, "Error", "No device selected");
+        return;
+    }
+
+    if (PedalSession* existing = sessionForDevice(deviceList[idx])) {
+        closeSession(existing, "Not Connected");
+        return;
+    }
+
+    const DeviceInfo selectedDevice = deviceList[idx];
+
+    if (!selectedDevice.hasPermission) {
+#ifdef __linux__
+        int ret = QMessageBox::question(this, "Permission Required",
+            "Cannot access this USB device due to insufficient permissions.\n\n"
+            "Would you like to install the udev rule to fix this?\n"
+            "(This will require administrator privileges)",
+            QMessageBox::Yes | QMessageBox::No);
+
+        if (ret == QMessageBox::Yes) {
+            statusLabel->setText("Installing udev rule...");
+            if (USBDevice::installUdevRule()) {
+                // Give udev a moment to apply the new rules, then re-read the permissions;
+                // onDevicesChanged connects if the pedal is now accessible
+                statusLabel->setText("Waiting for udev...");
+                connectAfterRescan = true;
+                rescanBus = selectedDevice.bus;
+                rescanAddress = selectedDevice.address;
+                QTimer::singleShot(UDEV_SETTLE_MS, this, [this]() { deviceRegistry->rescan(); });
+                return;
+            } else {
+                QMessageBox::critical(this, "Error", "Failed to install udev rule");
+            }
+            updateSessionUi();
+            if (sessions.empty()) statusLabel->setText("Not Connected");
         }
+        return;
+#else
+        QMessageBox::critical(this, "Error", "Cannot access device - permission denied");
+        return;
+#endif
     }
+
+    openSession(selectedDevice);
 }
 
 void MainWindow::onRefreshClicked() {
-    stopExistingWorker();
-    worker = new Worker(&device, Worker::List);
-    connect(worker, &Worker::tracksLoaded, this, &MainWindow::onTracksLoaded);
-    connect(worker, &Worker::finished, this, &MainWindow::onWorkerFinished);
-    connect(worker, &Worker::error, this, &MainWindow::onWorkerError);
-    worker->start();
+    PedalSession* session = currentSession();
+    if (!session || isLocked(session)) return;
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    progressBar->setVisible(true); cancelBtn->setVisible(true);
-    progressBar->setRange(0, 0);
-    statusLabel->setText("Refreshing...");
-    setActionsEnabled(false);
+    stopExistingWorker(session);
+    startListing(session);
 }
 
-void MainWindow::onTracksLoaded(std::vector<TrackInfo> tracks) {
-    cachedTracks = tracks;
-    statusLabel->setText("Connected");
-    trackTable->setRowCount(tracks.size());
-    currentPlayingSlot = -1;
-
-    for (const auto& t : tracks) {
-        int r = t.slot;
-        trackTable->setVerticalHeaderItem(r, new QTableWidgetItem(QString::number(r)));
-
-        QTableWidgetItem* itemDuration = new QTableWidgetItem(
-            t.has_track ? QString::asprintf("%02d:%02d", (int)t.duration/60, (int)t.duration%60)
-                        : QString::fromUtf8("\u2014"));
-        QTableWidgetItem* itemSize = new QTableWidgetItem(
-            t.has_track ? QString::asprintf("%.2f MB", t.size / (1024.0*1024.0))
-                        : QString::fromUtf8("\u2014"));
-
-        if (t.has_track) {
-            QColor green(0xcc, 0xff, 0xcc);
-            itemDuration->setBackground(green);
-            itemSize->setBackground(green);
-        }
+void MainWindow::startListing(PedalSession* session) {
+    session->trackModel->beginListing(Protocol::MAX_TRACKS);
+
+    // Rows on screen are read first so the table is usable after a few round trips
+    FileDropTableView* table = session->trackTable;
+    std::vector<int> order;
+    int first = table->rowAt(0);
+    int last = table->rowAt(table->viewport()->height() - 1);
+    if (first >= 0) {
+        if (last < 0) last = table->rowCount() - 1;
+        for (int row = first; row <= last; row++) order.push_back(row);
+    }
 
-        trackTable->setItem(r, 0, itemDuration);
-        trackTable->setItem(r, 1, itemSize);
+    Worker* w = new Worker(&session->device, Worker::List);
+    w->setQuerySlots(order);
+    startWorker(session, w);
+    setSessionStatus(session, "Refreshing...");
+    updateTabTitle(session);
+    if (session == currentSession()) updateSessionUi();
+}
 
-        QWidget* pWidget = new QWidget();
-        QHBoxLayout* pLayout = new QHBoxLayout(pWidget);
-        pLayout->setContentsMargins(2, 2, 2, 2);
-        pLayout->setSpacing(4);
+void MainWindow::onBenchmarkClicked() {
+    PedalSession* session = currentSession();
+    if (!session || session->worker || isCloneTarget(session)) return;
 
-        QPushButton* btnDown = new QPushButton(styledIcon(QStyle::SP_ArrowDown), "");
-        btnDown->setToolTip("Download");
-        connect(btnDown, &QPushButton::clicked, [this, r](){ onDownloadClicked(r); });
-        pLayout->addWidget(btnDown);
+    auto answer = QMessageBox::question(this, "Benchmark Link",
+        "Measure round-trip latency, then download and upload rates?\n\n"
+        "The upload test writes a short silent track to the last empty slot and deletes it again.");
+    if (answer != QMessageBox::Yes) return;
 
-        QPushButton* btnUp = new QPushButton(styledIcon(QStyle::SP_ArrowUp), "");
-        btnUp->setToolTip("Upload");
-        connect(btnUp, &QPushButton::clicked, [this, r](){ onUploadClicked(r); });
-        pLayout->addWidget(btnUp);
+    startWorker(session, new Worker(&session->device, Worker::Benchmark));
+    setSessionStatus(session, "Benchmarking link...");
+    updateTabTitle(session);
+    updateSessionUi();
+}
 
-        QPushButton* btnDel = new QPushButton(styledIcon(QStyle::SP_DialogCloseButton), "");
-        btnDel->setToolTip("Delete");
-        connect(btnDel, &QPushButton::clicked, [this, r](){ onDeleteClicked(r); });
-        pLayout->addWidget(btnDel);
+void MainWindow::onLinkMeasured(LinkProfile profile) {
+    Worker* w = qobject_cast<Worker*>(sender());
+    PedalSession* session = sessionForWorker(w);
+    if (!session || !w || w->isQuick()) return;
+
+    QMessageBox box(QMessageBox::Information, "Link Benchmark",
+                    QString::fromStdString(profile.describe()).replace(", ", "\n"), QMessageBox::Ok, this);
+    QString note = "Clone pipeline depth: " + QString::number(profile.pipelineDepth()) + " chunks";
+    if (session->device.getSerial().empty()) note += "\nThis pedal reports no serial number, so the profile is not saved.";
+    box.setInformativeText(note);
+    auto* probe = new QCheckBox("Re-measure latency whenever a pedal connects");
+    probe->setChecked(QSettings().value("probeLinkOnConnect", false).toBool());
+    box.setCheckBox(probe);
+    box.exec();
+    QSettings().setValue("probeLinkOnConnect", probe->isChecked());
+}
 
-        if (!t.has_track) {
-             btnDown->setEnabled(false);
-             btnDel->setEnabled(false);
-        }
+void MainWindow::onWorkerPhase(QString text) {
+    PedalSession* session = sessionForWorker(sender());
+    if (session) setSessionStatus(session, text);
+}
 
-        trackTable->setCellWidget(r, 2, pWidget);
-    }
+void MainWindow::onTracksLoaded(std::vector<TrackInfo> tracks) {
+    PedalSession* session = sessionForWorker(sender());
+    if (!session) return;
+
+    session->trackModel->setTracks(tracks);
+    session->currentPlayingSlot = -1;
+}
+
+void MainWindow::onTracksUpdated(std::vector<TrackInfo> tracks) {
+    PedalSession* session = sessionForWorker(sender());
+    if (!session) return;
+    for (const TrackInfo& t : tracks) session->trackModel->setTrack(t);
+}
+
+void MainWindow::startQuery(PedalSession* session, const std::vector<int>& slots) {
+    if (slots.empty()) return;
+    Worker* w = new Worker(&session->device, Worker::Query);
+    w->setQuerySlots(slots);
+    startWorker(session, w);
+    setSessionStatus(session, "Refreshing...");
+    updateTabTitle(session);
+    if (session == currentSession()) updateSessionUi();
 }
 
 void MainWindow::onDownloadClicked(int slot) {
-    stopExistingWorker();
-    QString filename = QFileDialog::getSaveFileName(this, "Save Wav",
-        lastFileDialogDir.isEmpty() ? QString("track_%1.wav").arg(slot)
-                                    : lastFileDialogDir + QString("/track_%1.wav").arg(slot),
-        "WAV Files (*.wav);;All Files (*)");
+    PedalSession* session = currentSession();
+    if (!session || isLocked(session)) return;
+    stopExistingWorker(session);
+
+    static const QString wav24Filter = "WAV 24-bit (*.wav)";
+    static const QString wav32Filter = "WAV 32-bit (*.wav)";
+    static const QString flacFilter = "FLAC (*.flac)";
+
+    QString selectedFilter = QSettings().value("downloadFormat", wav24Filter).toString();
+    QString ext = (selectedFilter == flacFilter) ? "flac" : "wav";
+    QString defaultName = QString("track_%1.%2").arg(slot).arg(ext);
+
+    QString filename = QFileDialog::getSaveFileName(this, "Save Track",
+        lastFileDialogDir.isEmpty() ? defaultName : lastFileDialogDir + "/" + defaultName,
+        QStringList({wav24Filter, wav32Filter, flacFilter, "All Files (*)"}).join(";;"), &selectedFilter);
     if (filename.isEmpty()) return;
     lastFileDialogDir = QFileInfo(filename).absolutePath();
     QSettings().setValue("lastFileDialogDir", lastFileDialogDir);
 
-    worker = new Worker(&device, Worker::Download, slot, filename.toStdString());
-    connect(worker, &Worker::progress, this, &MainWindow::onProgress);
-    connect(worker, &Worker::finished, this, &MainWindow::onWorkerFinished);
-    connect(worker, &Worker::error, this, &MainWindow::onWorkerError);
-    worker->start();
+    AudioUtils::OutputFormat format = AudioUtils::Wav24;
+    if (selectedFilter == flacFilter || QFileInfo(filename).suffix().toLower() == "flac") {
+        format = AudioUtils::Flac;
+    } else if (selectedFilter == wav32Filter) {
+        format = AudioUtils::Wav32;
+    }
+    if (selectedFilter == wav24Filter || selectedFilter == wav32Filter || selectedFilter == flacFilter) {
+        QSettings().setValue("downloadFormat", selectedFilter);
+    }
+
+    Worker* w = new Worker(&session->device, Worker::Download, slot, filename.toStdString());
+    w->setOutputFormat(format);
+    startWorker(session, w);
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    progressBar->setVisible(true); cancelBtn->setVisible(true);
-    setActionsEnabled(false);
-    statusLabel->setText(QString("Downloading Slot %1...").arg(slot));
+    setSessionStatus(session, QString("Downloading Slot %1...").arg(slot));
+    updateTabTitle(session);
+    updateSessionUi();
 }
 
 void MainWindow::onUploadClicked(int slot, QString manualPath) {
-    stopExistingWorker();
+    PedalSession* session = currentSession();
+    if (!session || isLocked(session)) return;
+    stopExistingWorker(session);
 
     // Check if slot already has a track and confirm overwrite
-    if (slot >= 0 && slot < (int)cachedTracks.size() && cachedTracks[slot].has_track) {
+    if (session->trackModel->hasTrack(slot)) {
         int ret = QMessageBox::question(this, "Confirm Overwrite",
             QString("Slot %1 already has a track. Overwrite it?").arg(slot));
         if (ret != QMessageBox::Yes) return;
@@ -752,210 +1100,382 @@ void MainWindow::onUploadClicked(int slot, QString manualPath) {
     lastFileDialogDir = QFileInfo(filename).absolutePath();
     QSettings().setValue("lastFileDialogDir", lastFileDialogDir);
 
-    worker = new Worker(&device, Worker::Upload, slot, filename.toStdString());
-    connect(worker, &Worker::progress, this, &MainWindow::onProgress);
-    connect(worker, &Worker::finished, this, &MainWindow::onWorkerFinished);
-    connect(worker, &Worker::error, this, &MainWindow::onWorkerError);
-    worker->start();
+    startWorker(session, new Worker(&session->device, Worker::Upload, slot, filename.toStdString()));
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    progressBar->setVisible(true); cancelBtn->setVisible(true);
-    setActionsEnabled(false);
-    statusLabel->setText(QString("Uploading to Slot %1...").arg(slot));
+    setSessionStatus(session, QString("Uploading to Slot %1...").arg(slot));
+    updateTabTitle(session);
+    updateSessionUi();
 }
 
 void MainWindow::onDeleteClicked(int slot) {
-    stopExistingWorker();
+    PedalSession* session = currentSession();
+    if (!session || isLocked(session)) return;
+    stopExistingWorker(session);
     int ret = QMessageBox::question(this, "Confirm Delete", QString("Are you sure you want to delete track %1?").arg(slot));
     if (ret != QMessageBox::Yes) return;
 
-    worker = new Worker(&device, Worker::Delete, slot);
-    connect(worker, &Worker::finished, this, &MainWindow::onWorkerFinished);
-    connect(worker, &Worker::error, this, &MainWindow::onWorkerError);
-    worker->start();
+    startWorker(session, new Worker(&session->device, Worker::Delete, slot));
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    progressBar->setVisible(true); cancelBtn->setVisible(true);
-    progressBar->setRange(0, 0);
-    setActionsEnabled(false);
-    statusLabel->setText(QString("Deleting Slot %1...").arg(slot));
+    setSessionStatus(session, QString("Deleting Slot %1...").arg(slot));
+    updateTabTitle(session);
+    updateSessionUi();
 }
 
 void MainWindow::onPlayClicked(int slot) {
-    if (currentPlayingSlot == slot) {
-        stopExistingWorker();
-        setActionsEnabled(true);
+    PedalSession* session = currentSession();
+    if (!session || isLocked(session)) return;
+
+    if (session->currentPlayingSlot == slot) {
+        stopExistingWorker(session);
         return;
     }
 
-    stopExistingWorker();
+    stopExistingWorker(session);
+    startPlayback(session, slot, 0.0);
+}
 
+void MainWindow::startPlayback(PedalSession* session, int slot, double startTime) {
     double duration = 0.0;
-    if (slot >= 0 && slot < (int)cachedTracks.size() && cachedTracks[slot].has_track) {
-        duration = cachedTracks[slot].duration;
-    }
-    currentPlayingDuration = duration;
-
-    worker = new Worker(&device, Worker::Play, slot, "", duration, &playbackVolume);
-    connect(worker, &Worker::progress, this, &MainWindow::onProgress);
-    connect(worker, &Worker::finished, this, &MainWindow::onWorkerFinished);
-    connect(worker, &Worker::error, this, &MainWindow::onWorkerError);
-    worker->start();
-
-    seekSlider->setVisible(true); progressBar->setVisible(false); cancelBtn->setVisible(false);
-    timeLabel->setVisible(true);
-    timeLabel->setText("00:00 / " + QString::asprintf("%02d:%02d", (int)duration / 60, (int)duration % 60));
-    statusLabel->setText(QString("Playing Slot %1...").arg(slot));
-    setActionsEnabled(false);
-
-    currentPlayingSlot = slot;
-    playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPause));
-    playPauseBtn->setToolTip("Pause");
-    playPauseBtn->setEnabled(true);
-    
-    stopBtn->setEnabled(true);
-    isPaused = false;
-    currentProgressTime = 0.0;
+    uint32_t size = 0;
+    if (session->trackModel->hasTrack(slot)) {
+        duration = session->trackModel->tracks()[slot].duration;
+        size = session->trackModel->tracks()[slot].size;
+    }
+    session->currentPlayingSlot = slot;
+    session->currentPlayingDuration = duration;
+    session->currentProgressTime = startTime;
+    session->isPaused = false;
+
+    Worker* w = new Worker(&session->device, Worker::Play, slot, "", duration, &playbackVolume, startTime);
+    w->setTrackSize(size);
+    startWorker(session, w);
+
+    setSessionStatus(session, QString("Playing Slot %1...").arg(slot));
+    updateTabTitle(session);
+    updateSessionUi();
+}
+
+void MainWindow::startClone(PedalSession* source, int slot, PedalSession* target) {
+    if (isLocked(source) || target->worker || isCloneTarget(target)) return;
+
+    int maxSlot = std::max(0, target->trackTable->rowCount() - 1);
+    bool ok = false;
+    int targetSlot = QInputDialog::getInt(this, "Clone Track",
+        QString("Copy slot %1 to slot of %2:").arg(slot).arg(QString::fromStdString(target->info.name)),
+        std::min(slot, maxSlot), 0, maxSlot, 1, &ok);
+    if (!ok) return;
+
+    if (target->trackModel->hasTrack(targetSlot)) {
+        int ret = QMessageBox::question(this, "Confirm Overwrite",
+            QString("Slot %1 on %2 already has a track. Overwrite it?")
+                .arg(targetSlot).arg(QString::fromStdString(target->info.name)));
+        if (ret != QMessageBox::Yes) return;
+    }
+
+    stopExistingWorker(source);
+
+    Worker* w = new Worker(&source->device, Worker::Clone, slot);
+    w->setCloneTarget(&target->device, targetSlot);
+    source->cloneTarget = target;
+    startWorker(source, w);
+
+    setSessionStatus(source, QString("Cloning Slot %1...").arg(slot));
+    setSessionStatus(target, QString("Receiving Slot %1...").arg(targetSlot));
+    updateTabTitle(source);
+    updateTabTitle(target);
+    setActionsEnabled(target, false);
+    updateSessionUi();
+}
+
+void MainWindow::onMoveClicked(int slot, bool swap) {
+    PedalSession* session = currentSession();
+    if (!session || isLocked(session)) return;
+
+    int slotCount = session->trackModel->rowCount();
+    bool ok = false;
+    int target = QInputDialog::getInt(this, swap ? "Swap Track" : "Move Track",
+        swap ? QString("Swap slot %1 with slot:").arg(slot)
+             : QString("Move slot %1 to slot (tracks in between shift by one):").arg(slot),
+        slot, 0, slotCount - 1, 1, &ok);
+    if (!ok || target == slot) return;
+
+    std::vector<int> source = swap ? SlotPlanner::swapRanges(slotCount, slot, target, 1)
+                                   : SlotPlanner::moveRange(slotCount, slot, 1, target);
+    startReorder(session, source, swap ? QString("Swapping slots %1 and %2...").arg(slot).arg(target)
+                                       : QString("Moving slot %1 to %2...").arg(slot).arg(target));
+}
+
+void MainWindow::onInsertGapClicked(int slot) {
+    PedalSession* session = currentSession();
+    if (!session || isLocked(session)) return;
+
+    std::vector<bool> occupied;
+    for (const auto& t : session->trackModel->tracks()) occupied.push_back(t.has_track);
+    std::vector<int> source = SlotPlanner::insertGap(occupied, slot);
+    if (source.empty()) {
+        QMessageBox::information(this, "Insert Empty Slot", "There is no empty slot after this one to shift tracks into.");
+        return;
+    }
+    startReorder(session, source, QString("Inserting empty slot at %1...").arg(slot));
+}
+
+void MainWindow::startReorder(PedalSession* session, const std::vector<int>& source, const QString& description) {
+    std::vector<bool> occupied;
+    for (const auto& t : session->trackModel->tracks()) occupied.push_back(t.has_track);
+
+    int transfers = 0;
+    for (const auto& step : SlotPlanner::plan(source, occupied)) {
+        if (step.kind != SlotPlanner::Step::Clear) transfers++;
+    }
+    if (transfers == 0) return;
+
+    int ret = QMessageBox::question(this, "Confirm Reorder",
+        QString("This rewrites %1 slot(s) on the pedal. Interrupting it may leave a track only on this computer.\n\nContinue?")
+            .arg(transfers));
+    if (ret != QMessageBox::Yes) return;
+
+    stopExistingWorker(session);
+
+    Worker* w = new Worker(&session->device, Worker::Reorder);
+    w->setArrangement(source);
+    startWorker(session, w);
+
+    setSessionStatus(session, description);
+    updateTabTitle(session);
+    updateSessionUi();
 }
 
 void MainWindow::onWorkerFinished() {
     Worker* finishedWorker = qobject_cast<Worker*>(sender());
     if (!finishedWorker) return;
 
-    if (finishedWorker != worker) {
+    PedalSession* session = sessionForWorker(finishedWorker);
+    if (!session) {
         finishedWorker->deleteLater();
         return;
     }
 
-    while (QApplication::overrideCursor()) {
-        QApplication::restoreOverrideCursor();
-    }
+    Worker::Op lastOp = finishedWorker->getOperation();
+    std::vector<int> changed = finishedWorker->affectedSlots();
+    pollProgress(session);
+    finishedWorker->deleteLater();
+    session->worker = nullptr;
 
-    Worker::Op lastOp = worker->getOperation();
-    worker->deleteLater();
-    worker = nullptr;
-
-    progressBar->setVisible(false); seekSlider->setVisible(false); cancelBtn->setVisible(false); timeLabel->setVisible(false);
-    statusLabel->setText("Connected");
-    setActionsEnabled(true);
+    // The receiving pedal re-reads the slot it was given
+    if (PedalSession* target = session->cloneTarget) {
+        session->cloneTarget = nullptr;
+        startQuery(target, {finishedWorker->getCloneSlot()});
+    }
 
     if (lastOp == Worker::Play) {
-        playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPlay));
-        playPauseBtn->setToolTip("Play Selected Track");
-        stopBtn->setEnabled(false);
-        currentPlayingSlot = -1;
-        isPaused = false;
-        currentProgressTime = 0.0;
+        session->currentPlayingSlot = -1;
+        session->isPaused = false;
+        session->currentProgressTime = 0.0;
     }
 
-    if (lastOp == Worker::Upload || lastOp == Worker::Download || lastOp == Worker::Delete) {
-        onRefreshClicked();
-    }
+    setSessionStatus(session, "Connected");
+    updateTabTitle(session);
+    if (session == currentSession()) updateSessionUi();
+    else setActionsEnabled(session, true);
+
+    // Only the slots the operation wrote are re-read; a full listing is left to
+    // explicit refreshes and the first listing after connecting
+    startQuery(session, changed);
 }
 
 void MainWindow::onWorkerError(QString msg) {
     Worker* finishedWorker = qobject_cast<Worker*>(sender());
+    PedalSession* session = sessionForWorker(finishedWorker);
+    Worker::Op failedOp = finishedWorker ? finishedWorker->getOperation() : Worker::List;
+    std::vector<int> changed = finishedWorker ? finishedWorker->affectedSlots() : std::vector<int>();
 
-    while (QApplication::overrideCursor()) {
-        QApplication::restoreOverrideCursor();
+    if (session && failedOp == Worker::Connect) {
+        // The worker already released the pedal; the half-open tab goes away
+        disconnect(finishedWorker, nullptr, nullptr, nullptr);
+        finishedWorker->deleteLater();
+        session->worker = nullptr;
+        closeSession(session, "Not Connected");
+        if (DaemonClient::isRunning()) {
+            // The interface is claimed by the daemon, not a permission or cable problem
+            QMessageBox::critical(this, "Error",
+                "Failed to connect: the pedal is in use by mooerd.\n\n"
+                "Stop the daemon to manage it here, or use mooer-cli, which goes through the daemon.");
+        } else {
+            QMessageBox::critical(this, "Error", msg);
+        }
+        return;
     }
 
-    if (finishedWorker && finishedWorker == worker) {
-        disconnect(worker, nullptr, nullptr, nullptr);
-        worker->deleteLater();
-        worker = nullptr;
+    if (session) {
+        disconnect(finishedWorker, nullptr, nullptr, nullptr);
+        finishedWorker->deleteLater();
+        session->worker = nullptr;
+        // A failed clone deletes whatever it had written to the target
+        if (PedalSession* target = session->cloneTarget) {
+            session->cloneTarget = nullptr;
+            startQuery(target, {finishedWorker->getCloneSlot()});
+        }
     } else if (finishedWorker) {
         finishedWorker->deleteLater();
         return;
     }
 
-    progressBar->setVisible(false); seekSlider->setVisible(false); cancelBtn->setVisible(false); timeLabel->setVisible(false);
-    statusLabel->setText("Connected");
-    setActionsEnabled(true);
-
-    if (currentPlayingSlot != -1) {
-        playPauseBtn->setIcon(styledIcon(QStyle::SP_MediaPlay));
-        playPauseBtn->setToolTip("Play Selected Track");
-        stopBtn->setEnabled(false);
-        currentPlayingSlot = -1;
-        isPaused = false;
-        currentProgressTime = 0.0;
+    if (session) {
+        session->currentPlayingSlot = -1;
+        session->isPaused = false;
+        session->currentProgressTime = 0.0;
+        setSessionStatus(session, "Connected");
+        updateTabTitle(session);
+        if (session == currentSession()) updateSessionUi();
+        else setActionsEnabled(session, true);
+
+        // A failed upload, delete or reorder may have left its slots half written
+        startQuery(session, changed);
     }
 
-    QMessageBox::critical(this, "Error", msg);
+    QString title = "Error";
+    if (session && sessions.size() > 1) title += " - " + QString::fromStdString(session->info.name);
+    QMessageBox::critical(this, title, msg);
 }
 
-void MainWindow::onProgress(int current, int total) {
-    if (progressBar->isVisible()) {
-        progressBar->setRange(0, total);
-        progressBar->setValue(current);
+namespace {
+// Operations whose progress is counted in bytes
+bool transfersBytes(Worker::Op op) {
+    return op == Worker::Upload || op == Worker::Download || op == Worker::Clone;
+}
+
+QString formatBytes(uint64_t bytes) {
+    if (bytes >= 1024 * 1024) return QString::number(bytes / 1048576.0, 'f', 1) + " MB";
+    return QString::number(bytes / 1024.0, 'f', 0) + " KB";
+}
+}
+
+void MainWindow::onProgressTimer() {
+    for (const auto& session : sessions) {
+        if (session->worker) pollProgress(session.get());
     }
+    // Rates and ETA move even while a transfer is stalled
+    PedalSession* session = currentSession();
+    if (session && session->worker) updateRateLabel(session);
+}
 
-    if (currentPlayingSlot != -1 && total > 0 && currentPlayingDuration > 0) {
-        if (seekSlider->isVisible() && !isSeeking) {
-             // For streaming, 'current' is current chunk, 'total' is total chunks
-             // We want slider to move linearly.
-             int sliderMax = seekSlider->maximum();
-             int val = static_cast<int>((static_cast<double>(current) / total) * sliderMax);
-             seekSlider->setValue(val);
+void MainWindow::pollProgress(PedalSession* session) {
+    if (!session || !session->worker) return;
+    Worker::Op listing = session->worker->getOperation();
+    if (listing == Worker::List || listing == Worker::Connect) {
+        TrackInfo track;
+        while (session->worker->takeListed(track)) session->trackModel->setTrack(track);
+    }
+    ProgressTracker::Snapshot snapshot = session->worker->progress().snapshot();
+    if (snapshot.updates == session->progressUpdates) return;
+    session->progressUpdates = snapshot.updates;
+
+    Worker::Op op = session->worker->getOperation();
+    if (transfersBytes(op)) {
+        if (snapshot.current > session->progressCurrent) {
+            session->sessionBytes += snapshot.current - session->progressCurrent;
         }
+        session->meter.sample(snapshot.current);
+    }
+    session->progressCurrent = snapshot.current;
+    session->progressTotal = snapshot.total;
+    uint64_t current = snapshot.current, total = snapshot.total;
 
-        double elapsed = (static_cast<double>(current) / total) * currentPlayingDuration;
-        currentProgressTime = elapsed;
-        int elapsedSecs = static_cast<int>(elapsed);
-        int totalSecs = static_cast<int>(currentPlayingDuration);
-        timeLabel->setText(QString::asprintf("%02d:%02d / %02d:%02d",
-            elapsedSecs / 60, elapsedSecs % 60, totalSecs / 60, totalSecs % 60));
+    // Playback position comes from the audio clock (onTransportTimer), not chunk counts
+    if (op == Worker::Play) return;
+
+    if (session != currentSession()) {
+        updateTabTitle(session);
+        return;
     }
+
+    if (progressBar->isVisible() && total > 0) {
+        progressBar->setRange(0, 1000);
+        progressBar->setValue(static_cast<int>(1000 * std::min(current, total) / total));
+    }
+
+    updateTabTitle(session);
 }
 
-void MainWindow::setActionsEnabled(bool enabled) {
-    bool isPlaying = (worker && worker->getOperation() == Worker::Play);
-    bool isWorking = (worker != nullptr);
+void MainWindow::updatePlaybackPosition(PedalSession* session) {
+    if (!session->worker || session->worker->getOperation() != Worker::Play) return;
+    const PlaybackClock& clock = session->worker->playbackClock();
+    // Until the stream has consumed its first frames the position stays at the start offset
+    if (clock.isValid()) session->currentProgressTime = clock.position();
+}
 
-    refreshBtn->setEnabled(enabled && device.isConnected());
-    connectBtn->setEnabled(enabled);
-    
-    // playPauseBtn logic
-    if (isPlaying) {
-        playPauseBtn->setEnabled(true); // Can always pause
-        stopBtn->setEnabled(true);
-    } else if (isWorking) {
-        playPauseBtn->setEnabled(false);
-        stopBtn->setEnabled(false);
-    } else {
-        int row = trackTable->currentRow();
-        bool hasTrack = (row >= 0 && row < (int)cachedTracks.size() && cachedTracks[row].has_track);
-        playPauseBtn->setEnabled(hasTrack);
-        stopBtn->setEnabled(false);
+void MainWindow::onTransportTimer() {
+    PedalSession* session = currentSession();
+    if (!session || !session->worker || session->worker->getOperation() != Worker::Play) {
+        transportTimer->stop();
+        return;
     }
+    updatePlaybackPosition(session);
 
-    for (int r = 0; r < trackTable->rowCount(); ++r) {
-        QWidget* w = trackTable->cellWidget(r, 2);
-        if (w) {
-            auto buttons = w->findChildren<QPushButton*>();
-            if (buttons.size() >= 3) {
-                bool hasTrack = (r < (int)cachedTracks.size() && cachedTracks[r].has_track);
-
-                if (isPlaying) {
-                    buttons[0]->setEnabled(false); // Download
-                    buttons[1]->setEnabled(false); // Upload
-                    buttons[2]->setEnabled(false); // Delete
-                } else if (isWorking) {
-                    buttons[0]->setEnabled(false);
-                    buttons[1]->setEnabled(false);
-                    buttons[2]->setEnabled(false);
-                } else {
-                    buttons[0]->setEnabled(hasTrack);
-                    buttons[1]->setEnabled(enabled);
-                    buttons[2]->setEnabled(hasTrack);
-                }
-            }
+    double duration = session->currentPlayingDuration;
+    double elapsed = std::min(session->currentProgressTime, duration);
+    if (duration > 0 && seekSlider->isVisible() && !isSeeking) {
+        seekSlider->setValue(static_cast<int>((elapsed / duration) * seekSlider->maximum()));
+    }
+    // Whole seconds only change the label once a second
+    QString text = QString::asprintf("%02d:%02d / %02d:%02d",
+        (int)elapsed / 60, (int)elapsed % 60, (int)duration / 60, (int)duration % 60);
+    if (timeLabel->text() != text) timeLabel->setText(text);
+}
+
+void MainWindow::updateRateLabel(PedalSession* session) {
+    bool show = session && session->worker && transfersBytes(session->worker->getOperation());
+    rateLabel->setVisible(show);
+    if (!show) return;
+
+    QString text = QString("%1 KB/s (avg %2)")
+        .arg(session->meter.currentRate() / 1024.0, 0, 'f', 0)
+        .arg(session->meter.averageRate() / 1024.0, 0, 'f', 0);
+    double eta = session->meter.eta(session->progressTotal);
+    if (eta >= 0) {
+        int seconds = static_cast<int>(eta + 0.5);
+        text += QString::asprintf(" · %d:%02d left", seconds / 60, seconds % 60);
+    }
+    text += " · " + formatBytes(session->sessionBytes) + " this session";
+    rateLabel->setText(text);
+    rateLabel->setToolTip("Current and average transfer rate, time left, and bytes moved with this pedal since connecting");
+}
+
+void MainWindow::setActionsEnabled(PedalSession* session, bool enabled) {
+    if (!session) return;
+
+    bool isPlaying = (session->worker && session->worker->getOperation() == Worker::Play);
+    bool isWorking = (session->worker != nullptr) || isCloneTarget(session);
+    FileDropTableView* trackTable = session->trackTable;
+
+    if (session == currentSession()) {
+        refreshBtn->setEnabled(enabled && session->device.isConnected());
+        benchmarkBtn->setEnabled(enabled && session->device.isConnected());
+        updateConnectButton();
+
+        // playPauseBtn logic
+        if (isPlaying) {
+            playPauseBtn->setEnabled(true); // Can always pause
+            stopBtn->setEnabled(true);
+        } else if (isWorking) {
+            playPauseBtn->setEnabled(false);
+            stopBtn->setEnabled(false);
+        } else {
+            int row = trackTable->currentRow();
+            bool hasTrack = session->trackModel->hasTrack(row);
+            playPauseBtn->setEnabled(hasTrack);
+            stopBtn->setEnabled(false);
         }
     }
+
+    // One dataChanged for the Actions column; the delegate repaints the visible rows
+    session->trackModel->setActionsEnabled(enabled && !isWorking);
 }
 
 QIcon MainWindow::styledIcon(QStyle::StandardPixmap sp) {
+    auto cached = iconCache.constFind(sp);
+    if (cached != iconCache.constEnd()) return *cached;
+
     QIcon base = style()->standardIcon(sp);
     QPixmap px = base.pixmap(16, 16);
     QPixmap black = px;
@@ -966,5 +1486,6 @@ QIcon MainWindow::styledIcon(QStyle::StandardPixmap sp) {
     QIcon icon;
     icon.addPixmap(black, QIcon::Normal);
     icon.addPixmap(px, QIcon::Disabled);
+    iconCache.insert(sp, icon);
     return icon;
 }
@@ -2,7 +2,8 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTableWidget>
+#include <QTableView>
+#include <QHash>
 #include <QPushButton>
 #include <QLabel>
 #include <QProgressBar>
@@ -17,39 +18,24 @@
 #include <QMimeData>
 #include <QMenu>
 #include <QSlider>
+#include <QTabWidget>
+#include <QTimer>
+#include <QDialog>
+#include <QPointer>
 #include <atomic>
-#include <libusb-1.0/libusb.h>
+#include <memory>
 #include "usb_device.h"
+#include "device_registry.h"
 #include "worker.h"
+#include "progress_tracker.h"
+#include "track_table.h"
 
-class HotplugMonitor : public QThread {
+class FileDropTableView : public QTableView {
     Q_OBJECT
-
 public:
-    HotplugMonitor(QObject* parent = nullptr);
-    ~HotplugMonitor();
-
-    void stop();
-
-signals:
-    void deviceChanged();
-
-protected:
-    void run() override;
-
-private:
-    libusb_context* ctx;
-    libusb_hotplug_callback_handle callbackHandle;
-    std::atomic<bool> stopFlag;
-
-    static int hotplugCallback(libusb_context* ctx, libusb_device* dev,
-                               libusb_hotplug_event event, void* userData);
-};
-
-class FileDropTableWidget : public QTableWidget {
-    Q_OBJECT
-public:
-    using QTableWidget::QTableWidget;
+    using QTableView::QTableView;
+    int currentRow() const { return currentIndex().row(); }
+    int rowCount() const { return model() ? model()->rowCount() : 0; }
 signals:
     void fileDropped(int row, QString filePath);
 protected:
@@ -59,6 +45,29 @@ protected:
     void dropEvent(QDropEvent* event) override;
 };
 
+// One connected pedal: its own libusb handle, I/O worker thread and track table,
+// so transfers to different pedals run side by side
+struct PedalSession {
+    DeviceInfo info;
+    USBDevice device;
+    Worker* worker = nullptr;
+    FileDropTableView* trackTable = nullptr;
+    TrackTableModel* trackModel = nullptr;  // Owned by trackTable
+    QString status = "Connected";
+    uint64_t progressCurrent = 0;
+    uint64_t progressTotal = 0;
+    uint64_t progressUpdates = 0;  // Last worker snapshot applied
+    ThroughputMeter meter;         // Byte transfers only
+    uint64_t sessionBytes = 0;     // Transferred since connecting
+
+    int currentPlayingSlot = -1;
+    double currentPlayingDuration = 0.0;
+    double currentProgressTime = 0.0;
+    bool isPaused = false;
+
+    PedalSession* cloneTarget = nullptr; // Pedal receiving this session's running Clone
+};
+
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
@@ -66,7 +75,17 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Starts the device registry (libusb init, hotplug, auto-connect). Called once the event
+    // loop runs, so the window is up first; independent of it ever being painted.
+    void startDeviceDiscovery();
+
+protected:
+    // Marks the first paint for --profile-startup
+    void paintEvent(QPaintEvent* event) override;
+
 private slots:
+    void onDevicesChanged(std::vector<DeviceInfo> devices, std::vector<DeviceInfo> added,
+                          std::vector<DeviceInfo> removed);
     void onRefreshDevicesClicked();
     void onConnectClicked();
     void onRefreshClicked();
@@ -77,48 +96,93 @@ private slots:
     void onPlayPauseAction();
     void onCustomContextMenuRequested(const QPoint& pos);
     void onFileDropped(int row, QString filePath);
+    void onCurrentTabChanged(int index);
+    void onDiagnosticsClicked();
+    void onAudioSettingsClicked();
+    void onBenchmarkClicked();
 
     void onWorkerFinished();
     void onWorkerError(QString msg);
     void onTracksLoaded(std::vector<TrackInfo> tracks);
-    void onProgress(int current, int total);
+    void onTracksUpdated(std::vector<TrackInfo> tracks);
+    void onLinkMeasured(LinkProfile profile);
+    void onWorkerPhase(QString text);
+    void onProgressTimer();
+    void onTransportTimer();
 
 private:
-    USBDevice device;
-    Worker* worker;
-    HotplugMonitor* hotplugMonitor;
+    std::vector<std::unique_ptr<PedalSession>> sessions;
+    // Cancelled Connects still winding down; each keeps its closed session alive until it ends
+    std::vector<QPointer<Worker>> abandonedConnects;
+    DeviceRegistry* deviceRegistry;
 
     QComboBox* deviceCombo;
-    std::vector<DeviceInfo> deviceList;
-
-    FileDropTableWidget* trackTable;
+    std::vector<DeviceInfo> deviceList;  // Latest registry snapshot, in combo order
+    bool devicesListed = false;          // First snapshot seen (auto-connect, combo placeholder)
+    bool painted = false;  // First paint marked
+    // Pedal to connect once a rescan shows it accessible (after installing the udev rule)
+    bool connectAfterRescan = false;
+    uint8_t rescanBus = 0;
+    uint8_t rescanAddress = 0;
+
+    QTabWidget* deviceTabs;
     QPushButton* connectBtn;
     QPushButton* refreshBtn;
+    QPushButton* benchmarkBtn;
     QLabel* statusLabel;
     QProgressBar* progressBar;
+    QLabel* rateLabel;
+    QTimer* progressTimer;
+    QTimer* transportTimer;  // Runs only while the visible pedal plays
     QSlider* seekSlider; // Replaces progressBar
     QLabel* timeLabel;
     QSlider* volumeSlider;
     QLabel* volumeLabel;
     std::atomic<int> playbackVolume;
 
-    int currentPlayingSlot;
-    double currentPlayingDuration;
-    double currentProgressTime;
     bool isSeeking; // Flag to track if user is interacting with seek slider
-    bool isPaused;
     QPushButton* playPauseBtn; // Global play/pause button
     QPushButton* stopBtn;      // Stop button
     QPushButton* cancelBtn;
     QString lastFileDialogDir;
-    std::vector<TrackInfo> cachedTracks;
+    QDialog* diagnosticsDialog = nullptr;
+    QHash<int, QIcon> iconCache;  // styledIcon() renders each icon once
 
     void setupUi();
+    FileDropTableView* createTrackTable(PedalSession* session);
+    // Rebuilds the device combo from deviceList
     void refreshDeviceList();
-    void updateTable();
-    void updatePlayButtonState();
-    bool stopExistingWorker();
-    void setActionsEnabled(bool enabled);
+    void updateConnectButton();
+    void updateSessionUi();
+    void updateTabTitle(PedalSession* session);
+    void setSessionStatus(PedalSession* session, const QString& text);
+    // Applies the worker's latest progress snapshot; cheap when nothing changed
+    void pollProgress(PedalSession* session);
+    void updateRateLabel(PedalSession* session);
+    // Reads the playing worker's audio clock into currentProgressTime
+    void updatePlaybackPosition(PedalSession* session);
+
+    PedalSession* currentSession() const;
+    PedalSession* sessionForWorker(QObject* worker) const;
+    PedalSession* sessionForDevice(const DeviceInfo& info) const;
+    void openSession(const DeviceInfo& info);
+    void closeSession(PedalSession* session, const QString& reason);
+    void startWorker(PedalSession* session, Worker* worker);
+    void startPlayback(PedalSession* session, int slot, double startTime);
+    // Full listing; slots appear in the table as they are read, visible rows first
+    void startListing(PedalSession* session);
+    // Re-reads only the given slots (after an operation changed them) and patches the table
+    void startQuery(PedalSession* session, const std::vector<int>& slots);
+    void startClone(PedalSession* source, int slot, PedalSession* target);
+    void startReorder(PedalSession* session, const std::vector<int>& source, const QString& description);
+    void onMoveClicked(int slot, bool swap);
+    void onInsertGapClicked(int slot);
+    bool isCloneTarget(PedalSession* session) const;
+    bool isConnecting(PedalSession* session) const;
+    // Receiving a clone or still connecting: other operations must not replace its worker
+    bool isLocked(PedalSession* session) const;
+    bool stopExistingWorker(PedalSession* session);
+    void setActionsEnabled(PedalSession* session, bool enabled);
     QIcon styledIcon(QStyle::StandardPixmap sp);
 };
 
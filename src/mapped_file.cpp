@@ -0,0 +1,20 @@
+#include "mapped_file.h"
+#include <iostream>
+
+MappedFile MappedFile::open(const QString& path) {
+    MappedFile mapped;
+    mapped.file = std::make_unique<QFile>(path);
+    if (!mapped.file->open(QIODevice::ReadOnly) || mapped.file->size() == 0) {
+        mapped.file.reset();
+        return mapped;
+    }
+
+    mapped.size = mapped.file->size();
+    mapped.data = mapped.file->map(0, mapped.size);
+    if (!mapped.data) {
+        std::cerr << "Cannot map " << path.toStdString() << std::endl;
+        mapped.file.reset();
+        mapped.size = 0;
+    }
+    return mapped;
+}
@@ -0,0 +1,22 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <memory>
+
+// Read-only memory mapping of a whole file; the mapping lives as long as the object
+struct MappedFile {
+    std::unique_ptr<QFile> file;
+    const uchar* data = nullptr;
+    qint64 size = 0;
+
+    bool isValid() const { return data != nullptr; }
+    // Zero-copy view; must not outlive the MappedFile
+    QByteArray bytes() const { return QByteArray::fromRawData(reinterpret_cast<const char*>(data), size); }
+
+    static MappedFile open(const QString& path);
+};
+
+#endif // MAPPED_FILE_H
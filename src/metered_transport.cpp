@@ -0,0 +1,90 @@
+#include "metered_transport.h"
+#include "protocol.h"
+#include <cstdio>
+
+namespace {
+std::string endpointLabel(int endpoint) {
+    char label[32];
+    snprintf(label, sizeof(label), "endpoint=\"0x%02x\"", endpoint);
+    return label;
+}
+}
+
+MeteredTransport::MeteredTransport(std::unique_ptr<Transport> inner) : inner(std::move(inner)) {
+    const int known[4] = {Protocol::EP_OUT, 0x03, Protocol::EP_IN_STATUS, Protocol::EP_IN_DATA};
+    for (int i = 0; i < 4; i++) {
+        std::string label = endpointLabel(known[i]);
+        endpoints[i] = {&Metrics::counter("mooer_usb_transfers_total", label),
+                        &Metrics::counter("mooer_usb_bytes_total", label),
+                        &Metrics::counter("mooer_usb_timeouts_total", label),
+                        &Metrics::counter("mooer_usb_errors_total", label),
+                        &Metrics::histogram("mooer_usb_transfer_latency_us", label)};
+    }
+    settleMs = &Metrics::counter("mooer_usb_settle_ms_total");
+    Metrics::gauge("mooer_pedals_connected").add(1);
+}
+
+MeteredTransport::~MeteredTransport() {
+    Metrics::gauge("mooer_pedals_connected").add(-1);
+}
+
+MeteredTransport::EndpointMetrics& MeteredTransport::metricsFor(int endpoint) {
+    switch (endpoint) {
+    case Protocol::EP_OUT: return endpoints[0];
+    case 0x03: return endpoints[1];
+    case Protocol::EP_IN_STATUS: return endpoints[2];
+    default: return endpoints[3];
+    }
+}
+
+Metrics::Histogram* MeteredTransport::commandHistogram(unsigned char subcommand) {
+    // Resolved once per subcommand; the registry lock is never taken per transfer
+    static Metrics::Histogram* download = &Metrics::histogram("mooer_usb_command_latency_us", "command=\"download\"");
+    static Metrics::Histogram* upload = &Metrics::histogram("mooer_usb_command_latency_us", "command=\"upload\"");
+    static Metrics::Histogram* initUpload = &Metrics::histogram("mooer_usb_command_latency_us", "command=\"init_upload\"");
+    static Metrics::Histogram* remove = &Metrics::histogram("mooer_usb_command_latency_us", "command=\"delete\"");
+    static Metrics::Histogram* play = &Metrics::histogram("mooer_usb_command_latency_us", "command=\"play\"");
+    static Metrics::Histogram* other = &Metrics::histogram("mooer_usb_command_latency_us", "command=\"other\"");
+    switch (subcommand) {
+    case 0x82: return download;
+    case 0x84: return upload;
+    case 0x86: return initUpload;
+    case 0x88: return remove;
+    case 0x8A: return play;
+    default: return other;
+    }
+}
+
+int MeteredTransport::transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) {
+    auto start = std::chrono::steady_clock::now();
+    int r = inner->transfer(endpoint, data, length, transferred, timeout);
+    auto end = std::chrono::steady_clock::now();
+
+    EndpointMetrics& m = metricsFor(endpoint);
+    m.transfers->add();
+    m.latency->record(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    if (r == 0) m.bytes->add(*transferred);
+    else if (r == LIBUSB_ERROR_TIMEOUT) m.timeouts->add();
+    else m.errors->add();
+
+    if (endpoint == Protocol::EP_OUT && length >= 6 && data[0] == 0x3F && data[1] == 0xAA && data[2] == 0x55) {
+        pendingCommand = r == 0 ? commandHistogram(data[5]) : nullptr;
+        commandStart = start;
+    } else if ((endpoint & 0x80) && pendingCommand) {
+        pendingCommand->record(std::chrono::duration_cast<std::chrono::microseconds>(end - commandStart).count());
+        pendingCommand = nullptr;
+    }
+    return r;
+}
+
+void MeteredTransport::settle(std::chrono::milliseconds duration) {
+    settleMs->add(duration.count());
+    inner->settle(duration);
+}
+
+void MeteredTransport::mark(const std::string& op) {
+    // "read 3 1" -> op="read"
+    std::string name = op.substr(0, op.find(' '));
+    Metrics::counter("mooer_ops_total", "op=\"" + name + "\"").add();
+    inner->mark(op);
+}
@@ -0,0 +1,42 @@
+#ifndef METERED_TRANSPORT_H
+#define METERED_TRANSPORT_H
+
+#include <chrono>
+#include <memory>
+#include "metrics.h"
+#include "transport.h"
+
+// Forwards to another transport and records every transfer in Metrics: latency, bytes,
+// timeouts and errors per endpoint, plus command round trips (command write until the
+// end of the next IN transfer) per protocol subcommand.
+class MeteredTransport : public Transport {
+public:
+    explicit MeteredTransport(std::unique_ptr<Transport> inner);
+    ~MeteredTransport() override;
+
+    int transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) override;
+    void settle(std::chrono::milliseconds duration) override;
+    void mark(const std::string& op) override;
+
+private:
+    struct EndpointMetrics {
+        Metrics::Counter* transfers;
+        Metrics::Counter* bytes;
+        Metrics::Counter* timeouts;
+        Metrics::Counter* errors;
+        Metrics::Histogram* latency;
+    };
+
+    std::unique_ptr<Transport> inner;
+    EndpointMetrics endpoints[4];  // EP_OUT, data out, IN_STATUS, IN_DATA
+    Metrics::Counter* settleMs;
+
+    // Command waiting for its reply; only touched by the thread doing the I/O
+    Metrics::Histogram* pendingCommand = nullptr;
+    std::chrono::steady_clock::time_point commandStart;
+
+    EndpointMetrics& metricsFor(int endpoint);
+    static Metrics::Histogram* commandHistogram(unsigned char subcommand);
+};
+
+#endif // METERED_TRANSPORT_H
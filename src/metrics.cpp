@@ -0,0 +1,188 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace {
+// Largest exported histogram bound is 2^40 - 1 (about 12 days in microseconds)
+const int EXPORT_EXPONENTS = 40;
+
+enum Kind { CounterKind, GaugeKind, HistogramKind };
+
+struct Entry {
+    std::string name;
+    std::string labels;
+    Kind kind;
+    Metrics::Counter counter;
+    Metrics::Gauge gauge;
+    std::unique_ptr<Metrics::Histogram> histogram;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::deque<Entry> entries;  // Stable addresses
+    std::map<std::pair<std::string, std::string>, Entry*> index;  // (name, labels)
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+Entry& lookup(const std::string& name, const std::string& labels, Kind kind) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto key = std::make_pair(name, labels);
+    auto it = r.index.find(key);
+    if (it != r.index.end()) return *it->second;
+
+    r.entries.emplace_back();
+    Entry& entry = r.entries.back();
+    entry.name = name;
+    entry.labels = labels;
+    entry.kind = kind;
+    if (kind == HistogramKind) entry.histogram = std::make_unique<Metrics::Histogram>();
+    r.index[key] = &entry;
+    return entry;
+}
+
+std::string series(const Entry& entry, const std::string& suffix = std::string(), const std::string& extra = std::string()) {
+    std::string labels = entry.labels;
+    if (!extra.empty()) labels += (labels.empty() ? "" : ",") + extra;
+    return entry.name + suffix + (labels.empty() ? "" : "{" + labels + "}");
+}
+}
+
+int Metrics::Histogram::bucketFor(uint64_t value) {
+    if (value < SUB_BUCKETS) return static_cast<int>(value);
+    int exponent = 63 - __builtin_clzll(value);  // >= 3
+    int sub = static_cast<int>((value >> (exponent - 3)) & (SUB_BUCKETS - 1));
+    return SUB_BUCKETS + (exponent - 3) * SUB_BUCKETS + sub;
+}
+
+uint64_t Metrics::Histogram::bucketUpperBound(int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    int exponent = (bucket - SUB_BUCKETS) / SUB_BUCKETS + 3;
+    uint64_t sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    if (exponent == 63 && sub == SUB_BUCKETS - 1) return UINT64_MAX;
+    return ((SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+}
+
+void Metrics::Histogram::record(uint64_t value) {
+    buckets[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    valueSum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t seen = maxValue.load(std::memory_order_relaxed);
+    while (value > seen && !maxValue.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t Metrics::Histogram::percentile(double q) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q * n + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += bucketCount(i);
+        if (seen >= rank) return std::min(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+void Metrics::Histogram::reset() {
+    for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+    total = 0;
+    valueSum = 0;
+    maxValue = 0;
+}
+
+Metrics::Counter& Metrics::counter(const std::string& name, const std::string& labels) {
+    return lookup(name, labels, CounterKind).counter;
+}
+
+Metrics::Gauge& Metrics::gauge(const std::string& name, const std::string& labels) {
+    return lookup(name, labels, GaugeKind).gauge;
+}
+
+Metrics::Histogram& Metrics::histogram(const std::string& name, const std::string& labels) {
+    return *lookup(name, labels, HistogramKind).histogram;
+}
+
+std::string Metrics::exposition() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    // Index is sorted by name, so series of one metric are adjacent
+    std::string out;
+    std::string lastName;
+    for (const auto& item : r.index) {
+        const Entry& e = *item.second;
+        if (e.name != lastName) {
+            const char* type = e.kind == CounterKind ? "counter" : e.kind == GaugeKind ? "gauge" : "histogram";
+            out += "# TYPE " + e.name + " " + type + "\n";
+            lastName = e.name;
+        }
+        if (e.kind == CounterKind) {
+            out += series(e) + " " + std::to_string(e.counter.value.load(std::memory_order_relaxed)) + "\n";
+        } else if (e.kind == GaugeKind) {
+            out += series(e) + " " + std::to_string(e.gauge.value.load(std::memory_order_relaxed)) + "\n";
+        } else {
+            // Cumulative counts at a fixed set of bounds, 2^k - 1 for k = 0..EXPORT_EXPONENTS,
+            // so every scrape has the same `le` series. Each is the top of an internal bucket.
+            const Histogram& h = *e.histogram;
+            uint64_t cumulative = 0;
+            int next = 0;
+            for (int k = 0; k <= EXPORT_EXPONENTS; k++) {
+                uint64_t bound = (uint64_t(1) << k) - 1;
+                for (int last = Histogram::bucketFor(bound); next <= last; next++) cumulative += h.bucketCount(next);
+                out += series(e, "_bucket", "le=\"" + std::to_string(bound) + "\"") + " " +
+                       std::to_string(cumulative) + "\n";
+            }
+            out += series(e, "_bucket", "le=\"+Inf\"") + " " + std::to_string(h.count()) + "\n";
+            out += series(e, "_sum") + " " + std::to_string(h.sum()) + "\n";
+            out += series(e, "_count") + " " + std::to_string(h.count()) + "\n";
+        }
+    }
+    return out;
+}
+
+std::string Metrics::summary() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    std::string out;
+    char line[256];
+    for (const auto& item : r.index) {
+        const Entry& e = *item.second;
+        if (e.kind == HistogramKind) {
+            const Histogram& h = *e.histogram;
+            if (h.count() == 0) continue;
+            snprintf(line, sizeof(line), "%-60s n=%-8llu p50=%-8llu p99=%-8llu max=%llu\n", series(e).c_str(),
+                     (unsigned long long)h.count(), (unsigned long long)h.percentile(0.5),
+                     (unsigned long long)h.percentile(0.99), (unsigned long long)h.max());
+        } else if (e.kind == CounterKind) {
+            snprintf(line, sizeof(line), "%-60s %llu\n", series(e).c_str(),
+                     (unsigned long long)e.counter.value.load(std::memory_order_relaxed));
+        } else {
+            snprintf(line, sizeof(line), "%-60s %lld\n", series(e).c_str(),
+                     (long long)e.gauge.value.load(std::memory_order_relaxed));
+        }
+        out += line;
+    }
+    return out;
+}
+
+void Metrics::reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (Entry& e : r.entries) {
+        e.counter.value = 0;
+        // Gauges describe current state (e.g. connected pedals) and are left alone
+        if (e.histogram) e.histogram->reset();
+    }
+}
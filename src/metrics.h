@@ -0,0 +1,63 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Process-wide counters, gauges and latency histograms, keyed by name + labels
+// (e.g. "mooer_usb_transfer_latency_us", "endpoint=\"0x83\"").
+// Looking a metric up takes a lock, so call sites keep the returned reference;
+// updating one is a relaxed atomic op and never blocks.
+class Metrics {
+public:
+    struct Counter {
+        std::atomic<uint64_t> value{0};
+        void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    };
+
+    struct Gauge {
+        std::atomic<int64_t> value{0};
+        void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+        void add(int64_t d) { value.fetch_add(d, std::memory_order_relaxed); }
+    };
+
+    // HDR-style log-linear buckets: values below 8 are exact, above that each power of two
+    // is split into 8 sub-buckets, so any recorded value is within 12.5% of its bucket bound
+    class Histogram {
+    public:
+        static const int SUB_BUCKETS = 8;
+        static const int BUCKETS = SUB_BUCKETS + 61 * SUB_BUCKETS;
+
+        void record(uint64_t value);
+        uint64_t count() const { return total.load(std::memory_order_relaxed); }
+        uint64_t sum() const { return valueSum.load(std::memory_order_relaxed); }
+        uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+        uint64_t bucketCount(int bucket) const { return buckets[bucket].load(std::memory_order_relaxed); }
+        // Upper bound of the bucket holding the q-th quantile (0..1)
+        uint64_t percentile(double q) const;
+        void reset();
+
+        static int bucketFor(uint64_t value);
+        static uint64_t bucketUpperBound(int bucket);
+
+    private:
+        std::atomic<uint64_t> buckets[BUCKETS] = {};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> valueSum{0};
+        std::atomic<uint64_t> maxValue{0};
+    };
+
+    static Counter& counter(const std::string& name, const std::string& labels = std::string());
+    static Gauge& gauge(const std::string& name, const std::string& labels = std::string());
+    static Histogram& histogram(const std::string& name, const std::string& labels = std::string());
+
+    // Prometheus text exposition format
+    static std::string exposition();
+    // One line per metric with count, p50/p99/max for histograms, for people rather than scrapers
+    static std::string summary();
+    // Zeroes every value; registered metrics stay valid
+    static void reset();
+};
+
+#endif // METRICS_H
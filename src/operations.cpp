@@ -0,0 +1,198 @@
+#include "operations.h"
+#include "audio_cache.h"
+#include "pedal_mirror.h"
+#include "chunk_pipe.h"
+#include "slot_planner.h"
+#include "link_profile.h"
+#include "trace_events.h"
+#include <QDir>
+#include <QStandardPaths>
+#include <stdexcept>
+#include <thread>
+
+void Operations::download(USBDevice& device, int slot, const std::string& filename, AudioUtils::OutputFormat format,
+                          ProgressCallback callback, void* userData) {
+    QByteArray data = device.downloadTrackRaw(slot, callback, userData);
+    PedalMirror(device.getSerial()).store(slot, data);
+    if (!AudioUtils::savePackedAudio(filename, data, format)) {
+        throw std::runtime_error("Failed to write " + filename);
+    }
+}
+
+void Operations::upload(USBDevice& device, int slot, const std::string& filename,
+                        ProgressCallback callback, void* userData) {
+    PedalMirror(device.getSerial()).invalidate(slot);
+    AudioCache cache;
+    AudioCache::Blob cached;
+    {
+        MOOER_TRACE_SCOPE("audio", "AudioCache::lookup");
+        cached = cache.lookup(filename);
+    }
+    if (cached.isValid()) {
+        device.uploadTrackRaw(slot, cached.bytes(), callback, userData);
+    } else {
+        QByteArray packed = Protocol::encodeAudioData(AudioUtils::loadAudioFile(filename));
+        cache.store(filename, packed);
+        device.uploadTrackRaw(slot, packed, callback, userData);
+    }
+}
+
+void Operations::remove(USBDevice& device, int slot) {
+    PedalMirror(device.getSerial()).invalidate(slot);
+    device.deleteTrack(slot);
+}
+
+std::vector<std::string> Operations::backup(USBDevice& device, const std::string& directory, AudioUtils::OutputFormat format,
+                                            const std::atomic<bool>* stopFlag, ProgressCallback callback, void* userData) {
+    QDir dir(QString::fromStdString(directory));
+    if (!dir.mkpath(".")) {
+        throw std::runtime_error("Cannot create " + directory);
+    }
+
+    std::vector<TrackInfo> tracks = device.listTracks();
+    uint64_t total = 0, done = 0;
+    for (const auto& t : tracks) {
+        if (t.has_track) total += t.size;
+    }
+
+    // Progress spans the whole backup, in bytes
+    struct Span { ProgressCallback callback; void* userData; uint64_t done; uint64_t total; };
+    Span span{callback, userData, 0, total};
+    auto spanCallback = [](size_t c, size_t, void* u) {
+        Span* s = static_cast<Span*>(u);
+        if (s->callback) s->callback(s->done + c, s->total, s->userData);
+    };
+
+    const char* ext = (format == AudioUtils::Flac) ? "flac" : "wav";
+    std::vector<std::string> written;
+    for (const auto& t : tracks) {
+        if (!t.has_track) continue;
+        if (stopFlag && *stopFlag) break;
+
+        std::string path = dir.filePath(QString("slot_%1.%2").arg(t.slot, 2, 10, QChar('0')).arg(ext)).toStdString();
+        span.done = done;
+        download(device, t.slot, path, format, spanCallback, &span);
+        written.push_back(path);
+        done += t.size;
+    }
+    return written;
+}
+
+// Pipes raw packed chunks from the source pedal into the target pedal's upload.
+// The source is read on a helper thread; a bounded pipe, sized from the source's measured
+// link speed, keeps both transfers running concurrently without ever holding the whole
+// track or touching disk.
+void Operations::clone(USBDevice& source, int slot, USBDevice& target, int targetSlot,
+                       const std::atomic<bool>* stopFlag, ProgressCallback callback, void* userData) {
+    PedalMirror(target.getSerial()).invalidate(targetSlot);
+
+    ChunkPipe pipe(LinkProfile::load(source.getSerial()).pipelineDepth());
+    std::string readError;
+    bool sourceExists = true;
+
+    std::thread reader([&]() {
+        TraceEvents::setThreadName("Clone source");
+        try {
+            uint32_t size = 0;
+            bool announced = false;
+            sourceExists = source.readTrackChunks(slot, [&](int, int, const QByteArray& data) {
+                if (!announced) {
+                    pipe.setTotalSize(size);
+                    announced = true;
+                }
+                return pipe.push(data);
+            }, 1, stopFlag, &size);
+        } catch (const std::exception& e) {
+            readError = e.what();
+        }
+        pipe.close();
+    });
+
+    try {
+        uint32_t size = 0;
+        if (pipe.waitTotalSize(size)) {
+            target.uploadTrackChunks(targetSlot, size, [&]() {
+                QByteArray chunk;
+                pipe.pop(chunk);
+                return chunk;
+            }, callback, userData);
+        }
+    } catch (...) {
+        pipe.abort();
+        reader.join();
+        // Don't leave a truncated track behind
+        try { target.deleteTrack(targetSlot); } catch (...) {}
+        if (stopFlag && *stopFlag) return;
+        if (!readError.empty()) throw std::runtime_error("Reading source failed: " + readError);
+        throw;
+    }
+    reader.join();
+
+    if (!readError.empty()) throw std::runtime_error("Reading source failed: " + readError);
+    if (!sourceExists) throw std::runtime_error("Track does not exist");
+}
+
+// Executes a SlotPlanner plan: each moved track is read once (from the local mirror when it
+// is current, otherwise over USB) and uploaded once. The mirror follows the tracks around.
+void Operations::reorder(USBDevice& device, const std::vector<int>& arrangement,
+                         const std::atomic<bool>* stopFlag, ProgressCallback callback, void* userData) {
+    auto tracks = device.listTracks();
+    if (arrangement.size() != tracks.size()) {
+        throw std::runtime_error("Slot arrangement does not match the pedal");
+    }
+
+    std::vector<bool> occupied(tracks.size());
+    for (size_t i = 0; i < tracks.size(); i++) occupied[i] = tracks[i].has_track;
+    auto steps = SlotPlanner::plan(arrangement, occupied);
+
+    PedalMirror mirror(device.getSerial());
+    auto readSlot = [&](int s) {
+        MappedFile local = mirror.open(s, tracks[s].size, [&]() { return device.readFirstChunk(s); });
+        if (local.isValid()) return QByteArray(reinterpret_cast<const char*>(local.data), local.size);
+        return device.downloadTrackRaw(s);
+    };
+
+    QByteArray stash;
+    int stashSlot = -1;
+    try {
+        for (size_t i = 0; i < steps.size(); i++) {
+            if (stopFlag && *stopFlag) throw std::runtime_error("Reorder cancelled");
+            const SlotPlanner::Step& step = steps[i];
+            if (callback) callback(i, steps.size(), userData);
+
+            if (step.kind == SlotPlanner::Step::Stash) {
+                stash = readSlot(step.from);
+                stashSlot = step.from;
+            } else if (step.kind == SlotPlanner::Step::Copy) {
+                QByteArray data = readSlot(step.from);
+                mirror.invalidate(step.to);
+                device.uploadTrackRaw(step.to, data);
+                mirror.store(step.to, data);
+                tracks[step.to].size = data.size();
+            } else if (step.kind == SlotPlanner::Step::Unstash) {
+                mirror.invalidate(step.to);
+                device.uploadTrackRaw(step.to, stash);
+                mirror.store(step.to, stash);
+                tracks[step.to].size = stash.size();
+                stash.clear();
+                stashSlot = -1;
+            } else {
+                mirror.invalidate(step.to);
+                device.deleteTrack(step.to);
+            }
+        }
+        if (callback) callback(steps.size(), steps.size(), userData);
+    } catch (const std::exception& e) {
+        // The stashed track exists nowhere else on the pedal any more; keep it on disk
+        if (!stash.isEmpty()) {
+            QString dir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+            QDir().mkpath(dir);
+            std::string rescue = QString("%1/reorder_slot_%2.wav").arg(dir).arg(stashSlot).toStdString();
+            if (AudioUtils::saveWav24File(rescue, stash)) {
+                throw std::runtime_error(std::string(e.what()) + "\nThe track from slot " +
+                                         std::to_string(stashSlot) + " was saved to " + rescue);
+            }
+        }
+        throw;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef OPERATIONS_H
+#define OPERATIONS_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "usb_device.h"
+#include "audio_utils.h"
+
+// Pedal operations shared by the GUI worker and the command-line client. Each runs
+// synchronously on the calling thread and throws std::runtime_error on failure.
+// Progress is reported through the same callback type as USBDevice.
+class Operations {
+public:
+    typedef USBDevice::ProgressCallback ProgressCallback;
+
+    static void download(USBDevice& device, int slot, const std::string& filename, AudioUtils::OutputFormat format,
+                         ProgressCallback callback = nullptr, void* userData = nullptr);
+    // Converts any supported audio file, reusing the conversion cache
+    static void upload(USBDevice& device, int slot, const std::string& filename,
+                       ProgressCallback callback = nullptr, void* userData = nullptr);
+    static void remove(USBDevice& device, int slot);
+
+    // Downloads every occupied slot into `directory` as slot_NN.<ext>; returns the files written
+    static std::vector<std::string> backup(USBDevice& device, const std::string& directory, AudioUtils::OutputFormat format,
+                                           const std::atomic<bool>* stopFlag = nullptr,
+                                           ProgressCallback callback = nullptr, void* userData = nullptr);
+
+    // Streams `slot` of `source` straight into `targetSlot` of `target`
+    static void clone(USBDevice& source, int slot, USBDevice& target, int targetSlot,
+                      const std::atomic<bool>* stopFlag = nullptr,
+                      ProgressCallback callback = nullptr, void* userData = nullptr);
+    // Rearranges slots so slot d ends up holding the current track of arrangement[d]
+    static void reorder(USBDevice& device, const std::vector<int>& arrangement,
+                        const std::atomic<bool>* stopFlag = nullptr,
+                        ProgressCallback callback = nullptr, void* userData = nullptr);
+};
+
+#endif // OPERATIONS_H
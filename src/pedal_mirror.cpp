@@ -0,0 +1,79 @@
+#include "pedal_mirror.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <iostream>
+
+PedalMirror::PedalMirror(const std::string& serial, const QString& rootDir) {
+    if (serial.empty()) return;
+
+    QString root = rootDir.isEmpty()
+        ? QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/mirror"
+        : rootDir;
+    QString safeSerial = QString::fromStdString(serial).replace(QRegularExpression("[^A-Za-z0-9_-]"), "_");
+    mirrorDir = root + "/" + safeSerial;
+    QDir().mkpath(mirrorDir);
+}
+
+QString PedalMirror::blobPath(int slot) const {
+    return mirrorDir + QString("/slot_%1.pcm24").arg(slot, 2, 10, QChar('0'));
+}
+
+QString PedalMirror::metaPath(int slot) const {
+    return mirrorDir + QString("/slot_%1.meta").arg(slot, 2, 10, QChar('0'));
+}
+
+QByteArray PedalMirror::firstChunkHash(const QByteArray& packed, uint32_t size) {
+    return QCryptographicHash::hash(packed.left(std::min<uint32_t>(size, 1024)), QCryptographicHash::Sha1).toHex();
+}
+
+bool PedalMirror::readMeta(int slot, uint32_t size, QByteArray& firstChunkHash) const {
+    if (!isEnabled() || size == 0) return false;
+
+    // Meta is "<size> <sha1 of chunk 1>", written after the blob has been committed
+    QFile meta(metaPath(slot));
+    if (!meta.open(QIODevice::ReadOnly)) return false;
+    QList<QByteArray> fields = meta.readAll().trimmed().split(' ');
+    if (fields.size() != 2 || fields[0].toULongLong() != size) return false;
+    if (QFileInfo(blobPath(slot)).size() != size) return false;
+
+    firstChunkHash = fields[1];
+    return true;
+}
+
+MappedFile PedalMirror::open(int slot, uint32_t size, const std::function<QByteArray()>& readFirstChunk) const {
+    QByteArray stored;
+    if (!readMeta(slot, size, stored)) return MappedFile();
+    QByteArray firstChunk = readFirstChunk();
+    if (firstChunk.isEmpty() || stored != firstChunkHash(firstChunk, size)) return MappedFile();
+    return MappedFile::open(blobPath(slot));
+}
+
+bool PedalMirror::store(int slot, const QByteArray& packed) {
+    if (!isEnabled() || packed.isEmpty()) return false;
+
+    invalidate(slot);
+
+    QSaveFile blob(blobPath(slot));
+    if (!blob.open(QIODevice::WriteOnly) || blob.write(packed) != packed.size() || !blob.commit()) {
+        std::cerr << "Failed to write mirror for slot " << slot << std::endl;
+        return false;
+    }
+
+    QSaveFile meta(metaPath(slot));
+    if (!meta.open(QIODevice::WriteOnly)) return false;
+    meta.write(QByteArray::number(packed.size()) + " " + firstChunkHash(packed, packed.size()));
+    return meta.commit();
+}
+
+void PedalMirror::invalidate(int slot) {
+    if (!isEnabled()) return;
+    // Meta first, so a concurrent reader never sees a valid meta over a missing blob
+    QFile::remove(metaPath(slot));
+    QFile::remove(blobPath(slot));
+}
@@ -0,0 +1,39 @@
+#ifndef PEDAL_MIRROR_H
+#define PEDAL_MIRROR_H
+
+#include <QString>
+#include <QByteArray>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include "mapped_file.h"
+
+// Local copy of each slot's packed audio, keyed by pedal serial and slot.
+// An entry is current when its size matches the size the pedal reports and its first
+// chunk matches chunk 1 read back from the pedal. Size alone is not enough: a loop
+// re-recorded on the pedal is often quantised to exactly the same length.
+// Our own uploads and deletes invalidate it, downloads and full playbacks refill it.
+class PedalMirror {
+public:
+    // Empty serial disables the mirror: without it we cannot tell two pedals apart
+    explicit PedalMirror(const std::string& serial, const QString& rootDir = QString());
+
+    bool isEnabled() const { return !mirrorDir.isEmpty(); }
+    // Maps the slot's mirror, or returns an invalid mapping if it is missing or stale.
+    // `readFirstChunk` fetches chunk 1 from the pedal; it is only called when an entry of
+    // the right size exists, and may return it padded to 1 KB.
+    MappedFile open(int slot, uint32_t size, const std::function<QByteArray()>& readFirstChunk) const;
+    bool store(int slot, const QByteArray& packed);
+    void invalidate(int slot);
+
+private:
+    QString mirrorDir;
+
+    QString blobPath(int slot) const;
+    QString metaPath(int slot) const;
+    // Reads the meta file: false if missing or not of `size`
+    bool readMeta(int slot, uint32_t size, QByteArray& firstChunkHash) const;
+    static QByteArray firstChunkHash(const QByteArray& packed, uint32_t size);
+};
+
+#endif // PEDAL_MIRROR_H
@@ -0,0 +1,352 @@
+#include "playback.h"
+#include "pedal_mirror.h"
+#include "trace_events.h"
+#include "metrics.h"
+#include <QSettings>
+#include <portaudio.h>
+#if defined(_WIN32) && __has_include(<pa_win_wasapi.h>)
+#include <pa_win_wasapi.h>
+#define MOOER_HAVE_WASAPI 1
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+const double SAMPLE_RATE = 44100.0;
+// Clock corrections below this are smoothed; larger ones (stalls, underruns) are taken at once
+const int64_t CLOCK_SNAP_US = 50000;
+
+std::mutex initMutex;
+bool initialized = false;
+
+std::mutex reportMutex;
+AudioStreamReport report;  // Guarded by reportMutex
+
+// PortAudio must not enumerate or probe devices while another thread is using a stream
+std::mutex streamMutex;
+int openStreams = 0;  // Guarded by streamMutex
+
+void closeStream(PaStream* stream) {
+    std::lock_guard<std::mutex> lock(streamMutex);
+    Pa_CloseStream(stream);
+    openStreams--;
+}
+
+void updateReport(const AudioStreamReport& r) {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    report = r;
+}
+
+void countUnderflow() {
+    static Metrics::Counter& underflows = Metrics::counter("mooer_audio_underflows_total");
+    underflows.add();
+    std::lock_guard<std::mutex> lock(reportMutex);
+    report.underflows++;
+}
+
+void setPlaying(bool playing) {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    report.playing = playing;
+}
+
+std::string hostApiName(PaHostApiIndex api) {
+    const PaHostApiInfo* info = Pa_GetHostApiInfo(api);
+    return info && info->name ? info->name : std::string();
+}
+
+bool canBeExclusive(PaHostApiIndex api) {
+#ifdef MOOER_HAVE_WASAPI
+    const PaHostApiInfo* info = Pa_GetHostApiInfo(api);
+    return info && info->type == paWASAPI;
+#else
+    (void)api;
+    return false;
+#endif
+}
+
+// The configured device, else the chosen host API's default, else the system default
+PaDeviceIndex findOutputDevice(const AudioOutputSettings& settings) {
+    if (!settings.device.empty()) {
+        for (PaDeviceIndex i = 0; i < Pa_GetDeviceCount(); i++) {
+            const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+            if (!info || info->maxOutputChannels < 2 || settings.device != info->name) continue;
+            if (settings.hostApi.empty() || settings.hostApi == hostApiName(info->hostApi)) return i;
+        }
+        std::cerr << "Audio output \"" << settings.device << "\" not found, using the default" << std::endl;
+    }
+    if (!settings.hostApi.empty()) {
+        for (PaHostApiIndex a = 0; a < Pa_GetHostApiCount(); a++) {
+            const PaHostApiInfo* info = Pa_GetHostApiInfo(a);
+            if (info && settings.hostApi == info->name && info->defaultOutputDevice != paNoDevice) {
+                return info->defaultOutputDevice;
+            }
+        }
+    }
+    return Pa_GetDefaultOutputDevice();
+}
+
+int64_t steadyUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+void PlaybackClock::publish(double seconds, double limitSeconds) {
+    int64_t now = steadyUs();
+    int64_t measured = now - static_cast<int64_t>(seconds * 1e6);
+    int64_t origin = originUs.load(std::memory_order_relaxed);
+    // The write-available count moves in host-buffer steps; averaging keeps the transport from
+    // jittering by a buffer while still following the device clock
+    if (origin != INT64_MIN && std::llabs(measured - origin) < CLOCK_SNAP_US) {
+        measured = origin + (measured - origin) / 8;
+    }
+    limitUs.store(static_cast<int64_t>(limitSeconds * 1e6), std::memory_order_relaxed);
+    originUs.store(measured, std::memory_order_release);
+}
+
+double PlaybackClock::position() const {
+    int64_t origin = originUs.load(std::memory_order_acquire);
+    if (origin == INT64_MIN) return 0.0;
+    int64_t us = std::min(steadyUs() - origin, limitUs.load(std::memory_order_relaxed));
+    return std::max<int64_t>(us, 0) / 1e6;
+}
+
+void Playback::initialize() {
+    std::lock_guard<std::mutex> lock(initMutex);
+    if (initialized) return;
+    MOOER_TRACE_SCOPE("audio", "Pa_Initialize");
+    PaError err = Pa_Initialize();
+    if (err != paNoError) throw std::runtime_error(std::string("PortAudio: ") + Pa_GetErrorText(err));
+    initialized = true;
+}
+
+void Playback::terminate() {
+    std::lock_guard<std::mutex> lock(initMutex);
+    if (!initialized) return;
+    Pa_Terminate();
+    initialized = false;
+}
+
+AudioOutputSettings AudioOutputSettings::load() {
+    AudioOutputSettings settings;
+    QSettings store;
+    store.beginGroup("audioOutput");
+    settings.hostApi = store.value("hostApi").toString().toStdString();
+    settings.device = store.value("device").toString().toStdString();
+    settings.framesPerBuffer = store.value("framesPerBuffer", settings.framesPerBuffer).toInt();
+    settings.latencyMs = store.value("latencyMs", settings.latencyMs).toDouble();
+    settings.exclusive = store.value("exclusive", settings.exclusive).toBool();
+    return settings;
+}
+
+void AudioOutputSettings::save(const AudioOutputSettings& settings) {
+    QSettings store;
+    store.beginGroup("audioOutput");
+    store.setValue("hostApi", QString::fromStdString(settings.hostApi));
+    store.setValue("device", QString::fromStdString(settings.device));
+    store.setValue("framesPerBuffer", settings.framesPerBuffer);
+    store.setValue("latencyMs", settings.latencyMs);
+    store.setValue("exclusive", settings.exclusive);
+}
+
+std::vector<AudioOutputDevice> Playback::outputDevices() {
+    std::lock_guard<std::mutex> lock(streamMutex);
+    if (openStreams > 0) throw std::runtime_error("Stop playback to list audio devices");
+    initialize();
+    std::vector<AudioOutputDevice> devices;
+    PaDeviceIndex defaultDevice = Pa_GetDefaultOutputDevice();
+    for (PaDeviceIndex i = 0; i < Pa_GetDeviceCount(); i++) {
+        const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+        if (!info || info->maxOutputChannels < 2) continue;
+        AudioOutputDevice d;
+        d.hostApi = hostApiName(info->hostApi);
+        d.name = info->name;
+        d.isDefault = i == defaultDevice;
+        d.defaultSampleRate = info->defaultSampleRate;
+        d.lowLatencyMs = info->defaultLowOutputLatency * 1000.0;
+        d.highLatencyMs = info->defaultHighOutputLatency * 1000.0;
+        PaStreamParameters params = {i, 2, paInt32, info->defaultLowOutputLatency, nullptr};
+        d.supportsTrackRate = Pa_IsFormatSupported(nullptr, &params, SAMPLE_RATE) == paFormatIsSupported;
+        d.supportsExclusive = canBeExclusive(info->hostApi);
+        devices.push_back(d);
+    }
+    return devices;
+}
+
+AudioStreamReport Playback::lastStream() {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    return report;
+}
+
+void Playback::play(USBDevice& device, int slot, uint32_t trackSize, double trackDuration, double startOffset,
+                    const std::atomic<bool>& stopFlag, const std::atomic<int>* volume,
+                    USBDevice::ProgressCallback progress, void* userData, PlaybackClock* clock) {
+    initialize();
+    AudioOutputSettings settings = AudioOutputSettings::load();
+    std::unique_lock<std::mutex> streamLock(streamMutex);
+    PaDeviceIndex deviceIndex = findOutputDevice(settings);
+    const PaDeviceInfo* deviceInfo = deviceIndex != paNoDevice ? Pa_GetDeviceInfo(deviceIndex) : nullptr;
+    if (!deviceInfo) throw std::runtime_error("No audio output device");
+
+    PaStreamParameters params;
+    params.device = deviceIndex;
+    params.channelCount = 2;          /* stereo output */
+    params.sampleFormat = paInt32;    /* 32 bit output */
+    params.suggestedLatency = settings.latencyMs > 0 ? settings.latencyMs / 1000.0 : deviceInfo->defaultLowOutputLatency;
+    params.hostApiSpecificStreamInfo = nullptr;
+    bool exclusive = false;
+#ifdef MOOER_HAVE_WASAPI
+    PaWasapiStreamInfo wasapi = {};
+    if (settings.exclusive && canBeExclusive(deviceInfo->hostApi)) {
+        // Bypasses the shared-mode mixer and its resampler
+        wasapi.size = sizeof(wasapi);
+        wasapi.hostApiType = paWASAPI;
+        wasapi.version = 1;
+        wasapi.flags = paWinWasapiExclusive;
+        params.hostApiSpecificStreamInfo = &wasapi;
+        exclusive = true;
+    }
+#endif
+
+    PaStream *stream;
+    unsigned long framesPerBuffer = settings.framesPerBuffer > 0 ? settings.framesPerBuffer : paFramesPerBufferUnspecified;
+    PaError err = Pa_OpenStream( &stream, nullptr, &params, SAMPLE_RATE, framesPerBuffer, paNoFlag, nullptr, nullptr );
+
+    if (err != paNoError) {
+        throw std::runtime_error(std::string("PortAudio OpenStream error on \"") + deviceInfo->name + "\": " +
+                                 Pa_GetErrorText(err));
+    }
+    openStreams++;
+    streamLock.unlock();
+
+    err = Pa_StartStream( stream );
+    if (err != paNoError) {
+        closeStream( stream );
+        throw std::runtime_error(std::string("PortAudio StartStream error: ") + Pa_GetErrorText(err));
+    }
+
+    // What the stream can hold before a write blocks; the part of it not yet free is queued
+    // audio the device has not played
+    long capacity = Pa_GetStreamWriteAvailable(stream);
+    const PaStreamInfo* info = Pa_GetStreamInfo(stream);
+    double outputLatency = info ? info->outputLatency : 0.0;
+
+    AudioStreamReport opened;
+    opened.valid = true;
+    opened.hostApi = hostApiName(deviceInfo->hostApi);
+    opened.device = deviceInfo->name;
+    opened.sampleRate = info ? info->sampleRate : SAMPLE_RATE;
+    opened.outputLatencyMs = outputLatency * 1000.0;
+    opened.framesPerBuffer = settings.framesPerBuffer;
+    opened.exclusive = exclusive;
+    opened.playing = true;
+    updateReport(opened);
+    Metrics::gauge("mooer_audio_output_latency_us").set(static_cast<int64_t>(outputLatency * 1e6));
+
+    double startSeconds = 0.0;
+    int64_t framesWritten = 0;
+    auto publishPosition = [&]() {
+        if (!clock) return;
+        long available = Pa_GetStreamWriteAvailable(stream);
+        long queued = capacity > 0 && available >= 0 ? std::max(0L, capacity - available) : 0;
+        double rendered = (framesWritten - queued) / SAMPLE_RATE;
+        double audible = std::max(0.0, rendered - outputLatency);
+        clock->publish(startSeconds + audible, startSeconds + framesWritten / SAMPLE_RATE);
+    };
+
+    auto callback = [&](const std::vector<int32_t>& samples) {
+        if (stopFlag) return;
+        if (samples.empty()) return;
+        // Blocks while PortAudio's buffer is full, so this is where playback waits on the device
+        MOOER_TRACE_SCOPE("audio", "Pa_WriteStream", samples.size() / 2);
+        int vol = volume ? volume->load() : 100;
+        PaError written;
+        if (vol == 100) {
+            written = Pa_WriteStream( stream, samples.data(), samples.size() / 2 );
+        } else {
+            std::vector<int32_t> scaled(samples.size());
+            double scale = vol / 100.0;
+            for (size_t i = 0; i < samples.size(); i++) {
+                double s = static_cast<double>(samples[i]) * scale;
+                if (s > INT32_MAX) s = INT32_MAX;
+                if (s < INT32_MIN) s = INT32_MIN;
+                scaled[i] = static_cast<int32_t>(s);
+            }
+            written = Pa_WriteStream( stream, scaled.data(), scaled.size() / 2 );
+        }
+        // The device ran dry before this write: an audible gap
+        if (written == paOutputUnderflowed) countUnderflow();
+        framesWritten += samples.size() / 2;
+        publishPosition();
+    };
+
+    // Calculate start chunk
+    // trackDuration is in seconds
+    // Total bytes = trackDuration * 44100 * 6
+    // Total chunks = Total bytes / 1024
+    // startChunk = (startOffset / trackDuration) * Total chunks
+    int startChunk = 1;
+    if (trackDuration > 0 && startOffset > 0) {
+        // More precise:
+        // bytesOffset = startOffset * 44100 * 6
+        // chunkOffset = bytesOffset / 1024
+        double bytesOffset = startOffset * 44100.0 * 6.0;
+        startChunk = static_cast<int>(bytesOffset / 1024.0) + 1;
+    }
+    // Playback starts on the chunk boundary, slightly before startOffset
+    startSeconds = (startChunk - 1) * 1024.0 / (6.0 * SAMPLE_RATE);
+
+    try {
+        PedalMirror mirror(device.getSerial());
+        MappedFile local = mirror.open(slot, trackSize, [&]() { return device.readFirstChunk(slot); });
+        if (local.isValid()) {
+            // Known-current mirror: play from memory without touching USB
+            int chunks = (local.size + 1023) / 1024;
+            PackedStreamDecoder decoder(startChunk);
+            for (int i = startChunk; i <= chunks && !stopFlag; i++) {
+                qint64 offset = (qint64)(i - 1) * 1024;
+                QByteArray chunk = QByteArray::fromRawData(reinterpret_cast<const char*>(local.data) + offset,
+                                                           std::min<qint64>(1024, local.size - offset));
+                callback(decoder.feed(chunk));
+                if (progress) progress(i, chunks, userData);
+            }
+        } else {
+            // Stream from the pedal; a complete pass from the start refreshes the mirror
+            bool capture = mirror.isEnabled() && startChunk == 1;
+            QByteArray captured;
+            PackedStreamDecoder decoder(startChunk);
+            int lastChunk = 0, totalChunks = 0;
+            uint32_t streamedSize = 0;
+
+            device.readTrackChunks(slot, [&](int i, int chunks, const QByteArray& data) {
+                if (capture) captured.append(data);
+                callback(decoder.feed(data));
+                if (progress) progress(i, chunks, userData);
+                lastChunk = i;
+                totalChunks = chunks;
+                return true;
+            }, startChunk, &stopFlag, &streamedSize);
+
+            if (capture && !stopFlag && totalChunks > 0 && lastChunk == totalChunks &&
+                (uint32_t)captured.size() >= streamedSize) {
+                captured.truncate(streamedSize);
+                mirror.store(slot, captured);
+            }
+        }
+    } catch (...) {
+        Pa_StopStream( stream );
+        closeStream( stream );
+        setPlaying(false);
+        throw;
+    }
+
+    Pa_StopStream( stream );
+    closeStream( stream );
+    setPlaying(false);
+}
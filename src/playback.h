@@ -0,0 +1,91 @@
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "usb_device.h"
+
+// PortAudio output picked in the Audio Output dialog, shared with mooer-cli through QSettings.
+// Empty names mean the system's default output.
+struct AudioOutputSettings {
+    std::string hostApi;        // e.g. "ALSA", "JACK Audio Connection Kit", "Windows WASAPI"
+    std::string device;
+    int framesPerBuffer = 256;  // 0 lets the host API choose
+    double latencyMs = 0.0;     // Suggested output latency; 0 uses the device's low-latency default
+    bool exclusive = false;     // WASAPI exclusive mode; ignored by other host APIs
+
+    static AudioOutputSettings load();
+    static void save(const AudioOutputSettings& settings);
+};
+
+// An output device as PortAudio reports it
+struct AudioOutputDevice {
+    std::string hostApi;
+    std::string name;
+    bool isDefault = false;
+    double defaultSampleRate = 0.0;
+    double lowLatencyMs = 0.0;
+    double highLatencyMs = 0.0;
+    bool supportsTrackRate = false;  // Opens at 44.1 kHz without the host resampling
+    bool supportsExclusive = false;
+};
+
+// What the most recent stream negotiated, and how it is doing
+struct AudioStreamReport {
+    bool valid = false;
+    std::string hostApi;
+    std::string device;
+    double sampleRate = 0.0;
+    double outputLatencyMs = 0.0;  // As reported by the opened stream
+    int framesPerBuffer = 0;       // Requested; 0 = chosen by the host API
+    bool exclusive = false;
+    bool playing = false;
+    uint64_t underflows = 0;       // Writes that found the output buffer had run dry
+};
+
+// Audible position of a running Playback::play(), taken from the output stream: frames the
+// device has consumed minus its output latency. The audio thread publishes after every write;
+// readers on any thread extrapolate from it with the steady clock, so the position advances
+// smoothly between writes and is read without locks or signals.
+class PlaybackClock {
+public:
+    // Audio thread: `seconds` is audible now; the position never runs past `limitSeconds`
+    // (everything written so far), which holds it still while the stream starves
+    void publish(double seconds, double limitSeconds);
+    bool isValid() const { return originUs.load(std::memory_order_acquire) != INT64_MIN; }
+    // Seconds into the track; only meaningful when isValid()
+    double position() const;
+
+private:
+    // Steady-clock time at which the track's first frame was (or would have been) heard
+    std::atomic<int64_t> originUs{INT64_MIN};
+    std::atomic<int64_t> limitUs{0};
+};
+
+// Plays a slot on the configured PortAudio output (AudioOutputSettings). Uses the local mirror
+// when it is current and otherwise streams from the pedal, refreshing the mirror after a
+// complete pass. Throws std::runtime_error on audio errors.
+class Playback {
+public:
+    // Pa_Initialize() probes every host API (ALSA, JACK, OSS...), so it is deferred to the first
+    // play() and runs on the calling (worker) thread. Safe to call from any thread; throws on failure.
+    static void initialize();
+    // Pa_Terminate() if initialize() ever succeeded; no stream may be open
+    static void terminate();
+
+    // Stereo outputs of every host API; initializes PortAudio. Throws while a stream is open,
+    // since PortAudio can't enumerate devices while another thread uses one.
+    static std::vector<AudioOutputDevice> outputDevices();
+    static AudioStreamReport lastStream();
+
+    // `progress` reports (chunk, totalChunks); `clock`, if given, follows the audible position
+    static void play(USBDevice& device, int slot, uint32_t trackSize, double trackDuration, double startOffset,
+                     const std::atomic<bool>& stopFlag, const std::atomic<int>* volume,
+                     USBDevice::ProgressCallback progress = nullptr, void* userData = nullptr,
+                     PlaybackClock* clock = nullptr);
+};
+
+#endif // PLAYBACK_H
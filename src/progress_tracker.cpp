@@ -0,0 +1,39 @@
+#include "progress_tracker.h"
+
+void ThroughputMeter::start() {
+    started = Clock::now();
+    lastBytes = 0;
+    window.clear();
+    window.emplace_back(started, 0);
+}
+
+void ThroughputMeter::sample(uint64_t bytes) {
+    Clock::time_point now = Clock::now();
+    lastBytes = bytes;
+    window.emplace_back(now, bytes);
+    // Keep one sample older than the window so the rate always spans it
+    while (window.size() > 2 && std::chrono::duration<double>(now - window[1].first).count() > WINDOW_SECONDS) {
+        window.pop_front();
+    }
+}
+
+double ThroughputMeter::currentRate() const {
+    if (window.size() < 2) return 0.0;
+    double seconds = std::chrono::duration<double>(window.back().first - window.front().first).count();
+    if (seconds <= 0.0 || window.back().second < window.front().second) return 0.0;
+    return (window.back().second - window.front().second) / seconds;
+}
+
+double ThroughputMeter::averageRate() const {
+    double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    return seconds > 0.0 ? lastBytes / seconds : 0.0;
+}
+
+double ThroughputMeter::eta(uint64_t total) const {
+    if (total == 0 || lastBytes == 0) return -1.0;
+    if (lastBytes >= total) return 0.0;
+    double current = currentRate();
+    double average = averageRate();
+    double rate = current > 0.0 ? 0.5 * (current + average) : average;
+    return rate > 0.0 ? (total - lastBytes) / rate : -1.0;
+}
@@ -0,0 +1,69 @@
+#ifndef PROGRESS_TRACKER_H
+#define PROGRESS_TRACKER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+// Progress of one operation, written by its I/O thread and read by whoever displays it.
+// Updates are plain 64-bit atomic stores, so reporting on every chunk costs nothing; the
+// UI takes a snapshot when it redraws instead of receiving one event per update.
+class ProgressTracker {
+public:
+    struct Snapshot {
+        uint64_t current = 0;
+        uint64_t total = 0;
+        uint64_t updates = 0;  // Changes whenever the writer reports
+    };
+
+    void update(uint64_t current, uint64_t total) {
+        totalValue.store(total, std::memory_order_relaxed);
+        currentValue.store(current, std::memory_order_relaxed);
+        updateCount.fetch_add(1, std::memory_order_release);
+    }
+
+    Snapshot snapshot() const {
+        Snapshot s;
+        s.updates = updateCount.load(std::memory_order_acquire);
+        s.current = currentValue.load(std::memory_order_relaxed);
+        s.total = totalValue.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // USBDevice::ProgressCallback adaptor; userData is the tracker
+    static void callback(size_t current, size_t total, void* userData) {
+        static_cast<ProgressTracker*>(userData)->update(current, total);
+    }
+
+private:
+    std::atomic<uint64_t> currentValue{0};
+    std::atomic<uint64_t> totalValue{0};
+    std::atomic<uint64_t> updateCount{0};
+};
+
+// Turns byte counts sampled at display rate into a current rate (over the last couple of
+// seconds), an average rate since start() and a time-remaining estimate
+class ThroughputMeter {
+public:
+    void start();
+    void sample(uint64_t bytes);
+
+    double currentRate() const;  // Bytes per second
+    double averageRate() const;
+    // Seconds until `total` at the current rate, blended with the average so it does not
+    // jump around; negative while unknown
+    double eta(uint64_t total) const;
+    uint64_t bytes() const { return lastBytes; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    static constexpr double WINDOW_SECONDS = 2.0;
+
+    Clock::time_point started;
+    uint64_t lastBytes = 0;
+    std::deque<std::pair<Clock::time_point, uint64_t>> window;
+};
+
+#endif // PROGRESS_TRACKER_H
@@ -1,6 +1,8 @@
 #include "protocol.h"
+#include "trace_events.h"
 #include <QDataStream>
 #include <QtEndian>
+#include <algorithm>
 
 const uint16_t Protocol::CRC_TABLE[256] = {
     0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
@@ -180,6 +182,7 @@ bool Protocol::parseTrackInfoHeader(const QByteArray& data, uint32_t& size) {
 }
 
 std::vector<int32_t> Protocol::parseAudioData(const QByteArray& data, bool skipHeader) {
+    MOOER_TRACE_SCOPE("audio", "parseAudioData", data.size());
     int offset = skipHeader ? 18 : 0;
     if (offset >= data.size()) return {};
 
@@ -207,6 +210,7 @@ std::vector<int32_t> Protocol::parseAudioData(const QByteArray& data, bool skipH
 }
 
 QByteArray Protocol::encodeAudioData(const std::vector<int32_t>& samples, bool stereo) {
+    MOOER_TRACE_SCOPE("audio", "encodeAudioData", samples.size());
     // Input is assumed to be interleaved int32 (scaled)
     // If not stereo (mono), caller must handle duplication before calling this or we do it here.
     // The Python implementation handles mono-to-stereo conversion.
@@ -226,3 +230,30 @@ QByteArray Protocol::encodeAudioData(const std::vector<int32_t>& samples, bool s
     }
     return output;
 }
+
+PackedStreamDecoder::PackedStreamDecoder(int startChunk) : skip(0) {
+    // Global offset = (chunkIndex - 1) * 1024; skip ahead to the next 6-byte boundary
+    long long globalOffset = (long long)(std::max(startChunk, 1) - 1) * 1024;
+    int alignment = globalOffset % 6;
+    if (alignment != 0) {
+        skip = 6 - alignment;
+    }
+}
+
+std::vector<int32_t> PackedStreamDecoder::feed(const QByteArray& chunk) {
+    MOOER_TRACE_SCOPE("audio", "decodeChunk");
+    remainder.append(chunk);
+
+    if (skip > 0) {
+        int toDiscard = std::min<int>(skip, remainder.size());
+        remainder.remove(0, toDiscard);
+        skip -= toDiscard;
+    }
+
+    int bytesToProcess = (remainder.size() / 6) * 6;
+    if (bytesToProcess == 0) return {};
+
+    std::vector<int32_t> samples = Protocol::parseAudioData(remainder.left(bytesToProcess), false);
+    remainder.remove(0, bytesToProcess);
+    return samples;
+}
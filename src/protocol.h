@@ -36,9 +36,23 @@ public:
     static QByteArray encodeAudioData(const std::vector<int32_t>& samples, bool stereo = true);
     static std::vector<int32_t> parseAudioData(const QByteArray& data, bool skipHeader = true);
 
-private:
+    // CRC over command bytes 3 .. 3 + length + 1; the result is stored big endian after them
     static uint16_t calculateCRC16(const QByteArray& data);
+
+private:
     static const uint16_t CRC_TABLE[256];
 };
 
+// Turns consecutive raw 1 KB chunks, starting at chunk `startChunk`, into whole stereo frames.
+// Chunks are not frame aligned (1024 % 6 != 0), so a partial frame is carried between calls.
+class PackedStreamDecoder {
+public:
+    explicit PackedStreamDecoder(int startChunk = 1);
+    std::vector<int32_t> feed(const QByteArray& chunk);
+
+private:
+    QByteArray remainder;
+    int skip; // Bytes still to drop to reach the first frame boundary
+};
+
 #endif // PROTOCOL_H
@@ -0,0 +1,117 @@
+#include "slot_planner.h"
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+std::vector<int> identity(int slotCount) {
+    std::vector<int> source(std::max(slotCount, 0));
+    std::iota(source.begin(), source.end(), 0);
+    return source;
+}
+}
+
+std::vector<int> SlotPlanner::moveRange(int slotCount, int first, int count, int to) {
+    if (count <= 0 || first < 0 || to < 0 || first + count > slotCount || to + count > slotCount) {
+        throw std::runtime_error("Slot range out of bounds");
+    }
+
+    // Take the block out, then put it back in at `to`
+    std::vector<int> order = identity(slotCount);
+    std::vector<int> block(order.begin() + first, order.begin() + first + count);
+    order.erase(order.begin() + first, order.begin() + first + count);
+    order.insert(order.begin() + to, block.begin(), block.end());
+    return order;
+}
+
+std::vector<int> SlotPlanner::swapRanges(int slotCount, int a, int b, int count) {
+    if (count <= 0 || a < 0 || b < 0 || a + count > slotCount || b + count > slotCount) {
+        throw std::runtime_error("Slot range out of bounds");
+    }
+    if (a != b && std::abs(a - b) < count) {
+        throw std::runtime_error("Swapped ranges overlap");
+    }
+
+    std::vector<int> source = identity(slotCount);
+    for (int i = 0; i < count; i++) {
+        std::swap(source[a + i], source[b + i]);
+    }
+    return source;
+}
+
+std::vector<int> SlotPlanner::insertGap(const std::vector<bool>& occupied, int at) {
+    int slotCount = occupied.size();
+    if (at < 0 || at >= slotCount) {
+        throw std::runtime_error("Slot out of bounds");
+    }
+    for (int empty = at; empty < slotCount; empty++) {
+        if (!occupied[empty]) {
+            return moveRange(slotCount, empty, 1, at);
+        }
+    }
+    return std::vector<int>();
+}
+
+bool SlotPlanner::isPermutation(const std::vector<int>& source) {
+    std::vector<bool> seen(source.size(), false);
+    for (int s : source) {
+        if (s < 0 || s >= (int)source.size() || seen[s]) return false;
+        seen[s] = true;
+    }
+    return true;
+}
+
+std::vector<SlotPlanner::Step> SlotPlanner::plan(const std::vector<int>& source, const std::vector<bool>& occupied) {
+    if (!isPermutation(source) || occupied.size() != source.size()) {
+        throw std::runtime_error("Invalid slot arrangement");
+    }
+
+    int n = source.size();
+    std::vector<Step> steps;
+    std::vector<bool> visited(n, false);
+
+    for (int start = 0; start < n; start++) {
+        if (visited[start]) continue;
+
+        // Collect the cycle start <- source[start] <- source[source[start]] ...
+        std::vector<int> cycle;
+        for (int d = start; !visited[d]; d = source[d]) {
+            visited[d] = true;
+            cycle.push_back(d);
+        }
+        if (cycle.size() < 2) continue;
+
+        int occupiedCount = std::count_if(cycle.begin(), cycle.end(), [&](int d) { return occupied[d]; });
+        if (occupiedCount == 0) continue;
+
+        // Rotate so the cycle starts at an empty slot when there is one: its content needs no stash
+        auto firstEmpty = std::find_if(cycle.begin(), cycle.end(), [&](int d) { return !occupied[d]; });
+        if (firstEmpty != cycle.end()) {
+            std::rotate(cycle.begin(), firstEmpty, cycle.end());
+        }
+
+        // cycle[0]'s old content ends up in cycle.back(); save it before cycle[0] is overwritten
+        int head = cycle.front();
+        if (occupied[head]) {
+            steps.push_back({Step::Stash, head, -1});
+        }
+        for (size_t i = 0; i + 1 < cycle.size(); i++) {
+            int to = cycle[i];
+            int from = cycle[i + 1];
+            if (occupied[from]) {
+                steps.push_back({Step::Copy, from, to});
+            } else if (occupied[to]) {
+                // Its old track was already read (or stashed) and it should end up empty
+                steps.push_back({Step::Clear, -1, to});
+            }
+        }
+        int last = cycle.back();
+        if (occupied[head]) {
+            steps.push_back({Step::Unstash, -1, last});
+        } else if (occupied[last]) {
+            steps.push_back({Step::Clear, -1, last});
+        }
+    }
+    return steps;
+}
@@ -0,0 +1,41 @@
+#ifndef SLOT_PLANNER_H
+#define SLOT_PLANNER_H
+
+#include <vector>
+
+// Plans slot rearrangements on a single pedal. The pedal has no move command and cannot
+// read and write at the same time, so every moved track is downloaded into host memory
+// and uploaded to its new slot.
+//
+// A rearrangement is a permutation: source[d] is the slot whose current track ends up in d.
+// Each cycle of the permutation is walked once, so every moved track crosses USB exactly
+// once in each direction and at most two tracks are held in RAM at a time. Cycles that pass
+// through an empty slot are started there, which needs only one buffered track.
+class SlotPlanner {
+public:
+    struct Step {
+        enum Kind {
+            Stash,   // Read `from` into the spare buffer
+            Copy,    // Read `from` and write it to `to`
+            Unstash, // Write the spare buffer to `to`
+            Clear    // Delete `to`
+        };
+        Kind kind;
+        int from;
+        int to;
+    };
+
+    // Track block [first, first + count) moves to start at `to`; the slots in between shift to close the gap
+    static std::vector<int> moveRange(int slotCount, int first, int count, int to);
+    // Exchanges the blocks [a, a + count) and [b, b + count); they must not overlap
+    static std::vector<int> swapRanges(int slotCount, int a, int b, int count);
+    // Opens an empty slot at `at` by shifting tracks up into the first empty slot after it.
+    // Returns an empty vector if there is no free slot to shift into.
+    static std::vector<int> insertGap(const std::vector<bool>& occupied, int at);
+
+    static bool isPermutation(const std::vector<int>& source);
+    // Steps that realise `source` given which slots currently hold a track
+    static std::vector<Step> plan(const std::vector<int>& source, const std::vector<bool>& occupied);
+};
+
+#endif // SLOT_PLANNER_H
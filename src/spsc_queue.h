@@ -0,0 +1,34 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-size lock-free ring for exactly one producer thread and one consumer thread.
+// Neither side ever blocks: push() fails when full, pop() when empty.
+template <typename T, size_t Capacity>
+class SpscQueue {
+public:
+    bool push(const T& value) {
+        size_t tail = tailCount.load(std::memory_order_relaxed);
+        if (tail - headCount.load(std::memory_order_acquire) == Capacity) return false;
+        slots[tail % Capacity] = value;
+        tailCount.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t head = headCount.load(std::memory_order_relaxed);
+        if (head == tailCount.load(std::memory_order_acquire)) return false;
+        value = slots[head % Capacity];
+        headCount.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T slots[Capacity];
+    std::atomic<size_t> headCount{0};  // Items popped
+    std::atomic<size_t> tailCount{0};  // Items pushed
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,40 @@
+#include "startup_profile.h"
+#include "trace_events.h"
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+Clock::time_point started;
+std::vector<std::pair<const char*, Clock::time_point>> phases;  // GUI thread only
+bool reported = false;
+}
+
+bool StartupProfile::enabled = false;
+
+void StartupProfile::enable() {
+    enabled = true;
+    started = Clock::now();
+}
+
+void StartupProfile::mark(const char* phase) {
+    TraceEvents::instant("startup", phase);
+    if (!enabled || reported) return;
+    phases.emplace_back(phase, Clock::now());
+}
+
+void StartupProfile::report() {
+    if (!enabled || reported) return;
+    reported = true;
+
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    std::fprintf(stderr, "Startup profile (ms since main):\n");
+    Clock::time_point previous = started;
+    for (const auto& phase : phases) {
+        std::fprintf(stderr, "  %-24s %8.1f  (+%.1f)\n", phase.first, ms(phase.second - started),
+                     ms(phase.second - previous));
+        previous = phase.second;
+    }
+}
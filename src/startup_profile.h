@@ -0,0 +1,20 @@
+#ifndef STARTUP_PROFILE_H
+#define STARTUP_PROFILE_H
+
+#include <chrono>
+
+// Phase-by-phase timing of GUI start-up, enabled by --profile-startup. Each mark() records
+// the time since enable(); report() prints the breakdown to stderr once.
+class StartupProfile {
+public:
+    static void enable();
+    static bool isEnabled() { return enabled; }
+    // `phase` must be a string literal. Also an instant event when tracing is on.
+    static void mark(const char* phase);
+    static void report();
+
+private:
+    static bool enabled;
+};
+
+#endif // STARTUP_PROFILE_H
@@ -0,0 +1,321 @@
+#include "stream_server.h"
+#include "audio_utils.h"
+#include "pedal_mirror.h"
+#include <QRegularExpression>
+#include <QUrl>
+#include <QUrlQuery>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+const qint64 WAV_HEADER_SIZE = 44;
+const qint64 MAX_REQUEST = 8192;
+const qint64 MAX_PIECE = 64 * 1024;
+}
+
+StreamServer::StreamServer(Runner runner, QObject* parent) : QObject(parent), runner(runner) {
+    connect(&server, &QTcpServer::newConnection, this, &StreamServer::onNewConnection);
+}
+
+StreamServer::~StreamServer() {
+    for (auto& fetch : fetches) fetch->stop = true;
+}
+
+bool StreamServer::listen(quint16 port) {
+    // Loopback only: the endpoint has no authentication
+    if (!server.listen(QHostAddress::LocalHost, port)) {
+        std::cerr << "Cannot listen on port " << port << ": " << server.errorString().toStdString() << std::endl;
+        return false;
+    }
+    std::cerr << "Streaming slots on http://127.0.0.1:" << server.serverPort() << "/slot/<n>.wav" << std::endl;
+    return true;
+}
+
+void StreamServer::onNewConnection() {
+    while (QTcpSocket* socket = server.nextPendingConnection()) {
+        listeners[socket] = Listener();
+        connect(socket, &QTcpSocket::readyRead, this, &StreamServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &StreamServer::onDisconnected);
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]() {
+            if (listeners.count(socket)) pump(socket);
+        });
+    }
+}
+
+void StreamServer::onDisconnected() {
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+    auto it = listeners.find(socket);
+    if (it != listeners.end()) {
+        std::shared_ptr<Fetch> fetch = it->second.fetch;
+        listeners.erase(it);
+        if (fetch) release(fetch);
+    }
+    socket->deleteLater();
+}
+
+void StreamServer::onReadyRead() {
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    auto it = listeners.find(socket);
+    if (it == listeners.end()) return;
+
+    Listener& listener = it->second;
+    if (listener.parsed) {
+        socket->readAll();  // Nothing after the request is used
+        return;
+    }
+    listener.request.append(socket->readAll());
+    if (listener.request.contains("\r\n\r\n")) {
+        listener.parsed = true;
+        startListener(socket, listener);
+    } else if (listener.request.size() > MAX_REQUEST) {
+        listener.parsed = true;
+        reply(socket, "400 Bad Request");
+    }
+}
+
+void StreamServer::startListener(QTcpSocket* socket, Listener& listener) {
+    QList<QByteArray> lines = listener.request.split('\n');
+    QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+    if (requestLine.size() < 2 || requestLine[0] != "GET") {
+        reply(socket, "405 Method Not Allowed");
+        return;
+    }
+
+    QUrl url("http://localhost" + QString::fromLatin1(requestLine[1]));
+    static const QRegularExpression pathPattern("^/slot/(\\d+)\\.(wav|pcm)$");
+    QRegularExpressionMatch match = pathPattern.match(url.path());
+    int slot = match.hasMatch() ? match.captured(1).toInt() : -1;
+    if (slot < 0 || slot >= Protocol::MAX_TRACKS) {
+        reply(socket, "404 Not Found", "Use /slot/<n>.wav or /slot/<n>.pcm\n");
+        return;
+    }
+    listener.wav = match.captured(2) == "wav";
+    QString device = QUrlQuery(url).queryItemValue("device");
+
+    // Range: bytes=a-b, bytes=a- or bytes=-n (first range only)
+    static const QRegularExpression rangePattern("^range:\\s*bytes=(\\d*)-(\\d*)", QRegularExpression::CaseInsensitiveOption);
+    for (const QByteArray& line : lines) {
+        QRegularExpressionMatch range = rangePattern.match(QString::fromLatin1(line.trimmed()));
+        if (!range.hasMatch() || (range.captured(1).isEmpty() && range.captured(2).isEmpty())) continue;
+        listener.ranged = true;
+        if (range.captured(1).isEmpty()) {
+            listener.rangeStart = -range.captured(2).toLongLong();
+            if (listener.rangeStart == 0) {
+                // bytes=-0 asks for the last zero bytes, which RFC 9110 treats as unsatisfiable
+                reply(socket, "416 Range Not Satisfiable");
+                return;
+            }
+        } else {
+            listener.rangeStart = range.captured(1).toLongLong();
+            listener.rangeEnd = range.captured(2).isEmpty() ? -1 : range.captured(2).toLongLong();
+            if (listener.rangeEnd >= 0 && listener.rangeEnd < listener.rangeStart) {
+                // Reversed range: no byte of it can be served, so don't touch the pedal
+                reply(socket, "416 Range Not Satisfiable");
+                return;
+            }
+        }
+    }
+
+    // Suffix ranges need the track size first, so they read from the start
+    int startChunk = 1;
+    if (listener.rangeStart > 0) {
+        qint64 packedOffset = std::max<qint64>(0, listener.rangeStart - (listener.wav ? WAV_HEADER_SIZE : 0));
+        startChunk = static_cast<int>(packedOffset / 1024) + 1;
+    }
+
+    listener.fetch = fetchFor(device, slot, startChunk);
+    if (!listener.fetch) {
+        reply(socket, "404 Not Found", "No such pedal\n");
+        return;
+    }
+    pump(socket);
+}
+
+std::shared_ptr<StreamServer::Fetch> StreamServer::fetchFor(const QString& device, int slot, int startChunk) {
+    // Join a read already covering this position; it keeps everything it has fetched.
+    // A finished read that came up short (the pedal failed mid-track) would truncate the body.
+    for (const auto& fetch : fetches) {
+        std::lock_guard<std::mutex> lock(fetch->mutex);
+        bool cutShort = fetch->done && (qint64)(fetch->startChunk - 1) * 1024 + fetch->data.size() < fetch->trackSize;
+        if (fetch->device == device && fetch->slot == slot && fetch->startChunk <= startChunk && !fetch->missing &&
+            !cutShort) {
+            return fetch;
+        }
+    }
+
+    auto fetch = std::make_shared<Fetch>();
+    fetch->device = device;
+    fetch->slot = slot;
+    fetch->startChunk = startChunk;
+
+    bool queued = runner(device, [this, fetch](USBDevice& usb, const SlotObserver& observer) {
+        uint32_t size = 0;
+        bool exists = false;
+        bool headerRead = false;
+        try {
+            exists = usb.readTrackChunks(fetch->slot, [&](int, int chunks, const QByteArray& data) {
+                {
+                    std::lock_guard<std::mutex> lock(fetch->mutex);
+                    if (!fetch->sizeKnown) {
+                        fetch->trackSize = size;
+                        fetch->sizeKnown = true;
+                        fetch->data.reserve((chunks - fetch->startChunk + 1) * 1024);
+                    }
+                    fetch->data.append(data);
+                }
+                notify(fetch);
+                return true;
+            }, fetch->startChunk, &fetch->stop, &size);
+            headerRead = true;
+        } catch (const std::exception& e) {
+            std::cerr << "Stream of slot " << fetch->slot << " failed: " << e.what() << std::endl;
+            // Chunk reads only start once the header named the size
+            headerRead = size > 0;
+        }
+        if (headerRead && observer) observer(fetch->slot, size);
+
+        QByteArray complete;
+        {
+            std::lock_guard<std::mutex> lock(fetch->mutex);
+            fetch->done = true;
+            if (!fetch->sizeKnown) {
+                fetch->trackSize = size;
+                fetch->sizeKnown = exists;
+                fetch->missing = !exists;
+            }
+            if (fetch->startChunk == 1 && !fetch->stop && (uint32_t)fetch->data.size() >= size) {
+                complete = fetch->data.left(size);
+            }
+        }
+        // A full read from the start is as good as a download
+        if (exists && !complete.isEmpty()) PedalMirror(usb.getSerial()).store(fetch->slot, complete);
+        notify(fetch);
+    });
+    if (!queued) return nullptr;
+
+    fetches.push_back(fetch);
+    return fetch;
+}
+
+void StreamServer::dropSlot(int slot, const std::function<bool(const QString& device)>& onPedal) {
+    // Listeners keep their own reference, so only new requests are affected
+    fetches.erase(std::remove_if(fetches.begin(), fetches.end(), [&](const std::shared_ptr<Fetch>& fetch) {
+        return fetch->slot == slot && onPedal(fetch->device);
+    }), fetches.end());
+}
+
+void StreamServer::notify(const std::shared_ptr<Fetch>& fetch) {
+    if (fetch->notifyPending.exchange(true)) return;
+    QMetaObject::invokeMethod(this, [this, fetch]() {
+        fetch->notifyPending = false;
+        pumpFetch(fetch);
+    }, Qt::QueuedConnection);
+}
+
+void StreamServer::pumpFetch(const std::shared_ptr<Fetch>& fetch) {
+    // pump() may drop listeners, so collect first
+    std::vector<QTcpSocket*> sockets;
+    for (const auto& entry : listeners) {
+        if (entry.second.fetch == fetch) sockets.push_back(entry.first);
+    }
+    for (QTcpSocket* socket : sockets) {
+        if (listeners.count(socket)) pump(socket);
+    }
+}
+
+void StreamServer::release(const std::shared_ptr<Fetch>& fetch) {
+    for (const auto& entry : listeners) {
+        if (entry.second.fetch == fetch) return;
+    }
+    // Last listener gone: stop reading the pedal
+    fetch->stop = true;
+    fetches.erase(std::remove(fetches.begin(), fetches.end(), fetch), fetches.end());
+}
+
+void StreamServer::pump(QTcpSocket* socket) {
+    Listener& listener = listeners[socket];
+    if (!listener.fetch) return;
+    Fetch& fetch = *listener.fetch;
+
+    if (!listener.started) {
+        uint32_t size;
+        {
+            std::lock_guard<std::mutex> lock(fetch.mutex);
+            if (fetch.missing) {
+                reply(socket, "404 Not Found", "Slot is empty\n");
+                return;
+            }
+            if (!fetch.sizeKnown) return;
+            size = fetch.trackSize;
+        }
+
+        listener.dataSize = (size / 6) * 6;
+        qint64 total = listener.dataSize + (listener.wav ? WAV_HEADER_SIZE : 0);
+        qint64 start = listener.rangeStart, end = listener.rangeEnd;
+        if (start < 0) start = std::max<qint64>(0, total + start);
+        if (end < 0 || end >= total) end = total - 1;
+        if (listener.ranged && (start >= total || end < start)) {
+            socket->write("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" + QByteArray::number(total) +
+                          "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            listener.started = true;
+            socket->disconnectFromHost();
+            return;
+        }
+        listener.rangeStart = start;
+        listener.length = end - start + 1;
+
+        QByteArray header = listener.ranged ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+        header += listener.wav ? "Content-Type: audio/wav\r\n"
+                               : "Content-Type: application/octet-stream\r\nX-Audio-Format: s24le; rate=44100; channels=2\r\n";
+        header += "Content-Length: " + QByteArray::number(listener.length) + "\r\n";
+        if (listener.ranged) {
+            header += "Content-Range: bytes " + QByteArray::number(start) + "-" + QByteArray::number(end) +
+                      "/" + QByteArray::number(total) + "\r\n";
+        }
+        header += "Accept-Ranges: bytes\r\nConnection: close\r\n\r\n";
+        socket->write(header);
+        listener.started = true;
+    }
+
+    qint64 headerSize = listener.wav ? WAV_HEADER_SIZE : 0;
+    qint64 base = (qint64)(fetch.startChunk - 1) * 1024;
+    bool starved = false;
+    while (listener.sent < listener.length && socket->bytesToWrite() < MAX_BACKLOG) {
+        qint64 position = listener.rangeStart + listener.sent;
+        qint64 remaining = listener.length - listener.sent;
+        QByteArray piece;
+        if (position < headerSize) {
+            piece = AudioUtils::wav24Header(listener.dataSize).mid(position, std::min(headerSize - position, remaining));
+        } else {
+            qint64 offset = position - headerSize - base;
+            std::lock_guard<std::mutex> lock(fetch.mutex);
+            qint64 available = fetch.data.size() - offset;
+            if (available <= 0) {
+                starved = fetch.done;
+                break;
+            }
+            piece = fetch.data.mid(offset, std::min({available, remaining, MAX_PIECE}));
+        }
+        socket->write(piece);
+        listener.sent += piece.size();
+    }
+
+    if (listener.sent >= listener.length) {
+        socket->disconnectFromHost();  // Flushes the backlog first
+    } else if (starved) {
+        // The pedal read ended early; a short body tells the client it is truncated
+        std::cerr << "Stream of slot " << fetch.slot << " ended early" << std::endl;
+        socket->disconnectFromHost();
+    }
+}
+
+void StreamServer::reply(QTcpSocket* socket, const QByteArray& status, const QByteArray& body) {
+    socket->write("HTTP/1.1 " + status + "\r\nContent-Type: text/plain\r\nContent-Length: " +
+                  QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+    Listener& listener = listeners[socket];
+    listener.started = true;
+    std::shared_ptr<Fetch> fetch = std::move(listener.fetch);
+    if (fetch) release(fetch);
+    socket->disconnectFromHost();
+}
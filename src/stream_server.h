@@ -0,0 +1,95 @@
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "usb_device.h"
+
+// Serves pedal slots over HTTP on localhost, straight from the USB read:
+//   GET /slot/<n>.wav[?device=<serial|bus:addr>]   24-bit stereo WAV
+//   GET /slot/<n>.pcm[?device=...]                 raw s24le stereo 44.1 kHz
+// Byte ranges are mapped to the first 1 KB chunk that covers them. Listeners of the same
+// slot share one fetch, which keeps everything it has read; each listener drains it at
+// its own pace with a bounded socket backlog, so a slow client never holds up the pedal.
+class StreamServer : public QObject {
+    Q_OBJECT
+
+public:
+    // Told the size a read found in a slot's header (0 = empty), on the pedal thread
+    typedef std::function<void(int slot, uint32_t size)> SlotObserver;
+    // Queues `work` on the I/O thread of the pedal matching `device` (empty = first pedal);
+    // returns false if there is no such pedal
+    typedef std::function<bool(const QString& device, std::function<void(USBDevice&, const SlotObserver&)> work)> Runner;
+
+    explicit StreamServer(Runner runner, QObject* parent = nullptr);
+    ~StreamServer();
+
+    bool listen(quint16 port);
+    // Stops new listeners of `slot` joining reads made before it was rewritten; `onPedal` tells
+    // whether a request's device string names the written pedal. Listeners already playing finish.
+    void dropSlot(int slot, const std::function<bool(const QString& device)>& onPedal);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    // One pedal read, from startChunk to the end of the track
+    struct Fetch {
+        QString device;
+        int slot = 0;
+        int startChunk = 1;
+
+        std::mutex mutex;          // Guards everything below
+        QByteArray data;           // Packed bytes from (startChunk - 1) * 1024 on
+        uint32_t trackSize = 0;
+        bool sizeKnown = false;
+        bool done = false;
+        bool missing = false;      // Slot is empty or the pedal is gone
+
+        std::atomic<bool> stop{false};
+        std::atomic<bool> notifyPending{false};
+    };
+
+    struct Listener {
+        QByteArray request;
+        bool parsed = false;
+        bool started = false;      // Response header sent
+        bool wav = true;
+        bool ranged = false;
+        qint64 rangeStart = 0;     // Requested body range, end inclusive (-1 = to the end);
+        qint64 rangeEnd = -1;      // a negative start is a suffix range
+        qint64 dataSize = 0;       // Frame-aligned audio bytes
+        qint64 length = 0;         // Body bytes this response carries
+        qint64 sent = 0;
+        std::shared_ptr<Fetch> fetch;
+    };
+
+    static const qint64 MAX_BACKLOG = 256 * 1024;  // Unsent bytes per socket before we stop feeding it
+
+    Runner runner;
+    QTcpServer server;
+    std::map<QTcpSocket*, Listener> listeners;
+    std::vector<std::shared_ptr<Fetch>> fetches;
+
+    void startListener(QTcpSocket* socket, Listener& listener);
+    std::shared_ptr<Fetch> fetchFor(const QString& device, int slot, int startChunk);
+    void pump(QTcpSocket* socket);
+    void pumpFetch(const std::shared_ptr<Fetch>& fetch);
+    // Called from the pedal thread; coalesces into one queued pumpFetch
+    void notify(const std::shared_ptr<Fetch>& fetch);
+    void release(const std::shared_ptr<Fetch>& fetch);
+    void reply(QTcpSocket* socket, const QByteArray& status, const QByteArray& body = QByteArray());
+};
+
+#endif // STREAM_SERVER_H
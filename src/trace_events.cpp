@@ -0,0 +1,146 @@
+#include "trace_events.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+std::atomic<bool> TraceEvents::enabled(false);
+
+namespace {
+struct Event {
+    const char* category;
+    const char* name;
+    int64_t startUs;
+    int64_t durationUs;  // -1 = instant
+    int64_t arg;
+};
+
+// Written by its own thread; the lock is only contended while stop() collects
+struct ThreadBuffer {
+    std::mutex mutex;
+    int tid = 0;
+    std::string name;
+    std::vector<Event> events;
+};
+
+struct Recorder {
+    std::mutex mutex;
+    std::string path;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;  // Outlive their threads
+    int nextTid = 1;
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+};
+
+Recorder& recorder() {
+    static Recorder r;
+    return r;
+}
+
+ThreadBuffer& threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<ThreadBuffer>();
+        Recorder& r = recorder();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        buffer->tid = r.nextTid++;
+        r.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void push(const Event& event) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(event);
+}
+
+std::string escaped(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    return out;
+}
+}
+
+int64_t TraceEvents::nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - recorder().origin).count();
+}
+
+void TraceEvents::start(const std::string& path) {
+    Recorder& r = recorder();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.path = path;
+        for (auto& buffer : r.buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->events.clear();
+        }
+    }
+    enabled = true;
+}
+
+void TraceEvents::startFromEnvironment() {
+    const char* path = getenv("MOOER_TRACE_EVENTS");
+    if (path && *path) start(path);
+}
+
+bool TraceEvents::stop() {
+    if (!enabled.exchange(false)) return true;
+
+    Recorder& r = recorder();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    FILE* out = fopen(r.path.c_str(), "w");
+    if (!out) {
+        std::cerr << "Cannot write trace events to " << r.path << std::endl;
+        return false;
+    }
+
+    int pid = static_cast<int>(getpid());
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"MooerLooperManager\"}}", pid);
+    for (auto& buffer : r.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        std::string name = buffer->name.empty() ? "Thread " + std::to_string(buffer->tid) : buffer->name;
+        fprintf(out, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                pid, buffer->tid, escaped(name).c_str());
+        for (const Event& e : buffer->events) {
+            fprintf(out, ",\n{\"ph\":\"%s\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%lld",
+                    e.durationUs < 0 ? "i" : "X", e.category, e.name, pid, buffer->tid, (long long)e.startUs);
+            if (e.durationUs >= 0) fprintf(out, ",\"dur\":%lld", (long long)e.durationUs);
+            else fprintf(out, ",\"s\":\"t\"");
+            if (e.arg >= 0) fprintf(out, ",\"args\":{\"value\":%lld}", (long long)e.arg);
+            fprintf(out, "}");
+        }
+        buffer->events.clear();
+    }
+    // Buffers only we still hold belong to finished threads
+    for (auto it = r.buffers.begin(); it != r.buffers.end();) {
+        it = it->use_count() == 1 ? r.buffers.erase(it) : it + 1;
+    }
+    fprintf(out, "\n]}\n");
+    bool ok = fclose(out) == 0;
+    std::cerr << "Trace events written to " << r.path << std::endl;
+    return ok;
+}
+
+void TraceEvents::setThreadName(const std::string& name) {
+    if (!isEnabled()) return;
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void TraceEvents::complete(const char* category, const char* name, int64_t startUs, int64_t durationUs, int64_t arg) {
+    push(Event{category, name, startUs, durationUs, arg});
+}
+
+void TraceEvents::instant(const char* category, const char* name, int64_t arg) {
+    if (!isEnabled()) return;
+    push(Event{category, name, nowUs(), -1, arg});
+}
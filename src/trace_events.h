@@ -0,0 +1,60 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Opt-in timeline of the transfer and audio pipeline, written as Chrome trace-event JSON
+// (open in chrome://tracing or ui.perfetto.dev). Events go to per-thread buffers; with
+// recording off, a scope costs one relaxed atomic load.
+//
+//   MOOER_TRACE_SCOPE("usb", "upload");   // Complete event covering the enclosing block
+//   TraceEvents::setThreadName("Worker");
+class TraceEvents {
+public:
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Starts recording; events are written to `path` by stop()
+    static void start(const std::string& path);
+    // MOOER_TRACE_EVENTS=<file>
+    static void startFromEnvironment();
+    // Writes the file and stops recording. Safe to call when not recording.
+    static bool stop();
+
+    // Names the calling thread's track in the viewer
+    static void setThreadName(const std::string& name);
+
+    // `name` and `category` must be string literals (or otherwise outlive the recording)
+    static void complete(const char* category, const char* name, int64_t startUs, int64_t durationUs, int64_t arg = -1);
+    static void instant(const char* category, const char* name, int64_t arg = -1);
+    static int64_t nowUs();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class TraceScope {
+public:
+    TraceScope(const char* category, const char* name, int64_t arg = -1)
+        : category(category), name(name), arg(arg), startUs(TraceEvents::isEnabled() ? TraceEvents::nowUs() : -1) {}
+    ~TraceScope() {
+        if (startUs >= 0 && TraceEvents::isEnabled()) {
+            TraceEvents::complete(category, name, startUs, TraceEvents::nowUs() - startUs, arg);
+        }
+    }
+
+private:
+    const char* category;
+    const char* name;
+    int64_t arg;
+    int64_t startUs;
+};
+
+#define MOOER_TRACE_CONCAT_(a, b) a##b
+#define MOOER_TRACE_CONCAT(a, b) MOOER_TRACE_CONCAT_(a, b)
+// Optional third argument: one integer recorded with the event (slot, chunk, bytes...)
+#define MOOER_TRACE_SCOPE(category, ...) TraceScope MOOER_TRACE_CONCAT(traceScope_, __LINE__)(category, __VA_ARGS__)
+
+#endif // TRACE_EVENTS_H
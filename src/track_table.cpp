@@ -0,0 +1,202 @@
+#include "track_table.h"
+#include <QAbstractItemView>
+#include <QApplication>
+#include <QColor>
+#include <QHelpEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QStyle>
+#include <QToolTip>
+
+namespace {
+const char* const COLUMN_NAMES[] = {"Duration", "Size", "Actions"};
+const char* const ACTION_NAMES[] = {"Download", "Upload", "Delete"};
+const int BUTTON_MARGIN = 2;
+const int BUTTON_SPACING = 4;
+const int ICON_SIZE = 16;
+}
+
+int TrackTableModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(trackList.size());
+}
+
+int TrackTableModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant TrackTableModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= (int)trackList.size()) return QVariant();
+    const TrackInfo& t = trackList[index.row()];
+
+    bool waiting = pending[index.row()];
+
+    if (role == Qt::DisplayRole) {
+        if (index.column() == ActionsColumn) return QVariant();
+        if (waiting) return QString::fromUtf8("…");
+        if (!t.has_track) return QString::fromUtf8("—");
+        if (index.column() == DurationColumn) return QString::asprintf("%02d:%02d", (int)t.duration / 60, (int)t.duration % 60);
+        return QString::asprintf("%.2f MB", t.size / (1024.0 * 1024.0));
+    }
+    if (role == Qt::BackgroundRole && t.has_track && index.column() != ActionsColumn) {
+        return QColor(0xcc, 0xff, 0xcc);
+    }
+    if (role == EnabledActionsRole) {
+        if (!actionsEnabled || waiting) return 0;
+        int enabled = 1 << UploadAction;
+        if (t.has_track) enabled |= (1 << DownloadAction) | (1 << DeleteAction);
+        return enabled;
+    }
+    return QVariant();
+}
+
+QVariant TrackTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole) return QVariant();
+    if (orientation == Qt::Vertical) return QString::number(section);
+    return section >= 0 && section < ColumnCount ? QString(COLUMN_NAMES[section]) : QString();
+}
+
+bool TrackTableModel::hasTrack(int row) const {
+    return row >= 0 && row < (int)trackList.size() && trackList[row].has_track;
+}
+
+int TrackTableModel::firstEmptySlot() const {
+    for (size_t r = 0; r < trackList.size(); r++) {
+        if (!trackList[r].has_track && !pending[r]) return trackList[r].slot;
+    }
+    return -1;
+}
+
+void TrackTableModel::setTracks(const std::vector<TrackInfo>& tracks) {
+    if (tracks.size() != trackList.size()) {
+        beginResetModel();
+        trackList = tracks;
+        pending.assign(tracks.size(), false);
+        endResetModel();
+        return;
+    }
+    for (const TrackInfo& t : tracks) setTrack(t);
+}
+
+void TrackTableModel::setTrack(const TrackInfo& track) {
+    if (track.slot < 0 || track.slot >= (int)trackList.size()) return;
+    TrackInfo& row = trackList[track.slot];
+    if (!pending[track.slot] && row.has_track == track.has_track && row.size == track.size) return;
+    row = track;
+    pending[track.slot] = false;
+    rowChanged(track.slot);
+}
+
+void TrackTableModel::beginListing(int slots) {
+    // Rows already shown keep their values until re-read
+    if ((int)trackList.size() == slots) return;
+    beginResetModel();
+    trackList.clear();
+    for (int i = 0; i < slots; i++) trackList.push_back({i, false, 0.0, 0});
+    pending.assign(slots, true);
+    endResetModel();
+}
+
+void TrackTableModel::setActionsEnabled(bool enabled) {
+    if (enabled == actionsEnabled) return;
+    actionsEnabled = enabled;
+    if (trackList.empty()) return;
+    emit dataChanged(index(0, ActionsColumn), index(rowCount() - 1, ActionsColumn), {EnabledActionsRole});
+}
+
+void TrackTableModel::rowChanged(int row) {
+    emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+}
+
+TrackActionDelegate::TrackActionDelegate(const QVector<QIcon>& icons, QObject* parent)
+    : QStyledItemDelegate(parent), icons(icons) {}
+
+QRect TrackActionDelegate::buttonRect(const QRect& cell, int action) {
+    // Same layout the per-row button widgets had: equal widths across the cell
+    QRect area = cell.adjusted(BUTTON_MARGIN, BUTTON_MARGIN, -BUTTON_MARGIN, -BUTTON_MARGIN);
+    int count = TrackTableModel::ActionCount;
+    int width = (area.width() - BUTTON_SPACING * (count - 1)) / count;
+    return QRect(area.left() + action * (width + BUTTON_SPACING), area.top(), width, area.height());
+}
+
+int TrackActionDelegate::actionAt(const QRect& cell, const QPoint& pos) {
+    for (int a = 0; a < TrackTableModel::ActionCount; a++) {
+        if (buttonRect(cell, a).contains(pos)) return a;
+    }
+    return -1;
+}
+
+void TrackActionDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    QStyleOptionViewItem item = option;
+    initStyleOption(&item, index);
+    const QWidget* widget = option.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    // Selection/hover background of the row
+    style->drawPrimitive(QStyle::PE_PanelItemViewItem, &item, painter, widget);
+
+    int enabled = index.data(TrackTableModel::EnabledActionsRole).toInt();
+    for (int a = 0; a < TrackTableModel::ActionCount; a++) {
+        QStyleOptionButton button;
+        button.rect = buttonRect(option.rect, a);
+        button.palette = option.palette;
+        button.direction = option.direction;
+        button.fontMetrics = option.fontMetrics;
+        button.icon = icons.value(a);
+        button.iconSize = QSize(ICON_SIZE, ICON_SIZE);
+        button.state = option.state & QStyle::State_Active;
+        if (enabled & (1 << a)) button.state |= QStyle::State_Enabled;
+        bool pressed = pressedAction == a && pressedIndex == index;
+        button.state |= pressed ? QStyle::State_Sunken : QStyle::State_Raised;
+        style->drawControl(QStyle::CE_PushButton, &button, painter, widget);
+    }
+}
+
+QSize TrackActionDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    Q_UNUSED(option);
+    Q_UNUSED(index);
+    int buttonWidth = ICON_SIZE + 24;
+    int count = TrackTableModel::ActionCount;
+    return QSize(count * buttonWidth + (count - 1) * BUTTON_SPACING + 2 * BUTTON_MARGIN, ICON_SIZE + 16);
+}
+
+bool TrackActionDelegate::editorEvent(QEvent* event, QAbstractItemModel* model, const QStyleOptionViewItem& option,
+                                      const QModelIndex& index) {
+    Q_UNUSED(model);
+    QEvent::Type type = event->type();
+    if (type != QEvent::MouseButtonPress && type != QEvent::MouseButtonDblClick && type != QEvent::MouseButtonRelease) {
+        return false;
+    }
+    auto* mouse = static_cast<QMouseEvent*>(event);
+    if (mouse->button() != Qt::LeftButton) return false;
+
+    int action = actionAt(option.rect, mouse->position().toPoint());
+    bool enabled = action >= 0 && (index.data(TrackTableModel::EnabledActionsRole).toInt() & (1 << action));
+    auto* view = qobject_cast<QAbstractItemView*>(const_cast<QWidget*>(option.widget));
+
+    // A double click is a second press, as on a real button
+    if (type != QEvent::MouseButtonRelease) {
+        if (!enabled) return false;
+        pressedIndex = index;
+        pressedAction = action;
+        if (view) view->update(index);
+        return true;
+    }
+
+    bool clicked = enabled && (pressedAction < 0 || (pressedIndex == index && pressedAction == action));
+    if (view && pressedIndex.isValid()) view->update(pressedIndex);
+    pressedIndex = QPersistentModelIndex();
+    pressedAction = -1;
+    if (clicked) emit actionTriggered(index.row(), action);
+    return clicked;
+}
+
+bool TrackActionDelegate::helpEvent(QHelpEvent* event, QAbstractItemView* view, const QStyleOptionViewItem& option,
+                                    const QModelIndex& index) {
+    if (event->type() == QEvent::ToolTip) {
+        int action = actionAt(option.rect, event->pos());
+        if (action >= 0) {
+            QToolTip::showText(event->globalPos(), ACTION_NAMES[action], view);
+            return true;
+        }
+    }
+    return QStyledItemDelegate::helpEvent(event, view, option, index);
+}
@@ -0,0 +1,80 @@
+#ifndef TRACK_TABLE_H
+#define TRACK_TABLE_H
+
+#include <QAbstractTableModel>
+#include <QIcon>
+#include <QPersistentModelIndex>
+#include <QStyledItemDelegate>
+#include <QVector>
+#include <vector>
+#include "protocol.h"
+
+// One row per pedal slot. Updates only signal the rows or cells that changed, so
+// refreshing the list or toggling the action buttons never rebuilds the table.
+class TrackTableModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum Column { DurationColumn, SizeColumn, ActionsColumn, ColumnCount };
+    enum Action { DownloadAction, UploadAction, DeleteAction, ActionCount };
+    // int bitmask of the clickable actions (bit = 1 << Action)
+    static constexpr int EnabledActionsRole = Qt::UserRole;
+
+    using QAbstractTableModel::QAbstractTableModel;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    const std::vector<TrackInfo>& tracks() const { return trackList; }
+    bool hasTrack(int row) const;
+    // -1 when every slot is occupied
+    int firstEmptySlot() const;
+
+    // Replaces the listing; rows whose track is unchanged are left alone
+    void setTracks(const std::vector<TrackInfo>& tracks);
+    // Patches the row of one re-read slot
+    void setTrack(const TrackInfo& track);
+    // Before the first listing: `slots` placeholder rows, filled in by setTrack as slots arrive
+    void beginListing(int slots);
+    // Download/Delete need a track; Upload only needs the pedal to be idle
+    void setActionsEnabled(bool enabled);
+
+private:
+    std::vector<TrackInfo> trackList;
+    std::vector<bool> pending;  // Not read yet
+    bool actionsEnabled = true;
+
+    void rowChanged(int row);
+};
+
+// Paints the Download/Upload/Delete buttons of the Actions column and turns clicks on
+// them into actionTriggered(), instead of a widget per row
+class TrackActionDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+
+public:
+    // `icons` is indexed by TrackTableModel::Action
+    TrackActionDelegate(const QVector<QIcon>& icons, QObject* parent = nullptr);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    bool editorEvent(QEvent* event, QAbstractItemModel* model, const QStyleOptionViewItem& option,
+                     const QModelIndex& index) override;
+    bool helpEvent(QHelpEvent* event, QAbstractItemView* view, const QStyleOptionViewItem& option,
+                   const QModelIndex& index) override;
+
+signals:
+    void actionTriggered(int row, int action);
+
+private:
+    QVector<QIcon> icons;
+    QPersistentModelIndex pressedIndex;
+    int pressedAction = -1;
+
+    static QRect buttonRect(const QRect& cell, int action);
+    static int actionAt(const QRect& cell, const QPoint& pos);
+};
+
+#endif // TRACK_TABLE_H
@@ -0,0 +1,34 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <libusb-1.0/libusb.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+// Endpoint I/O used by USBDevice. Same contract as libusb_interrupt_transfer: the direction
+// comes from the endpoint's 0x80 bit and the result is 0 or a LIBUSB_ERROR_* code.
+class Transport {
+public:
+    virtual ~Transport() {}
+    virtual int transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) = 0;
+    // Fixed waits the pedal needs between protocol phases (e.g. around uploads)
+    virtual void settle(std::chrono::milliseconds duration) { std::this_thread::sleep_for(duration); }
+    // Start of a high level operation, for tracing
+    virtual void mark(const std::string& op) { (void)op; }
+};
+
+// Real pedal behind an open, claimed libusb handle. Does not own the handle.
+class LibusbTransport : public Transport {
+public:
+    explicit LibusbTransport(libusb_device_handle* handle) : handle(handle) {}
+
+    int transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) override {
+        return libusb_interrupt_transfer(handle, endpoint, data, length, transferred, timeout);
+    }
+
+private:
+    libusb_device_handle* handle;
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,67 @@
+#include "usb_context.h"
+#include "metrics.h"
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+struct State {
+    std::mutex mutex;
+    libusb_context* ctx = nullptr;
+    int users = 0;
+    int stopRequested = 0;  // libusb_handle_events_completed() flag
+    std::thread eventThread;
+};
+
+State& state() {
+    static State s;
+    return s;
+}
+
+void eventLoop(libusb_context* ctx, int* stop) {
+    Metrics::Counter& wakeups = Metrics::counter("mooer_usb_event_loop_wakeups_total");
+    while (!*stop) {
+        // Blocks until there is something to do; libusb_interrupt_event_handler() breaks it out
+        int rc = libusb_handle_events_completed(ctx, stop);
+        wakeups.add();
+        if (rc < 0 && rc != LIBUSB_ERROR_INTERRUPTED) {
+            std::cerr << "libusb_handle_events error: " << libusb_error_name(rc) << std::endl;
+            break;
+        }
+    }
+}
+}
+
+libusb_context* UsbContext::get() {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.ctx) {
+        int rc = libusb_init(&s.ctx);
+        if (rc < 0) {
+            std::cerr << "libusb_init failed: " << libusb_error_name(rc) << std::endl;
+            s.ctx = nullptr;
+        }
+    }
+    return s.ctx;
+}
+
+void UsbContext::acquireEvents() {
+    libusb_context* ctx = get();
+    if (!ctx) return;
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.users++ > 0) return;
+    s.stopRequested = 0;
+    s.eventThread = std::thread(eventLoop, ctx, &s.stopRequested);
+}
+
+void UsbContext::releaseEvents() {
+    State& s = state();
+    // Joined under the lock so an acquireEvents() racing in cannot reset the flag the old
+    // thread is still about to check
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.users == 0 || --s.users > 0) return;
+    s.stopRequested = 1;
+    libusb_interrupt_event_handler(s.ctx);
+    if (s.eventThread.joinable()) s.eventThread.join();
+}
@@ -0,0 +1,30 @@
+#ifndef USB_CONTEXT_H
+#define USB_CONTEXT_H
+
+#include <libusb-1.0/libusb.h>
+
+// The one libusb context of the process, shared by device handles, enumeration and the
+// device registry. A single event thread services it: hotplug callbacks and the
+// completions of asynchronous transfers both run there, so nothing else polls libusb.
+// Synchronous transfers keep working alongside it; libusb hands them their completions.
+class UsbContext {
+public:
+    // Initialized on first use and kept until the process exits
+    static libusb_context* get();
+
+    // The event thread runs while at least one user needs callbacks (hotplug, async transfers).
+    // Not to be called from a libusb callback, which runs on that thread.
+    static void acquireEvents();
+    static void releaseEvents();
+
+    // Holds the event thread for its lifetime
+    class EventsRef {
+    public:
+        EventsRef() { acquireEvents(); }
+        ~EventsRef() { releaseEvents(); }
+        EventsRef(const EventsRef&) = delete;
+        EventsRef& operator=(const EventsRef&) = delete;
+    };
+};
+
+#endif // USB_CONTEXT_H
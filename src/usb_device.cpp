@@ -1,66 +1,86 @@
 #include "usb_device.h"
+#include "emulated_pedal.h"
+#include "usb_trace.h"
+#include "usb_context.h"
+#include "metered_transport.h"
+#include "metrics.h"
+#include "link_profile.h"
+#include "trace_events.h"
 #include <QtEndian>
 #include <QProcess>
 #include <QTemporaryFile>
 #include <QTextStream>
+#include <algorithm>
 #include <iostream>
 #include <thread>
 #include <chrono>
 #include <cmath>
 #include <fstream>
+#include <cstdlib>
 
-USBDevice::USBDevice() : ctx(nullptr), dev_handle(nullptr), connected(false), connectedBus(0), connectedAddress(0) {
-    libusb_init(&ctx);
-}
+USBDevice::USBDevice() : dev_handle(nullptr), connected(false), connectedBus(0), connectedAddress(0),
+                         chunkTimeoutMs(DEFAULT_TIMEOUT_MS) {}
 
 USBDevice::~USBDevice() {
     disconnect();
-    if (ctx) libusb_exit(ctx);
+}
+
+bool USBDevice::describeDevice(libusb_device* dev, DeviceInfo& info) {
+    libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(dev, &desc) < 0) return false;
+
+    if (desc.idVendor != Protocol::VENDOR_ID) return false;
+
+    info = DeviceInfo();
+    info.vid = desc.idVendor;
+    info.pid = desc.idProduct;
+    info.bus = libusb_get_bus_number(dev);
+    info.address = libusb_get_device_address(dev);
+    info.hasPermission = false;
+
+    libusb_device_handle* handle = nullptr;
+    if (libusb_open(dev, &handle) == 0) {
+        info.hasPermission = true;
+        unsigned char buffer[256];
+        if (desc.iProduct && libusb_get_string_descriptor_ascii(handle, desc.iProduct, buffer, sizeof(buffer)) > 0) {
+            info.name = reinterpret_cast<char*>(buffer);
+        }
+        if (desc.iSerialNumber && libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, buffer, sizeof(buffer)) > 0) {
+            info.serial = reinterpret_cast<char*>(buffer);
+        }
+        libusb_close(handle);
+    }
+
+    if (info.name.empty()) {
+        info.name = "Mooer Device";
+    }
+    return true;
+}
+
+bool USBDevice::emulatedDevice(DeviceInfo& info) {
+    // MOOER_EMULATOR="latency=300,tracks=4,..." adds an in-process pedal for testing without hardware
+    if (!getenv("MOOER_EMULATOR")) return false;
+    info = {Protocol::VENDOR_ID, Protocol::PRODUCT_ID, EmulatedPedal::BUS, EmulatedPedal::ADDRESS,
+            "Emulated Pedal", EmulatedPedal::serial(), true};
+    return true;
 }
 
 std::vector<DeviceInfo> USBDevice::enumerateDevices() {
     std::vector<DeviceInfo> devices;
-    libusb_context* enumCtx = nullptr;
-    libusb_init(&enumCtx);
+    libusb_context* ctx = UsbContext::get();
 
     libusb_device** devList;
-    ssize_t count = libusb_get_device_list(enumCtx, &devList);
+    ssize_t count = ctx ? libusb_get_device_list(ctx, &devList) : -1;
 
     for (ssize_t i = 0; i < count; i++) {
-        libusb_device_descriptor desc;
-        if (libusb_get_device_descriptor(devList[i], &desc) < 0) continue;
-
-        if (desc.idVendor != Protocol::VENDOR_ID) continue;
-
         DeviceInfo info;
-        info.vid = desc.idVendor;
-        info.pid = desc.idProduct;
-        info.bus = libusb_get_bus_number(devList[i]);
-        info.address = libusb_get_device_address(devList[i]);
-        info.hasPermission = false;
-
-        libusb_device_handle* handle = nullptr;
-        if (libusb_open(devList[i], &handle) == 0) {
-            info.hasPermission = true;
-            unsigned char buffer[256];
-            if (desc.iProduct && libusb_get_string_descriptor_ascii(handle, desc.iProduct, buffer, sizeof(buffer)) > 0) {
-                info.name = reinterpret_cast<char*>(buffer);
-            }
-            if (desc.iSerialNumber && libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, buffer, sizeof(buffer)) > 0) {
-                info.serial = reinterpret_cast<char*>(buffer);
-            }
-            libusb_close(handle);
-        }
-
-        if (info.name.empty()) {
-            info.name = "Mooer Device";
-        }
-
-        devices.push_back(info);
+        if (describeDevice(devList[i], info)) devices.push_back(info);
     }
 
-    libusb_free_device_list(devList, 1);
-    libusb_exit(enumCtx);
+    if (count >= 0) libusb_free_device_list(devList, 1);
+
+    DeviceInfo emulated;
+    if (emulatedDevice(emulated)) devices.push_back(emulated);
     return devices;
 }
 
@@ -115,6 +135,17 @@ bool USBDevice::installUdevRule() {
 bool USBDevice::connect(uint8_t bus, uint8_t address) {
     if (connected) return true;
 
+    if (bus == EmulatedPedal::BUS && address == EmulatedPedal::ADDRESS) {
+        const char* spec = getenv("MOOER_EMULATOR");
+        auto options = EmulatedPedal::Options::parse(spec ? spec : "");
+        if (!attach(std::make_unique<EmulatedPedal>(options), EmulatedPedal::serial())) return false;
+        connectedBus = bus;
+        connectedAddress = address;
+        return true;
+    }
+
+    libusb_context* ctx = UsbContext::get();
+    if (!ctx) return false;
     if (bus == 0 && address == 0) {
         dev_handle = libusb_open_device_with_vid_pid(ctx, Protocol::VENDOR_ID, Protocol::PRODUCT_ID);
     } else {
@@ -154,16 +185,47 @@ bool USBDevice::connect(uint8_t bus, uint8_t address) {
         return false;
     }
 
+    transport = std::make_unique<LibusbTransport>(dev_handle);
     connected = true;
     if (dev_handle) {
         libusb_device* dev = libusb_get_device(dev_handle);
         connectedBus = libusb_get_bus_number(dev);
         connectedAddress = libusb_get_device_address(dev);
+
+        libusb_device_descriptor desc;
+        unsigned char buffer[256];
+        if (libusb_get_device_descriptor(dev, &desc) == 0 && desc.iSerialNumber &&
+            libusb_get_string_descriptor_ascii(dev_handle, desc.iSerialNumber, buffer, sizeof(buffer)) > 0) {
+            connectedSerial = reinterpret_cast<char*>(buffer);
+        }
     }
+
+    chunkTimeoutMs = LinkProfile::load(connectedSerial).chunkTimeoutMs();
+    instrument();
+    return true;
+}
+
+bool USBDevice::attach(std::unique_ptr<Transport> t, const std::string& serial) {
+    if (connected || !t) return false;
+    transport = std::move(t);
+    connectedSerial = serial;
+    connected = true;
+    chunkTimeoutMs = LinkProfile::load(connectedSerial).chunkTimeoutMs();
+    instrument();
     return true;
 }
 
+void USBDevice::instrument() {
+    transport = std::make_unique<MeteredTransport>(std::move(transport));
+    // MOOER_USB_TRACE captures the session for offline replay
+    QString tracePath = UsbTrace::capturePath(connectedSerial);
+    if (!tracePath.isEmpty()) {
+        transport = std::make_unique<RecordingTransport>(std::move(transport), tracePath);
+    }
+}
+
 void USBDevice::disconnect() {
+    transport.reset();
     if (dev_handle) {
         libusb_release_interface(dev_handle, 0);
         libusb_release_interface(dev_handle, 1);
@@ -173,17 +235,24 @@ void USBDevice::disconnect() {
     connected = false;
     connectedBus = 0;
     connectedAddress = 0;
+    connectedSerial.clear();
+    chunkTimeoutMs = DEFAULT_TIMEOUT_MS;
 }
 
 bool USBDevice::isConnected() const {
     return connected;
 }
 
+void USBDevice::markOp(const std::string& op) {
+    if (transport) transport->mark(op);
+}
+
 int USBDevice::write(const QByteArray& data, int endpoint, int timeout) {
     if (!connected) return -1;
-    int transferred;
+    MOOER_TRACE_SCOPE("usb", "write", endpoint);
+    int transferred = 0;
     // Changed to interrupt transfer based on Python implementation/packet capture
-    int r = libusb_interrupt_transfer(dev_handle, endpoint, (unsigned char*)data.data(), data.size(), &transferred, timeout);
+    int r = transport->transfer(endpoint, (unsigned char*)data.data(), data.size(), &transferred, timeout);
     if (r < 0) {
         std::cerr << "Write error to ep " << std::hex << endpoint << ": " << libusb_error_name(r) << std::dec << std::endl;
     }
@@ -192,10 +261,11 @@ int USBDevice::write(const QByteArray& data, int endpoint, int timeout) {
 
 QByteArray USBDevice::read(int size, int endpoint, int timeout) {
     if (!connected) return QByteArray();
+    MOOER_TRACE_SCOPE("usb", "read", endpoint);
     QByteArray buffer(size, 0);
-    int transferred;
+    int transferred = 0;
     // Changed to interrupt transfer based on Python implementation/packet capture
-    int r = libusb_interrupt_transfer(dev_handle, endpoint, (unsigned char*)buffer.data(), size, &transferred, timeout);
+    int r = transport->transfer(endpoint, (unsigned char*)buffer.data(), size, &transferred, timeout);
     if (r < 0 && r != LIBUSB_ERROR_TIMEOUT) {
         std::cerr << "Read error from ep " << std::hex << endpoint << ": " << libusb_error_name(r) << std::dec << std::endl;
         return QByteArray();
@@ -204,101 +274,182 @@ QByteArray USBDevice::read(int size, int endpoint, int timeout) {
     return buffer;
 }
 
-std::vector<TrackInfo> USBDevice::listTracks() {
-    std::vector<TrackInfo> tracks;
-    for (int i = 0; i < Protocol::MAX_TRACKS; i++) {
-        QByteArray cmd = Protocol::createDownloadCommand(i, 0); // Query command is same as download chunk 0
-        write(cmd);
-        QByteArray resp = read(1024);
-
-        bool hasTrack = false;
-        uint32_t size = 0;
-        double duration = 0;
-
-        if (Protocol::parseTrackInfoHeader(resp, size)) {
-            hasTrack = true;
-            // Matches Python logic: DEVICE_SIZE_MULTIPLIER = 1.0
-            // duration = size / (44100 * 2ch * 3bytes)
-            duration = (double)size / (6.0 * 44100.0);
-        }
-        tracks.push_back({i, hasTrack, duration, size});
-    }
+std::vector<TrackInfo> USBDevice::listTracks(const std::vector<int>& order,
+                                             const std::function<void(const TrackInfo&)>& onTrack) {
+    MOOER_TRACE_SCOPE("usb", "listTracks");
+    markOp("list");
+    std::vector<TrackInfo> tracks(Protocol::MAX_TRACKS);
+    std::vector<bool> read(Protocol::MAX_TRACKS, false);
+    auto query = [&](int slot) {
+        if (slot < 0 || slot >= Protocol::MAX_TRACKS || read[slot]) return;
+        read[slot] = true;
+        tracks[slot] = queryTrack(slot);
+        if (onTrack) onTrack(tracks[slot]);
+    };
+    for (int slot : order) query(slot);
+    for (int slot = 0; slot < Protocol::MAX_TRACKS; slot++) query(slot);
     return tracks;
 }
 
+TrackInfo USBDevice::queryTrack(int slot, bool* answered) {
+    QByteArray cmd = Protocol::createDownloadCommand(slot, 0); // Query command is same as download chunk 0
+    write(cmd);
+    QByteArray resp = read(1024);
+    if (answered) *answered = !resp.isEmpty();
+
+    bool hasTrack = false;
+    uint32_t size = 0;
+    double duration = 0;
+
+    if (Protocol::parseTrackInfoHeader(resp, size)) {
+        hasTrack = true;
+        // Matches Python logic: DEVICE_SIZE_MULTIPLIER = 1.0
+        // duration = size / (44100 * 2ch * 3bytes)
+        duration = (double)size / (6.0 * 44100.0);
+    }
+    return {slot, hasTrack, duration, size};
+}
+
 void USBDevice::deleteTrack(int slot) {
+    MOOER_TRACE_SCOPE("usb", "deleteTrack", slot);
+    markOp("delete " + std::to_string(slot));
     write(Protocol::createDeleteCommand(slot));
     read(64, Protocol::EP_IN_STATUS); // Ack
 }
 
 void USBDevice::playTrack(int slot) {
+    markOp("play " + std::to_string(slot));
     write(Protocol::createPlayCommand(slot, 0x01));
     read(1024, Protocol::EP_IN_DATA); // Response?
 }
 
 void USBDevice::stopPlayback(int slot) {
+    markOp("stop " + std::to_string(slot));
     write(Protocol::createPlayCommand(slot, 0x00));
     read(1024, Protocol::EP_IN_DATA); // Response?
 }
 
+QByteArray USBDevice::readFirstChunk(int slot) {
+    QByteArray first;
+    readTrackChunks(slot, [&](int, int, const QByteArray& data) {
+        first = data;
+        return false;
+    });
+    return first;
+}
+
 std::vector<int32_t> USBDevice::downloadTrack(int slot, ProgressCallback callback, void* userData) {
-    // Get info
-    write(Protocol::createDownloadCommand(slot, 0));
-    QByteArray firstChunk = read(1024);
+    return Protocol::parseAudioData(downloadTrackRaw(slot, callback, userData), false);
+}
 
+QByteArray USBDevice::downloadTrackRaw(int slot, ProgressCallback callback, void* userData) {
+    QByteArray raw;
     uint32_t trackSize = 0;
-    if (!Protocol::parseTrackInfoHeader(firstChunk, trackSize)) {
+
+    bool exists = readTrackChunks(slot, [&](int i, int chunks, const QByteArray& data) {
+        if (raw.isEmpty()) raw.reserve(chunks * 1024);
+        raw.append(data);
+        if (callback) callback(raw.size(), trackSize, userData);
+        return true;
+    }, 1, nullptr, &trackSize);
+
+    if (!exists) {
         throw std::runtime_error("Track does not exist");
     }
+    if ((uint32_t)raw.size() < trackSize) {
+        throw std::runtime_error("Track download incomplete");
+    }
+    if (callback) callback(trackSize, trackSize, userData);
 
-    std::vector<int32_t> fullAudio;
-    fullAudio.reserve(trackSize / 3); // Approx
+    // The last chunk is padded to 1024 bytes
+    if ((uint32_t)raw.size() > trackSize) {
+        raw.truncate(trackSize);
+    }
 
-    QByteArray buffer;
-    int chunks = (trackSize + 1023) / 1024;
+    return raw;
+}
 
-    // Start from Chunk 1
-    for (int i = 1; i <= chunks; i++) {
-        write(Protocol::createDownloadCommand(slot, i));
-        QByteArray data = read(1024);
-        if (data.isEmpty()) break;
+bool USBDevice::readTrackChunks(int slot, const ChunkCallback& chunkCallback, int startChunk,
+                                const std::atomic<bool>* stopFlag, uint32_t* trackSize) {
+    MOOER_TRACE_SCOPE("usb", "readTrackChunks", slot);
+    markOp("read " + std::to_string(slot) + " " + std::to_string(startChunk));
+    // Get info
+    write(Protocol::createDownloadCommand(slot, 0));
+    QByteArray firstChunk = read(1024);
 
-        buffer.append(data);
+    uint32_t size = 0;
+    if (!Protocol::parseTrackInfoHeader(firstChunk, size)) return false;
+    if (trackSize) *trackSize = size;
 
-        int numFrames = buffer.size() / 6;
-        int bytesToProcess = numFrames * 6;
+    int chunks = (size + 1023) / 1024;
+    if (startChunk < 1) startChunk = 1;
 
-        if (bytesToProcess > 0) {
-            std::vector<int32_t> samples = Protocol::parseAudioData(buffer.left(bytesToProcess), false);
-            fullAudio.insert(fullAudio.end(), samples.begin(), samples.end());
-            buffer.remove(0, bytesToProcess);
+    for (int i = startChunk; i <= chunks; i++) {
+        if (stopFlag && *stopFlag) break;
+
+        // A chunk that misses the chunk timeout is asked for again once the link is back in
+        // step, until DEFAULT_TIMEOUT_MS has passed for this chunk
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DEFAULT_TIMEOUT_MS);
+        QByteArray data;
+        while (true) {
+            write(Protocol::createDownloadCommand(slot, i));
+            data = read(1024, Protocol::EP_IN_DATA, chunkTimeoutMs);
+            if (!data.isEmpty()) break;
+
+            static Metrics::Counter& retries = Metrics::counter("mooer_usb_chunk_retries_total");
+            retries.add();
+            if (std::chrono::steady_clock::now() >= deadline || !resyncChunkReads(slot, size, deadline)) {
+                throw std::runtime_error("No reply for chunk " + std::to_string(i) + " of " + std::to_string(chunks) +
+                                         " (slot " + std::to_string(slot) + ")");
+            }
         }
 
-        if (callback && (i % 10 == 0)) callback(fullAudio.size() * 3, trackSize, userData);
+        if (!chunkCallback(i, chunks, data)) break;
     }
-    if (callback) callback(trackSize, trackSize, userData);
+    return true;
+}
 
-    // Trim if necessary to match trackSize frames
-    // trackSize is bytes. 1 frame = 6 bytes. 2 samples per frame.
-    // Total samples = (trackSize / 6) * 2 = trackSize / 3.
-    size_t expectedSamples = trackSize / 3;
-    if (fullAudio.size() > expectedSamples) {
-        fullAudio.resize(expectedSamples);
+bool USBDevice::resyncChunkReads(int slot, uint32_t size, std::chrono::steady_clock::time_point deadline) {
+    MOOER_TRACE_SCOPE("usb", "resyncChunkReads", slot);
+    // Chunks carry no index, and a reply that missed its timeout may still arrive. Replies come
+    // back in order, so a header query marks the point past which nothing stale is left: every
+    // reply read before its header is a late chunk and is dropped.
+    if (write(Protocol::createDownloadCommand(slot, 0)) <= 0) return false;
+    while (true) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) return false;
+        QByteArray reply = read(1024, Protocol::EP_IN_DATA, std::min<int>(left.count(), chunkTimeoutMs));
+        uint32_t replySize = 0;
+        if (Protocol::parseTrackInfoHeader(reply, replySize) && replySize == size) return true;
     }
-
-    return fullAudio;
 }
 
 void USBDevice::uploadTrack(int slot, const std::vector<int32_t>& audio, ProgressCallback callback, void* userData) {
+    uploadTrackRaw(slot, Protocol::encodeAudioData(audio), callback, userData);
+}
+
+void USBDevice::uploadTrackRaw(int slot, const QByteArray& audioData, ProgressCallback callback, void* userData) {
+    int offset = 0;
+    uploadTrackChunks(slot, audioData.size(), [&]() {
+        QByteArray chunk = audioData.mid(offset, 1024);
+        offset += chunk.size();
+        return chunk;
+    }, callback, userData);
+}
+
+void USBDevice::uploadTrackChunks(int slot, uint32_t size, const ChunkSource& nextChunk,
+                                  ProgressCallback callback, void* userData) {
+    MOOER_TRACE_SCOPE("usb", "uploadTrackChunks", slot);
+    markOp("upload " + std::to_string(slot) + " " + std::to_string(size));
     // 1. Init
     write(Protocol::createInitUploadCommand());
     read(64, Protocol::EP_IN_STATUS);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    {
+        MOOER_TRACE_SCOPE("usb", "settle");
+        transport->settle(std::chrono::seconds(1));
+    }
 
     // 2. Prepare Data
-    QByteArray audioData = Protocol::encodeAudioData(audio);
-    uint32_t size = audioData.size();
-
     QByteArray metaChunk(1024, 0);
     qToLittleEndian<uint32_t>(size, reinterpret_cast<uchar*>(metaChunk.data()));
 
@@ -309,11 +460,15 @@ void USBDevice::uploadTrack(int slot, const std::vector<int32_t>& audio, Progres
     read(64, Protocol::EP_IN_STATUS);
 
     // Send chunks 1+
-    int totalChunks = (audioData.size() + 1023) / 1024;
+    int totalChunks = (size + 1023) / 1024;
     for (int i = 0; i < totalChunks; i++) {
         int offset = i * 1024;
-        QByteArray chunk = audioData.mid(offset, 1024);
-        if (chunk.size() < 1024) chunk.resize(1024); // Zero pad
+        QByteArray chunk = nextChunk();
+        if (chunk.isEmpty()) {
+            throw std::runtime_error("Upload source ended early");
+        }
+        if (chunk.size() > 1024) chunk.truncate(1024);
+        if (chunk.size() < 1024) chunk.append(1024 - chunk.size(), '\0'); // Zero pad
 
         write(Protocol::createUploadCommand(slot, i + 1));
         read(64, Protocol::EP_IN_STATUS);
@@ -321,11 +476,14 @@ void USBDevice::uploadTrack(int slot, const std::vector<int32_t>& audio, Progres
         write(chunk, 0x03);
         read(64, Protocol::EP_IN_STATUS);
 
-        if (callback && (i % 10 == 0)) callback(offset, size, userData);
+        if (callback) callback(offset, size, userData);
     }
     if (callback) callback(size, size, userData);
 
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    {
+        MOOER_TRACE_SCOPE("usb", "settle");
+        transport->settle(std::chrono::seconds(1));
+    }
     // Finalize/Verify
     write(Protocol::createDownloadCommand(slot, 0)); // Query
     read(1024);
@@ -333,56 +491,17 @@ void USBDevice::uploadTrack(int slot, const std::vector<int32_t>& audio, Progres
 
 void USBDevice::startStreaming(int slot, std::function<void(const std::vector<int32_t>&)> audioCallback, std::atomic<bool>& stopFlag,
                                ProgressCallback progressCallback, void* progressUserData, int startChunk) {
-    // Get info
-    write(Protocol::createDownloadCommand(slot, 0));
-    QByteArray firstChunk = read(1024);
-    uint32_t size;
-    if (!Protocol::parseTrackInfoHeader(firstChunk, size)) return;
-
-    int chunks = (size + 1023) / 1024;
-    QByteArray remainderBuffer;
-
-    if (startChunk < 1) startChunk = 1;
+    PackedStreamDecoder decoder(startChunk);
 
-    bool firstChunkProcessed = false;
-
-    for (int i = startChunk; i <= chunks; i++) {
-        if (stopFlag) break;
-
-        write(Protocol::createDownloadCommand(slot, i));
-        QByteArray data = read(1024);
-        if (data.isEmpty()) break;
-
-        if (!firstChunkProcessed && startChunk > 1) {
-            // Fix alignment issues when starting from arbitrary chunk
-            // Global offset = (chunkIndex - 1) * 1024
-            // We need to ensure we are at a 6-byte boundary
-            long long globalOffset = (long long)(startChunk - 1) * 1024;
-            int alignment = globalOffset % 6;
-            if (alignment != 0) {
-                int toDiscard = 6 - alignment;
-                if (toDiscard < data.size()) {
-                    data.remove(0, toDiscard);
-                } else {
-                     data.clear();
-                }
-            }
-            firstChunkProcessed = true;
-        }
-
-        remainderBuffer.append(data);
-
-        int numFrames = remainderBuffer.size() / 6;
-        int bytesToProcess = numFrames * 6;
-
-        if (bytesToProcess > 0) {
-            std::vector<int32_t> samples = Protocol::parseAudioData(remainderBuffer.left(bytesToProcess), false);
+    readTrackChunks(slot, [&](int i, int chunks, const QByteArray& data) {
+        std::vector<int32_t> samples = decoder.feed(data);
+        if (!samples.empty()) {
             audioCallback(samples);
-            remainderBuffer.remove(0, bytesToProcess);
         }
 
         if (progressCallback) {
             progressCallback(i, chunks, progressUserData);
         }
-    }
+        return true;
+    }, startChunk, &stopFlag);
 }
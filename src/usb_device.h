@@ -4,8 +4,13 @@
 #include <libusb-1.0/libusb.h>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <QByteArray>
 #include "protocol.h"
+#include "transport.h"
 
 struct DeviceInfo {
     uint16_t vid;
@@ -23,27 +28,67 @@ public:
     ~USBDevice();
 
     static std::vector<DeviceInfo> enumerateDevices();
+    // Fills `info` from the descriptors of a Mooer device (opening it for the name and serial).
+    // False for other vendors' devices.
+    static bool describeDevice(libusb_device* dev, DeviceInfo& info);
+    // The in-process pedal, if MOOER_EMULATOR is set
+    static bool emulatedDevice(DeviceInfo& info);
     static bool installUdevRule();
     static bool needsUdevRule();
 
     bool connect(uint8_t bus = 0, uint8_t address = 0);
+    // Connects to an in-process transport instead of real hardware (emulated pedal, replay)
+    bool attach(std::unique_ptr<Transport> transport, const std::string& serial = std::string());
     void disconnect();
+    Transport* getTransport() const { return transport.get(); }
     bool isConnected() const;
     uint8_t getBus() const { return connectedBus; }
     uint8_t getAddress() const { return connectedAddress; }
+    const std::string& getSerial() const { return connectedSerial; }
+
+    // Timeout for each download chunk read. A chunk that misses it is requested again after
+    // the stale replies are cleared, until the default timeout has passed for that chunk.
+    static constexpr int DEFAULT_TIMEOUT_MS = 5000;
+    void setChunkTimeout(int ms) { chunkTimeoutMs = ms; }
+    int getChunkTimeout() const { return chunkTimeoutMs; }
 
     // High level operations
-    std::vector<TrackInfo> listTracks();
+    // Queries every slot, the ones in `order` first (e.g. the rows on screen).
+    // `onTrack` sees each slot as soon as it is read; the result is sorted by slot.
+    std::vector<TrackInfo> listTracks(const std::vector<int>& order = std::vector<int>(),
+                                      const std::function<void(const TrackInfo&)>& onTrack = nullptr);
+    // Header query of one slot; answered is cleared when no reply arrived at all, which
+    // otherwise reads the same as an empty slot
+    TrackInfo queryTrack(int slot, bool* answered = nullptr);
     void deleteTrack(int slot);
     void playTrack(int slot);
     void stopPlayback(int slot);
 
     // Callbacks for progress
     typedef void (*ProgressCallback)(size_t current, size_t total, void* userData);
+    // Receives each raw 1 KB chunk as it arrives; return false to stop reading
+    typedef std::function<bool(int chunk, int totalChunks, const QByteArray& data)> ChunkCallback;
+    // Supplies the next packed chunk (up to 1 KB) to upload; an empty array aborts the upload
+    typedef std::function<QByteArray()> ChunkSource;
+
+    // Reads chunks [startChunk, last] of a slot. Returns false if the slot is empty; throws
+    // if a chunk never arrives, so a completed call without stopFlag delivered every chunk.
+    bool readTrackChunks(int slot, const ChunkCallback& chunkCallback, int startChunk = 1,
+                         const std::atomic<bool>* stopFlag = nullptr, uint32_t* trackSize = nullptr);
+
+    // Chunk 1 of a slot (padded to 1 KB), or empty if the slot is empty
+    QByteArray readFirstChunk(int slot);
 
     // Download/Upload
     std::vector<int32_t> downloadTrack(int slot, ProgressCallback callback = nullptr, void* userData = nullptr);
+    // Packed 24-bit stereo bytes exactly as stored on the device, trimmed to the track size
+    QByteArray downloadTrackRaw(int slot, ProgressCallback callback = nullptr, void* userData = nullptr);
     void uploadTrack(int slot, const std::vector<int32_t>& audio, ProgressCallback callback = nullptr, void* userData = nullptr);
+    // Uploads an already packed 24-bit stereo stream (e.g. a memory-mapped cache blob)
+    void uploadTrackRaw(int slot, const QByteArray& audioData, ProgressCallback callback = nullptr, void* userData = nullptr);
+    // Uploads `size` packed bytes pulled chunk by chunk, e.g. straight from another pedal
+    void uploadTrackChunks(int slot, uint32_t size, const ChunkSource& nextChunk,
+                           ProgressCallback callback = nullptr, void* userData = nullptr);
 
     // Streaming
     // This needs a specialized loop
@@ -51,14 +96,22 @@ public:
                         ProgressCallback progressCallback = nullptr, void* progressUserData = nullptr, int startChunk = 1);
 
 private:
-    libusb_context* ctx;
-    libusb_device_handle* dev_handle;
+    libusb_device_handle* dev_handle;  // Opened on the shared UsbContext
+    std::unique_ptr<Transport> transport;
     bool connected;
     uint8_t connectedBus;
     uint8_t connectedAddress;
+    std::string connectedSerial;
+    int chunkTimeoutMs;
 
-    int write(const QByteArray& data, int endpoint = Protocol::EP_OUT, int timeout = 5000);
-    QByteArray read(int size, int endpoint = Protocol::EP_IN_DATA, int timeout = 5000);
+    void markOp(const std::string& op);
+    // Wraps the transport with metrics and, if requested, trace capture
+    void instrument();
+    int write(const QByteArray& data, int endpoint = Protocol::EP_OUT, int timeout = DEFAULT_TIMEOUT_MS);
+    QByteArray read(int size, int endpoint = Protocol::EP_IN_DATA, int timeout = DEFAULT_TIMEOUT_MS);
+    // After a chunk read timed out: drops late replies until a fresh header of `slot` comes back.
+    // False if it doesn't by `deadline`.
+    bool resyncChunkReads(int slot, uint32_t size, std::chrono::steady_clock::time_point deadline);
 };
 
 #endif // USB_DEVICE_H
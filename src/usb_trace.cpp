@@ -0,0 +1,180 @@
+#include "usb_trace.h"
+#include "protocol.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QtEndian>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+const char MAGIC[8] = {'M', 'O', 'O', 'T', 'R', 'A', 'C', 'E'};
+
+template <typename T>
+void put(QByteArray& out, T value) {
+    uchar buf[sizeof(T)];
+    qToLittleEndian<T>(value, buf);
+    out.append(reinterpret_cast<const char*>(buf), sizeof(T));
+}
+
+template <typename T>
+bool take(const QByteArray& in, qint64& pos, T& value) {
+    if (pos + (qint64)sizeof(T) > in.size()) return false;
+    value = qFromLittleEndian<T>(reinterpret_cast<const uchar*>(in.constData() + pos));
+    pos += sizeof(T);
+    return true;
+}
+}
+
+bool UsbTrace::read(const QString& path, std::vector<TraceRecord>& records) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QByteArray in = file.readAll();
+
+    if (in.size() < 12 || memcmp(in.constData(), MAGIC, 8) != 0) return false;
+    qint64 pos = 8;
+    uint32_t version = 0;
+    take(in, pos, version);
+    if (version != VERSION) return false;
+
+    while (pos < in.size()) {
+        TraceRecord r;
+        r.kind = static_cast<TraceRecord::Kind>(in[pos++]);
+        if (r.kind == TraceRecord::Transfer) {
+            uint32_t n = 0;
+            if (!take(in, pos, r.startUs) || !take(in, pos, r.durationUs) || !take(in, pos, r.endpoint) ||
+                !take(in, pos, r.result) || !take(in, pos, r.length) || !take(in, pos, r.timeout) ||
+                !take(in, pos, n) || pos + n > in.size()) {
+                break; // Truncated tail, e.g. the app was killed while recording
+            }
+            r.payload = in.mid(pos, n);
+            pos += n;
+        } else if (r.kind == TraceRecord::Marker) {
+            uint16_t n = 0;
+            if (!take(in, pos, r.startUs) || !take(in, pos, n) || pos + n > in.size()) break;
+            r.payload = in.mid(pos, n);
+            pos += n;
+        } else {
+            std::cerr << "Unknown trace record at offset " << pos - 1 << std::endl;
+            return false;
+        }
+        records.push_back(r);
+    }
+    return true;
+}
+
+QString UsbTrace::capturePath(const std::string& serial) {
+    const char* env = getenv("MOOER_USB_TRACE");
+    if (!env || !*env) return QString();
+
+    QString path = QString::fromLocal8Bit(env);
+    if (QFileInfo(path).isDir()) {
+        QString name = serial.empty() ? QString("pedal") : QString::fromStdString(serial);
+        path = QDir(path).filePath(QString("%1-%2.mtrace")
+            .arg(name).arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")));
+    }
+    return path;
+}
+
+RecordingTransport::RecordingTransport(std::unique_ptr<Transport> inner, const QString& path)
+    : inner(std::move(inner)), file(path), origin(std::chrono::steady_clock::now()) {
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        std::cerr << "Cannot open USB trace " << path.toStdString() << std::endl;
+        return;
+    }
+    QByteArray header(MAGIC, 8);
+    put<uint32_t>(header, UsbTrace::VERSION);
+    file.write(header);
+}
+
+RecordingTransport::~RecordingTransport() {
+    if (file.isOpen()) file.close();
+}
+
+uint64_t RecordingTransport::nowUs() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void RecordingTransport::writeRecord(const TraceRecord& r) {
+    if (!file.isOpen()) return;
+
+    QByteArray out;
+    out.reserve(32 + r.payload.size());
+    out.append(static_cast<char>(r.kind));
+    put<uint64_t>(out, r.startUs);
+    if (r.kind == TraceRecord::Transfer) {
+        put<uint32_t>(out, r.durationUs);
+        put<uint8_t>(out, r.endpoint);
+        put<int32_t>(out, r.result);
+        put<uint32_t>(out, r.length);
+        put<uint32_t>(out, r.timeout);
+        put<uint32_t>(out, r.payload.size());
+    } else {
+        put<uint16_t>(out, r.payload.size());
+    }
+    out.append(r.payload);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file.write(out);
+}
+
+int RecordingTransport::transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) {
+    TraceRecord r;
+    r.startUs = nowUs();
+    int result = inner->transfer(endpoint, data, length, transferred, timeout);
+    r.durationUs = static_cast<uint32_t>(nowUs() - r.startUs);
+    r.endpoint = endpoint;
+    r.result = result;
+    r.length = length;
+    r.timeout = timeout;
+
+    int n = (endpoint & LIBUSB_ENDPOINT_IN) ? (result == 0 || result == LIBUSB_ERROR_TIMEOUT ? *transferred : 0) : length;
+    r.payload = QByteArray(reinterpret_cast<const char*>(data), n);
+    writeRecord(r);
+    return result;
+}
+
+void RecordingTransport::mark(const std::string& op) {
+    TraceRecord r;
+    r.kind = TraceRecord::Marker;
+    r.startUs = nowUs();
+    r.payload = QByteArray::fromStdString(op).left(0xFFFF);
+    writeRecord(r);
+    inner->mark(op);
+}
+
+ReplayTransport::ReplayTransport(const std::vector<TraceRecord>& records) : mismatchCount(0), missingCount(0) {
+    for (const TraceRecord& r : records) {
+        if (r.kind == TraceRecord::Transfer) byEndpoint[r.endpoint].push_back(r);
+    }
+}
+
+int ReplayTransport::transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) {
+    Q_UNUSED(timeout);
+    *transferred = 0;
+
+    auto& queue = byEndpoint[endpoint];
+    if (queue.empty()) {
+        missingCount++;
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+    TraceRecord r = queue.front();
+    queue.pop_front();
+
+    std::this_thread::sleep_for(std::chrono::microseconds(r.durationUs));
+
+    if (endpoint & LIBUSB_ENDPOINT_IN) {
+        int n = std::min<int>(length, r.payload.size());
+        memcpy(data, r.payload.constData(), n);
+        *transferred = n;
+    } else {
+        // Only commands are compared; uploaded audio legitimately differs between runs
+        if (endpoint == Protocol::EP_OUT && QByteArray(reinterpret_cast<const char*>(data), length) != r.payload) {
+            mismatchCount++;
+        }
+        *transferred = (r.result == 0) ? length : 0;
+    }
+    return r.result;
+}
@@ -0,0 +1,92 @@
+#ifndef USB_TRACE_H
+#define USB_TRACE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "transport.h"
+
+// Binary trace of a USB session: every transfer with endpoint, payload, result and timing,
+// plus op markers ("read 3 1", "upload 5 123456", ...) written by USBDevice at each operation.
+//
+// File: "MOOTRACE" + u32 version, then records, all little endian:
+//   'T' u64 startUs, u32 durationUs, u8 endpoint, i32 result, u32 length, u32 timeout, u32 n, n payload bytes
+//   'M' u64 startUs, u16 n, n bytes of text
+// The payload is what was sent (OUT) or received (IN).
+struct TraceRecord {
+    enum Kind : char { Transfer = 'T', Marker = 'M' };
+    Kind kind = Transfer;
+    uint64_t startUs = 0;
+    uint32_t durationUs = 0;
+    uint8_t endpoint = 0;
+    int32_t result = 0;
+    uint32_t length = 0;
+    uint32_t timeout = 0;
+    QByteArray payload; // Transfer payload, or marker text
+};
+
+class UsbTrace {
+public:
+    static const uint32_t VERSION = 1;
+
+    static bool read(const QString& path, std::vector<TraceRecord>& records);
+    // MOOER_USB_TRACE: a file, or a directory that gets one <serial>-<time>.mtrace per connection
+    static QString capturePath(const std::string& serial);
+};
+
+// Forwards to another transport and appends each transfer to a trace file
+class RecordingTransport : public Transport {
+public:
+    RecordingTransport(std::unique_ptr<Transport> inner, const QString& path);
+    ~RecordingTransport() override;
+
+    bool isOpen() const { return file.isOpen(); }
+
+    int transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) override;
+    void settle(std::chrono::milliseconds duration) override { inner->settle(duration); }
+    void mark(const std::string& op) override;
+
+private:
+    std::unique_ptr<Transport> inner;
+    QFile file;
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point origin;
+
+    uint64_t nowUs() const;
+    void writeRecord(const TraceRecord& record);
+};
+
+// Serves a recorded session: IN transfers return the recorded payloads and every transfer
+// takes as long as it did originally. Records are matched in order per endpoint, so an
+// engine that reorders its commands across endpoints can still be replayed. The pedal's
+// settle waits are only added up, not slept, so they don't drown out the I/O time.
+class ReplayTransport : public Transport {
+public:
+    explicit ReplayTransport(const std::vector<TraceRecord>& records);
+
+    int transfer(int endpoint, unsigned char* data, int length, int* transferred, unsigned int timeout) override;
+    void settle(std::chrono::milliseconds duration) override { settledTotal += duration; }
+
+    // Settle time the engine asked for so far
+    std::chrono::milliseconds settled() const { return settledTotal; }
+
+    // Commands that differ from the recording, and transfers with no recorded counterpart
+    uint64_t mismatches() const { return mismatchCount; }
+    uint64_t missing() const { return missingCount; }
+
+private:
+    std::map<int, std::deque<TraceRecord>> byEndpoint;
+    uint64_t mismatchCount;
+    uint64_t missingCount;
+    std::chrono::milliseconds settledTotal{0};
+};
+
+#endif // USB_TRACE_H
@@ -1,11 +1,17 @@
 #include "worker.h"
-#include "audio_utils.h"
-#include <portaudio.h>
+#include "operations.h"
+#include "playback.h"
+#include "trace_events.h"
+#include "metrics.h"
+#include <chrono>
+#include <iostream>
 
 Worker::Worker(USBDevice* dev, Op op, int slot, std::string filename,
                double trackDuration, std::atomic<int>* volumePtr, double startOffset)
     : device(dev), operation(op), slot(slot), filename(filename),
-      trackDuration(trackDuration), volume(volumePtr), startOffset(startOffset), stopFlag(false)
+      trackDuration(trackDuration), volume(volumePtr), startOffset(startOffset),
+      trackSize(0), outputFormat(AudioUtils::Wav24),
+      cloneTarget(nullptr), cloneSlot(-1), quick(false), connectBus(0), connectAddress(0), stopFlag(false)
 {
 }
 
@@ -17,92 +23,121 @@ Worker::Op Worker::getOperation() const {
     return operation; 
 }
 
+std::vector<int> Worker::affectedSlots() const {
+    std::vector<int> slots;
+    if (operation == Upload || operation == Delete) {
+        slots.push_back(slot);
+    } else if (operation == Reorder) {
+        for (int d = 0; d < (int)arrangement.size(); d++) {
+            if (arrangement[d] != d) slots.push_back(d);
+        }
+    }
+    return slots;
+}
+
 void Worker::run() {
+    static const char* const opNames[] = {"List", "Download", "Upload", "Delete", "Play", "Clone", "Reorder", "Benchmark", "Query", "Connect"};
+    TraceEvents::setThreadName("Worker");
+    MOOER_TRACE_SCOPE("worker", opNames[operation], slot);
     try {
         if (operation == List) {
-            auto tracks = device->listTracks();
-            emit tracksLoaded(tracks);
+            emit tracksLoaded(listSlots());
+        } else if (operation == Connect) {
+            runConnect();
+        } else if (operation == Query) {
+            // A slot that did not answer keeps its row: no reply is not an empty slot
+            std::vector<TrackInfo> tracks;
+            std::vector<int> unanswered;
+            for (int s : querySlots) {
+                bool answered = false;
+                TrackInfo t = device->queryTrack(s, &answered);
+                if (answered) tracks.push_back(t);
+                else unanswered.push_back(s);
+            }
+            emit tracksUpdated(tracks);
+            if (!unanswered.empty()) {
+                throw std::runtime_error("The pedal did not answer for slot " + std::to_string(unanswered.front()) +
+                                         "; the track list may be out of date. Refresh to re-read it.");
+            }
         } else if (operation == Download) {
-            auto callback = [](size_t c, size_t t, void* u) {
-                static_cast<Worker*>(u)->emit progress(c, t);
-            };
-            auto data = device->downloadTrack(slot, callback, this);
-            AudioUtils::saveWavFile(filename, data);
+            Operations::download(*device, slot, filename, outputFormat, ProgressTracker::callback, &tracker);
         } else if (operation == Upload) {
-            auto audio = AudioUtils::loadAudioFile(filename);
-            auto callback = [](size_t c, size_t t, void* u) {
-                static_cast<Worker*>(u)->emit progress(c, t);
-            };
-            device->uploadTrack(slot, audio, callback, this);
+            Operations::upload(*device, slot, filename, ProgressTracker::callback, &tracker);
         } else if (operation == Delete) {
-            device->deleteTrack(slot);
+            Operations::remove(*device, slot);
+        } else if (operation == Clone) {
+            if (!cloneTarget) throw std::runtime_error("No clone target");
+            Operations::clone(*device, slot, *cloneTarget, cloneSlot, &stopFlag, ProgressTracker::callback, &tracker);
+        } else if (operation == Reorder) {
+            Operations::reorder(*device, arrangement, &stopFlag, ProgressTracker::callback, &tracker);
+        } else if (operation == Benchmark) {
+            emit linkMeasured(LinkProfile::measure(*device, quick, ProgressTracker::callback, &tracker));
         } else if (operation == Play) {
-             PaStream *stream;
-             PaError err = Pa_OpenDefaultStream( &stream,
-                                         0,          /* no input channels */
-                                         2,          /* stereo output */
-                                         paInt32,    /* 32 bit output */
-                                         44100,
-                                         256,
-                                         NULL,
-                                         NULL );
-
-             if (err != paNoError) {
-                 emit error(QString("PortAudio OpenStream error: %1").arg(Pa_GetErrorText(err)));
-                 return;
-             }
-
-             err = Pa_StartStream( stream );
-             if (err != paNoError) {
-                 Pa_CloseStream( stream );
-                 emit error(QString("PortAudio StartStream error: %1").arg(Pa_GetErrorText(err)));
-                 return;
-             }
-
-             auto callback = [&](const std::vector<int32_t>& samples) {
-                 if (stopFlag) return;
-                 if (samples.empty()) return;
-                 int vol = volume ? volume->load() : 100;
-                 if (vol == 100) {
-                     Pa_WriteStream( stream, samples.data(), samples.size() / 2 );
-                 } else {
-                     std::vector<int32_t> scaled(samples.size());
-                     double scale = vol / 100.0;
-                     for (size_t i = 0; i < samples.size(); i++) {
-                         double s = static_cast<double>(samples[i]) * scale;
-                         if (s > INT32_MAX) s = INT32_MAX;
-                         if (s < INT32_MIN) s = INT32_MIN;
-                         scaled[i] = static_cast<int32_t>(s);
-                     }
-                     Pa_WriteStream( stream, scaled.data(), scaled.size() / 2 );
-                 }
-             };
-
-             auto progressCb = [](size_t c, size_t t, void* u) {
-                 static_cast<Worker*>(u)->emit progress(static_cast<int>(c), static_cast<int>(t));
-             };
-
-             // Calculate start chunk
-             // trackDuration is in seconds
-             // Total bytes = trackDuration * 44100 * 6
-             // Total chunks = Total bytes / 1024
-             // startChunk = (startOffset / trackDuration) * Total chunks
-             int startChunk = 1;
-             if (trackDuration > 0 && startOffset > 0) {
-                 // More precise:
-                 // bytesOffset = startOffset * 44100 * 6
-                 // chunkOffset = bytesOffset / 1024
-                 double bytesOffset = startOffset * 44100.0 * 6.0;
-                 startChunk = static_cast<int>(bytesOffset / 1024.0) + 1;
-             }
-
-             device->startStreaming(slot, callback, stopFlag, progressCb, this, startChunk);
-
-             Pa_StopStream( stream );
-             Pa_CloseStream( stream );
+            Playback::play(*device, slot, trackSize, trackDuration, startOffset, stopFlag, volume,
+                           ProgressTracker::callback, &tracker, &clock);
         }
         emit finished();
     } catch (const std::exception& e) {
         emit error(QString(e.what()));
     }
 }
+
+std::vector<TrackInfo> Worker::listSlots(const std::function<void()>& checkpoint) {
+    // Each slot is published as it arrives; tracksLoaded still delivers the full list
+    if (checkpoint) checkpoint();
+    int count = 0;
+    return device->listTracks(querySlots, [this, &count, &checkpoint](const TrackInfo& t) {
+        listed.push(t);
+        tracker.update(++count, Protocol::MAX_TRACKS);
+        if (checkpoint) checkpoint();
+    });
+}
+
+void Worker::runConnect() {
+    // Open and claim -> optional link probe -> first listing. Cancellation and the budget are
+    // checked between steps, probe round trips and slots; a libusb call already running ends
+    // on its own timeout. A cancelled Connect is not waited for, see MainWindow::closeSession.
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point started = Clock::now();
+    auto elapsedUs = [&started]() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count();
+    };
+    const char* step = "opening the pedal";
+    auto checkpoint = [&]() {
+        if (stopFlag) throw std::runtime_error("Connect cancelled");
+        if (elapsedUs() > CONNECT_BUDGET_MS * 1000LL) {
+            throw std::runtime_error(std::string("Connect timed out while ") + step);
+        }
+    };
+
+    if (!device->connect(connectBus, connectAddress)) throw std::runtime_error("Failed to connect");
+    int64_t openUs = elapsedUs();
+    try {
+        checkpoint();
+        if (quick) {
+            step = "measuring the link";
+            emit phaseChanged("Measuring link...");
+            try {
+                emit linkMeasured(LinkProfile::measure(*device, true, nullptr, nullptr, checkpoint));
+            } catch (const std::exception& e) {
+                // Cancelled or out of budget: give up the connect
+                checkpoint();
+                // The saved timeouts stay in effect; the pedal is still usable
+                std::cerr << "Link probe failed: " << e.what() << std::endl;
+            }
+        }
+        step = "listing tracks";
+        emit phaseChanged("Listing tracks...");
+        std::vector<TrackInfo> tracks = listSlots(checkpoint);
+        emit tracksLoaded(tracks);
+    } catch (...) {
+        device->disconnect();
+        throw;
+    }
+
+    int64_t readyUs = elapsedUs();
+    Metrics::histogram("mooer_connect_latency_us", "phase=\"open\"").record(openUs);
+    Metrics::histogram("mooer_connect_latency_us", "phase=\"ready\"").record(readyUs);
+    std::cerr << "Connected to " << (device->getSerial().empty() ? "pedal" : device->getSerial()) << ": ready in "
+              << readyUs / 1000 << " ms (open " << openUs / 1000 << " ms)" << std::endl;
+}
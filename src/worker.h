@@ -6,12 +6,21 @@
 #include <string>
 #include <vector>
 #include <atomic>
+#include <functional>
 #include "usb_device.h"
+#include "audio_utils.h"
+#include "progress_tracker.h"
+#include "link_profile.h"
+#include "playback.h"
+#include "spsc_queue.h"
 
 class Worker : public QThread {
     Q_OBJECT
 public:
-    enum Op { List, Download, Upload, Delete, Play };
+    enum Op { List, Download, Upload, Delete, Play, Clone, Reorder, Benchmark, Query, Connect };
+
+    // Connect gives up once open, claim, probe and the first listing together take longer
+    static constexpr int CONNECT_BUDGET_MS = 15000;
 
     Worker(USBDevice* dev, Op op, int slot = -1, std::string filename = "",
            double trackDuration = 0.0, std::atomic<int>* volumePtr = nullptr, double startOffset = 0.0);
@@ -20,17 +29,49 @@ public:
 
     void stop();
     Op getOperation() const;
+    int getSlot() const { return slot; }
+    int getCloneSlot() const { return cloneSlot; }
+    // Slots of this worker's pedal the operation may have rewritten, even if it failed
+    std::vector<int> affectedSlots() const;
+    void setOutputFormat(AudioUtils::OutputFormat format) { outputFormat = format; }
+    // Listed size of the slot; lets playback use a current local mirror
+    void setTrackSize(uint32_t size) { trackSize = size; }
+    // Clone copies `slot` of this worker's device into `targetSlot` of `target`
+    void setCloneTarget(USBDevice* target, int targetSlot) { cloneTarget = target; cloneSlot = targetSlot; }
+    // Reorder rearranges the pedal so slot d ends up holding the current track of source[d]
+    void setArrangement(const std::vector<int>& source) { arrangement = source; }
+    // Query re-reads just these slot headers; List reads them first
+    void setQuerySlots(const std::vector<int>& slots) { querySlots = slots; }
+    // Connect opens and claims this pedal, then lists it (List's slot order applies)
+    void setConnectTarget(uint8_t bus, uint8_t address) { connectBus = bus; connectAddress = address; }
+    // Benchmark measures round trips only; Connect runs that probe before listing
+    void setQuick(bool q) { quick = q; }
+    bool isQuick() const { return quick; }
+    // Polled by the UI: bytes for transfers, chunks for playback, steps for reorder
+    const ProgressTracker& progress() const { return tracker; }
+    // Audible position of a running Play, read by the transport at display rate
+    const PlaybackClock& playbackClock() const { return clock; }
+    // Slots a running List or Connect has read so far, for the UI thread to drain
+    bool takeListed(TrackInfo& track) { return listed.pop(track); }
 
 signals:
     void finished();
     void error(QString msg);
     void tracksLoaded(std::vector<TrackInfo> tracks);
-    void progress(int current, int total);
+    // Partial listing: only the queried slots
+    void tracksUpdated(std::vector<TrackInfo> tracks);
+    void linkMeasured(LinkProfile profile);
+    // Connect moved to its next step ("Listing tracks...")
+    void phaseChanged(QString text);
 
 protected:
     void run() override;
 
 private:
+    // Reads every slot, querySlots first, into `listed`; `checkpoint` runs before each slot
+    std::vector<TrackInfo> listSlots(const std::function<void()>& checkpoint = nullptr);
+    void runConnect();
+
     USBDevice* device;
     Op operation;
     int slot;
@@ -38,7 +79,19 @@ private:
     double trackDuration;
     std::atomic<int>* volume;
     double startOffset;
+    uint32_t trackSize;
+    AudioUtils::OutputFormat outputFormat;
+    USBDevice* cloneTarget;
+    int cloneSlot;
+    std::vector<int> arrangement;
+    std::vector<int> querySlots;
+    bool quick;
+    uint8_t connectBus;
+    uint8_t connectAddress;
     std::atomic<bool> stopFlag;
+    ProgressTracker tracker;
+    PlaybackClock clock;
+    SpscQueue<TrackInfo, Protocol::MAX_TRACKS> listed;  // Room for a full listing, so push never fails
 };
 
 #endif // WORKER_H
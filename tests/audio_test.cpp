@@ -0,0 +1,70 @@
+// Round trips of downloaded audio back into the upload path. Run by ctest; exits non-zero
+// and names the failed check otherwise.
+//   audio_test
+
+#include "audio_utils.h"
+#include "protocol.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+int failures = 0;
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+// Arbitrary packed frames, covering full scale and negative samples
+QByteArray randomPacked(int frames, uint32_t seed) {
+    std::mt19937 rng(seed);
+    QByteArray packed(frames * 6, 0);
+    for (char& byte : packed) byte = static_cast<char>(rng() & 0xFF);
+    return packed;
+}
+
+void testWav24RoundTrip() {
+    // A 24-bit download re-uploaded must reach the pedal bit for bit, not 48 dB quieter
+    QTemporaryDir dir;
+    std::string path = QDir(dir.path()).filePath("slot.wav").toStdString();
+    QByteArray packed = randomPacked(10000, 1);
+    packed[0] = (char)0xFF; packed[1] = (char)0xFF; packed[2] = 0x7F;  // Full scale positive
+    packed[3] = 0x00; packed[4] = 0x00; packed[5] = (char)0x80;  // Full scale negative
+
+    CHECK(AudioUtils::savePackedAudio(path, packed, AudioUtils::Wav24));
+    std::vector<int32_t> samples = AudioUtils::loadAudioFile(path);
+    CHECK(samples.size() == 20000);
+    CHECK(Protocol::encodeAudioData(samples) == packed);
+}
+
+void testWav32RoundTrip() {
+    QTemporaryDir dir;
+    std::string path = QDir(dir.path()).filePath("slot.wav").toStdString();
+    QByteArray packed = randomPacked(10000, 2);
+
+    CHECK(AudioUtils::savePackedAudio(path, packed, AudioUtils::Wav32));
+    CHECK(Protocol::encodeAudioData(AudioUtils::loadAudioFile(path)) == packed);
+}
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    testWav24RoundTrip();
+    testWav32RoundTrip();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,367 @@
+// Checks the FLAC writer against an independent reading of the format: STREAMINFO, frame
+// headers, CRC-8/CRC-16 and every decoded sample, plus the MD5 of a fixed input. With
+// libFLAC available the file is also decoded by the reference decoder.
+// Run by ctest; exits non-zero and names the failed check otherwise.
+//   flac_test
+
+#include "audio_utils.h"
+#include "flac_encoder.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef MOOER_HAVE_LIBFLAC
+#include <FLAC/stream_decoder.h>
+#endif
+
+namespace {
+int failures = 0;
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+const int FRAMES = 3 * FlacEncoder::BLOCK_SIZE + 1000;  // Short last block
+// MD5 of packedInput(), computed outside the code under test
+const char* INPUT_MD5 = "630d54a506c9204f32b4d871460674cb";
+
+// Block 0 silent, block 1 a smooth wave, block 2 identical noise on both channels,
+// the rest noise against the wave: constant, fixed and verbatim subframes in every stereo mode
+std::vector<uint8_t> packedInput() {
+    std::vector<uint8_t> packed;
+    uint32_t x = 1;
+    for (int i = 0; i < FRAMES; i++) {
+        int block = i / FlacEncoder::BLOCK_SIZE;
+        int t = i % 512;
+        int32_t wave = (t < 256 ? t : 511 - t) * 32768 - 4194304;
+        int32_t left = 0, right = 0;
+        if (block == 1) {
+            left = wave;
+            right = -(left >> 1);
+        } else if (block >= 2) {
+            x = x * 1103515245u + 12345u;
+            int32_t v = static_cast<int32_t>(x >> 8);
+            left = v >= 8388608 ? v - 16777216 : v;
+            right = block == 2 ? left : wave;
+        }
+        for (int32_t v : {left, right}) {
+            packed.push_back(static_cast<uint8_t>(v));
+            packed.push_back(static_cast<uint8_t>(v >> 8));
+            packed.push_back(static_cast<uint8_t>(v >> 16));
+        }
+    }
+    return packed;
+}
+
+int32_t unpack24(const uint8_t* p) {
+    int32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v << 8) >> 8;
+}
+
+// Bitwise CRCs, independent of the encoder's tables
+uint8_t crc8(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+    }
+    return crc;
+}
+
+uint16_t crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+    }
+    return crc;
+}
+
+class BitReader {
+public:
+    BitReader(const std::vector<uint8_t>& data, size_t byte) : data(data), bit(byte * 8) {}
+
+    uint64_t read(int count) {
+        uint64_t v = 0;
+        for (int i = 0; i < count; i++) {
+            if (bit / 8 >= data.size()) throw std::runtime_error("Read past the end of the file");
+            v = (v << 1) | ((data[bit / 8] >> (7 - bit % 8)) & 1);
+            bit++;
+        }
+        return v;
+    }
+
+    int64_t readSigned(int count) {
+        uint64_t v = read(count);
+        return (v & (1ull << (count - 1))) ? static_cast<int64_t>(v) - (1ll << count) : static_cast<int64_t>(v);
+    }
+
+    int64_t readRice(int k) {
+        uint64_t zeros = 0;
+        while (read(1) == 0) zeros++;
+        uint64_t folded = (zeros << k) | read(k);
+        return static_cast<int64_t>(folded >> 1) ^ -static_cast<int64_t>(folded & 1);
+    }
+
+    void alignToByte() { bit = (bit + 7) / 8 * 8; }
+    size_t byte() const { return bit / 8; }
+
+private:
+    const std::vector<uint8_t>& data;
+    size_t bit;
+};
+
+std::vector<int64_t> readSubframe(BitReader& in, int n, int bps) {
+    CHECK(in.read(1) == 0);
+    int type = static_cast<int>(in.read(6));
+    CHECK(in.read(1) == 0);  // No wasted bits
+
+    std::vector<int64_t> x(n);
+    if (type == 0) {
+        int64_t v = in.readSigned(bps);
+        for (auto& s : x) s = v;
+        return x;
+    }
+    if (type == 1) {
+        for (auto& s : x) s = in.readSigned(bps);
+        return x;
+    }
+    if (type < 8 || type > 12) throw std::runtime_error("Unexpected subframe type " + std::to_string(type));
+
+    int order = type - 8;
+    for (int i = 0; i < order; i++) x[i] = in.readSigned(bps);
+
+    int method = static_cast<int>(in.read(2));
+    CHECK(method <= 1);
+    int paramBits = method == 0 ? 4 : 5;
+    int partitionOrder = static_cast<int>(in.read(4));
+    int partLen = n >> partitionOrder;
+    int i = order;
+    for (int p = 0; p < (1 << partitionOrder); p++) {
+        int end = (p + 1) * partLen;
+        int k = static_cast<int>(in.read(paramBits));
+        if (k == (1 << paramBits) - 1) {
+            int raw = static_cast<int>(in.read(5));
+            for (; i < end; i++) x[i] = raw ? in.readSigned(raw) : 0;
+        } else {
+            for (; i < end; i++) x[i] = in.readRice(k);
+        }
+    }
+
+    static const int COEFFS[5][4] = {{0, 0, 0, 0}, {1, 0, 0, 0}, {2, -1, 0, 0}, {3, -3, 1, 0}, {4, -6, 4, -1}};
+    for (int j = order; j < n; j++) {
+        int64_t prediction = 0;
+        for (int c = 0; c < order; c++) prediction += COEFFS[order][c] * x[j - 1 - c];
+        x[j] += prediction;
+    }
+    return x;
+}
+
+struct Decoded {
+    std::vector<int32_t> samples;  // Interleaved L/R
+    uint32_t minFrameSize = UINT32_MAX;
+    uint32_t maxFrameSize = 0;
+};
+
+// Walks every frame after the metadata, checking headers and CRCs, and reconstructs the samples
+Decoded readFrames(const std::vector<uint8_t>& file, size_t pos) {
+    Decoded decoded;
+    for (uint32_t frameNumber = 0; pos < file.size(); frameNumber++) {
+        size_t start = pos;
+        CHECK(file[pos] == 0xFF && file[pos + 1] == 0xF8);
+        int bsCode = file[pos + 2] >> 4;
+        CHECK((file[pos + 2] & 0x0F) == 0x9);  // 44.1 kHz
+        int assignment = file[pos + 3] >> 4;
+        CHECK(((file[pos + 3] >> 1) & 0x7) == 0x6);  // 24 bits
+        CHECK((file[pos + 3] & 1) == 0);
+        pos += 4;
+
+        // UTF-8 coded frame number
+        uint32_t number = file[pos];
+        int extra = 0;
+        if (number >= 0x80) {
+            while (number & (0x40 >> extra)) extra++;
+            number &= 0x3F >> extra;
+            for (int i = 1; i <= extra; i++) number = (number << 6) | (file[pos + i] & 0x3F);
+        }
+        CHECK(number == frameNumber);
+        pos += 1 + extra;
+
+        int n = 0;
+        if (bsCode >= 8) n = 256 << (bsCode - 8);
+        else if (bsCode == 6) n = file[pos++] + 1;
+        else if (bsCode == 7) { n = ((file[pos] << 8) | file[pos + 1]) + 1; pos += 2; }
+        CHECK(n > 0);
+        CHECK(file[pos] == crc8(file.data() + start, pos - start));
+        pos++;
+
+        BitReader in(file, pos);
+        std::vector<int64_t> a = readSubframe(in, n, assignment == 0x9 ? 25 : 24);
+        std::vector<int64_t> b = readSubframe(in, n, assignment == 0x8 || assignment == 0xA ? 25 : 24);
+        in.alignToByte();
+        pos = in.byte();
+        CHECK(((file[pos] << 8) | file[pos + 1]) == crc16(file.data() + start, pos - start));
+        pos += 2;
+
+        for (int i = 0; i < n; i++) {
+            int64_t left = a[i], right = b[i];
+            if (assignment == 0x8) right = a[i] - b[i];
+            else if (assignment == 0x9) left = a[i] + b[i];
+            else if (assignment == 0xA) {
+                int64_t mid = (a[i] << 1) | (b[i] & 1);
+                left = (mid + b[i]) >> 1;
+                right = (mid - b[i]) >> 1;
+            } else {
+                CHECK(assignment == 0x1);
+            }
+            decoded.samples.push_back(static_cast<int32_t>(left));
+            decoded.samples.push_back(static_cast<int32_t>(right));
+        }
+
+        uint32_t frameSize = static_cast<uint32_t>(pos - start);
+        decoded.minFrameSize = std::min(decoded.minFrameSize, frameSize);
+        decoded.maxFrameSize = std::max(decoded.maxFrameSize, frameSize);
+    }
+    return decoded;
+}
+
+std::string hex(const uint8_t* data, size_t len) {
+    static const char* digits = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < len; i++) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 0xF];
+    }
+    return out;
+}
+
+#ifdef MOOER_HAVE_LIBFLAC
+struct ReferenceDecode {
+    const std::vector<uint8_t>* file;
+    size_t pos = 0;
+    std::vector<int32_t> samples;
+    bool error = false;
+};
+
+std::vector<int32_t> decodeWithLibFlac(const std::vector<uint8_t>& file, bool& ok) {
+    ReferenceDecode state;
+    state.file = &file;
+    FLAC__StreamDecoder* decoder = FLAC__stream_decoder_new();
+    FLAC__stream_decoder_set_md5_checking(decoder, true);
+
+    auto read = [](const FLAC__StreamDecoder*, FLAC__byte buffer[], size_t* bytes, void* data) {
+        auto* s = static_cast<ReferenceDecode*>(data);
+        size_t n = std::min(*bytes, s->file->size() - s->pos);
+        std::copy(s->file->begin() + s->pos, s->file->begin() + s->pos + n, buffer);
+        s->pos += n;
+        *bytes = n;
+        return n ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE : FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+    };
+    auto write = [](const FLAC__StreamDecoder*, const FLAC__Frame* frame, const FLAC__int32* const buffer[], void* data) {
+        auto* s = static_cast<ReferenceDecode*>(data);
+        for (unsigned i = 0; i < frame->header.blocksize; i++) {
+            s->samples.push_back(buffer[0][i]);
+            s->samples.push_back(buffer[1][i]);
+        }
+        return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    };
+    auto error = [](const FLAC__StreamDecoder*, FLAC__StreamDecoderErrorStatus, void* data) {
+        static_cast<ReferenceDecode*>(data)->error = true;
+    };
+
+    ok = FLAC__stream_decoder_init_stream(decoder, read, nullptr, nullptr, nullptr, nullptr, write, nullptr, error,
+                                          &state) == FLAC__STREAM_DECODER_INIT_STATUS_OK &&
+         FLAC__stream_decoder_process_until_end_of_stream(decoder) && FLAC__stream_decoder_finish(decoder) &&
+         !state.error;
+    FLAC__stream_decoder_delete(decoder);
+    return state.samples;
+}
+#endif
+
+void testEncodedFile() {
+    std::vector<uint8_t> packed = packedInput();
+    std::vector<int32_t> expected;
+    for (size_t i = 0; i < packed.size(); i += 3) expected.push_back(unpack24(packed.data() + i));
+
+    QTemporaryDir dir;
+    std::string path = QDir(dir.path()).filePath("slot.flac").toStdString();
+    CHECK(AudioUtils::saveFlacFile(path, QByteArray(reinterpret_cast<const char*>(packed.data()), packed.size())));
+    std::ifstream stream(path, std::ios::binary);
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    if (file.size() < 42) {
+        CHECK(file.size() >= 42);
+        return;
+    }
+
+    // Marker and the only metadata block: STREAMINFO, 34 bytes, flagged last
+    CHECK(std::string(file.begin(), file.begin() + 4) == "fLaC");
+    CHECK(file[4] == 0x80 && file[5] == 0 && file[6] == 0 && file[7] == 34);
+    BitReader info(file, 8);
+    CHECK(info.read(16) == (uint64_t)FlacEncoder::BLOCK_SIZE);
+    CHECK(info.read(16) == (uint64_t)FlacEncoder::BLOCK_SIZE);
+    uint64_t minFrameSize = info.read(24);
+    uint64_t maxFrameSize = info.read(24);
+    CHECK(info.read(20) == 44100);
+    CHECK(info.read(3) == 1);   // Two channels
+    CHECK(info.read(5) == 23);  // 24 bits
+    CHECK(info.read(36) == (uint64_t)FRAMES);
+    CHECK(hex(file.data() + 26, 16) == INPUT_MD5);
+
+    Decoded decoded = readFrames(file, 42);
+    CHECK(decoded.samples == expected);
+    CHECK(decoded.minFrameSize == minFrameSize);
+    CHECK(decoded.maxFrameSize == maxFrameSize);
+
+#ifdef MOOER_HAVE_LIBFLAC
+    bool ok = false;
+    std::vector<int32_t> reference = decodeWithLibFlac(file, ok);
+    CHECK(ok);
+    CHECK(reference == expected);
+#endif
+}
+
+void testThreadsAgree() {
+    // Blocks split across workers must come out numbered and ordered as a single thread writes them
+    std::vector<uint8_t> packed = packedInput();
+    std::vector<uint8_t> single = FlacEncoder::encodePacked24(packed.data(), packed.size(), 44100, nullptr, 1);
+    for (int threads : {2, 3, 8}) {
+        CHECK(FlacEncoder::encodePacked24(packed.data(), packed.size(), 44100, nullptr, threads) == single);
+    }
+}
+
+void testEmpty() {
+    std::vector<uint8_t> file = FlacEncoder::encodePacked24(nullptr, 0);
+    CHECK(file.size() == 42);
+    CHECK(readFrames(file, 42).samples.empty());
+}
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    try {
+        testEncodedFile();
+        testThreadsAgree();
+        testEmpty();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        failures++;
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Table-driven checks of the slot rearrangement planner: the steps for each arrangement are
+// replayed on a model pedal, which must end up as requested with every moved track read once.
+// Run by ctest; exits non-zero and names the failed case otherwise.
+//   slot_planner_test
+
+#include "protocol.h"
+#include "slot_planner.h"
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+int failures = 0;
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+const int EMPTY = -1;
+
+std::vector<bool> occupiedSlots(int slotCount, const std::vector<int>& filled) {
+    std::vector<bool> occupied(slotCount, false);
+    for (int s : filled) occupied[s] = true;
+    return occupied;
+}
+
+std::vector<bool> allOccupied(int slotCount) {
+    return std::vector<bool>(slotCount, true);
+}
+
+// Replays the steps on a pedal whose slot s holds track s (or nothing); fails the case on any
+// read of an empty slot, a second stash, a lost stash or a track read more than once
+bool replay(const char* name, const std::vector<int>& source, const std::vector<bool>& occupied) {
+    int n = source.size();
+    std::vector<SlotPlanner::Step> steps = SlotPlanner::plan(source, occupied);
+
+    std::vector<int> pedal(n);
+    for (int s = 0; s < n; s++) pedal[s] = occupied[s] ? s : EMPTY;
+    std::vector<int> reads(n, 0);
+    int stash = EMPTY;
+    bool ok = true;
+    auto fail = [&](const std::string& why) {
+        fprintf(stderr, "%s: %s\n", name, why.c_str());
+        ok = false;
+    };
+
+    for (const SlotPlanner::Step& step : steps) {
+        switch (step.kind) {
+        case SlotPlanner::Step::Stash:
+            if (stash != EMPTY) fail("second track stashed");
+            if (pedal[step.from] == EMPTY) fail("stashed an empty slot");
+            else reads[pedal[step.from]]++;
+            stash = pedal[step.from];
+            break;
+        case SlotPlanner::Step::Copy:
+            if (pedal[step.from] == EMPTY) fail("copied an empty slot");
+            else reads[pedal[step.from]]++;
+            pedal[step.to] = pedal[step.from];
+            break;
+        case SlotPlanner::Step::Unstash:
+            if (stash == EMPTY) fail("unstash without a stashed track");
+            pedal[step.to] = stash;
+            stash = EMPTY;
+            break;
+        case SlotPlanner::Step::Clear:
+            pedal[step.to] = EMPTY;
+            break;
+        }
+    }
+    if (stash != EMPTY) fail("stashed track never written back");
+
+    for (int d = 0; d < n; d++) {
+        int expected = occupied[source[d]] ? source[d] : EMPTY;
+        if (pedal[d] != expected) {
+            fail("slot " + std::to_string(d) + " holds " + std::to_string(pedal[d]) + ", expected " +
+                 std::to_string(expected));
+        }
+        // Tracks that stay put are never touched; moved ones are read exactly once
+        int expectedReads = occupied[d] && source[d] != d ? 1 : 0;
+        if (reads[d] != expectedReads) {
+            fail("track " + std::to_string(d) + " read " + std::to_string(reads[d]) + " times");
+        }
+    }
+    return ok;
+}
+
+struct Case {
+    const char* name;
+    std::vector<int> source;
+    std::vector<bool> occupied;
+    size_t steps;  // Expected plan length
+};
+
+void testPlans() {
+    const int N = Protocol::MAX_TRACKS;
+    std::vector<int> longCycle(N);
+    for (int d = 0; d < N; d++) longCycle[d] = (d + 1) % N;
+
+    std::vector<Case> cases = {
+        {"identity, full pedal", SlotPlanner::moveRange(N, 5, 1, 5), allOccupied(N), 0},
+        {"identity, empty pedal", SlotPlanner::swapRanges(N, 0, 0, 1), occupiedSlots(N, {}), 0},
+        {"swap of two tracks", SlotPlanner::swapRanges(N, 2, 7, 1), occupiedSlots(N, {2, 7}), 3},
+        {"swap of a track with an empty slot", SlotPlanner::swapRanges(N, 2, 7, 1), occupiedSlots(N, {2}), 2},
+        {"swap of two empty slots", SlotPlanner::swapRanges(N, 2, 7, 1), occupiedSlots(N, {0, 1}), 0},
+        {"swap of blocks", SlotPlanner::swapRanges(N, 0, 10, 5), occupiedSlots(N, {0, 1, 2, 3, 4, 10, 11, 12}), 13},
+        {"move down, 3-cycle", SlotPlanner::moveRange(N, 4, 1, 2), occupiedSlots(N, {2, 3, 4}), 4},
+        {"move block up", SlotPlanner::moveRange(N, 0, 3, 6), occupiedSlots(N, {0, 1, 2, 3, 4, 5, 6, 7, 8}), 12},
+        {"rotation through every slot, full pedal", longCycle, allOccupied(N), N + 1},
+        {"rotation through every slot, one empty", longCycle, occupiedSlots(N, {0, 1, 2, 3, 50}), 7},
+        {"cycle through an empty slot", SlotPlanner::moveRange(N, 9, 1, 0), occupiedSlots(N, {0, 1, 2, 3}), 5},
+        {"insert gap before a block", SlotPlanner::insertGap(occupiedSlots(N, {0, 1, 2, 3}), 1), occupiedSlots(N, {0, 1, 2, 3}), 4},
+    };
+
+    for (const Case& c : cases) {
+        CHECK(SlotPlanner::isPermutation(c.source));
+        if (!replay(c.name, c.source, c.occupied)) failures++;
+        size_t steps = SlotPlanner::plan(c.source, c.occupied).size();
+        if (steps != c.steps) {
+            fprintf(stderr, "%s: %zu steps, expected %zu\n", c.name, steps, c.steps);
+            failures++;
+        }
+    }
+}
+
+void testRangeHelpers() {
+    CHECK(SlotPlanner::moveRange(5, 1, 2, 3) == std::vector<int>({0, 3, 4, 1, 2}));
+    CHECK(SlotPlanner::moveRange(5, 3, 1, 0) == std::vector<int>({3, 0, 1, 2, 4}));
+    CHECK(SlotPlanner::swapRanges(6, 0, 3, 3) == std::vector<int>({3, 4, 5, 0, 1, 2}));
+    CHECK(SlotPlanner::insertGap({true, true, false, true}, 0) == std::vector<int>({2, 0, 1, 3}));
+    CHECK(SlotPlanner::insertGap({true, false, true}, 1) == std::vector<int>({0, 1, 2}));
+    // Full from `at` on: nowhere to shift into
+    CHECK(SlotPlanner::insertGap({false, true, true}, 1).empty());
+    CHECK(SlotPlanner::insertGap(allOccupied(Protocol::MAX_TRACKS), 0).empty());
+}
+
+void testRejected() {
+    auto throws = [](auto f) {
+        try {
+            f();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    CHECK(throws([] { SlotPlanner::moveRange(5, 4, 2, 0); }));
+    CHECK(throws([] { SlotPlanner::moveRange(5, 0, 1, 5); }));
+    CHECK(throws([] { SlotPlanner::swapRanges(6, 0, 2, 3); }));
+    CHECK(throws([] { SlotPlanner::insertGap({true, true}, 2); }));
+    CHECK(throws([] { SlotPlanner::plan({0, 0, 2}, occupiedSlots(3, {0})); }));
+    CHECK(throws([] { SlotPlanner::plan({1, 0}, occupiedSlots(3, {0})); }));
+}
+}
+
+int main() {
+    testPlans();
+    testRangeHelpers();
+    testRejected();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "All checks passed\n");
+    return 0;
+}
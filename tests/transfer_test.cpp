@@ -0,0 +1,172 @@
+// Round trips of the transfer engine against the emulated pedal, with and without
+// injected faults. Run by ctest; exits non-zero and names the failed check otherwise.
+//   transfer_test
+
+#include "audio_utils.h"
+#include "emulated_pedal.h"
+#include "metrics.h"
+#include "operations.h"
+#include "protocol.h"
+#include "usb_device.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+int failures = 0;
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+// Attaches a fresh emulated pedal; `pedal` stays valid while `device` is attached
+EmulatedPedal* attach(USBDevice& device, const EmulatedPedal::Options& options) {
+    auto transport = std::make_unique<EmulatedPedal>(options);
+    EmulatedPedal* pedal = transport.get();
+    device.attach(std::move(transport), EmulatedPedal::serial());
+    return pedal;
+}
+
+EmulatedPedal::Options twoTracks() {
+    EmulatedPedal::Options options;
+    options.tracks = 2;
+    options.trackSeconds = 1.0;
+    return options;
+}
+
+void testList() {
+    USBDevice device;
+    EmulatedPedal* pedal = attach(device, twoTracks());
+    std::vector<TrackInfo> tracks = device.listTracks();
+    CHECK((int)tracks.size() == Protocol::MAX_TRACKS);
+    CHECK(tracks[0].has_track && tracks[0].size == (uint32_t)pedal->track(0).size());
+    CHECK(tracks[1].has_track);
+    CHECK(!tracks[2].has_track);
+}
+
+void testDownload() {
+    USBDevice device;
+    EmulatedPedal* pedal = attach(device, twoTracks());
+    CHECK(device.downloadTrackRaw(1) == pedal->track(1));
+
+    QTemporaryDir dir;
+    std::string path = QDir(dir.path()).filePath("slot0.wav").toStdString();
+    Operations::download(device, 0, path, AudioUtils::Wav24);
+    QFile wav(QString::fromStdString(path));
+    CHECK(wav.open(QIODevice::ReadOnly));
+    // 24-bit WAV data is the packed stream itself, after the 44-byte header
+    QByteArray track = pedal->track(0);
+    CHECK(wav.readAll().mid(44) == track.left(track.size() / 6 * 6));
+
+    bool threw = false;
+    try {
+        device.downloadTrackRaw(5);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+void testUploadAndDelete() {
+    USBDevice device;
+    EmulatedPedal* pedal = attach(device, twoTracks());
+
+    // Odd size, so the last chunk is padded
+    QByteArray packed = pedal->track(0).left(3 * 1024 + 600);
+    device.uploadTrackRaw(4, packed);
+    CHECK(pedal->track(4) == packed);
+    CHECK(device.queryTrack(4).size == (uint32_t)packed.size());
+    CHECK(device.downloadTrackRaw(4) == packed);
+
+    Operations::remove(device, 4);
+    CHECK(!pedal->hasTrack(4));
+    CHECK(!device.listTracks()[4].has_track);
+}
+
+void testUnansweredQuery() {
+    // An empty slot answers; a lost link does not, and must not read as an empty slot
+    USBDevice device;
+    attach(device, twoTracks());
+    bool answered = false;
+    CHECK(!device.queryTrack(5, &answered).has_track);
+    CHECK(answered);
+
+    EmulatedPedal::Options options = twoTracks();
+    options.timeoutRate = 1.0;
+    USBDevice silent;
+    attach(silent, options);
+    CHECK(!silent.queryTrack(0, &answered).has_track);
+    CHECK(!answered);
+}
+
+void testLateReplies() {
+    // A reply arriving after the chunk timeout must be cleared before the chunk is asked for
+    // again: left in the queue, it would shift every later chunk by one
+    EmulatedPedal::Options options = twoTracks();
+    options.lateRate = 0.2;
+    options.lateBy = std::chrono::milliseconds(60);
+    options.seed = 3;
+    USBDevice device;
+    EmulatedPedal* pedal = attach(device, options);
+    device.setChunkTimeout(20);
+    Metrics::Counter& retries = Metrics::counter("mooer_usb_chunk_retries_total");
+    uint64_t retriesBefore = retries.value.load();
+
+    CHECK(device.downloadTrackRaw(0) == pedal->track(0));
+    CHECK(device.downloadTrackRaw(1) == pedal->track(1));
+    CHECK(pedal->stats().lateReplies > 0);
+    CHECK(retries.value.load() > retriesBefore);
+}
+
+void testInjectedFaults() {
+    // Lost commands and failed transfers may fail a download, but never shorten or shift it
+    int completed = 0;
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+        EmulatedPedal::Options options = twoTracks();
+        options.errorRate = 0.002;
+        options.timeoutRate = 0.002;
+        options.seed = seed;
+        USBDevice device;
+        EmulatedPedal* pedal = attach(device, options);
+        device.setChunkTimeout(20);
+        try {
+            QByteArray data = device.downloadTrackRaw(0);
+            CHECK(data == pedal->track(0));
+            completed++;
+        } catch (const std::runtime_error&) {
+        }
+    }
+    CHECK(completed > 0);
+}
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    // Keeps the mirror and settings the operations write out of the user's own
+    QStandardPaths::setTestModeEnabled(true);
+
+    testList();
+    testDownload();
+    testUploadAndDelete();
+    testUnansweredQuery();
+    testLateReplies();
+    testInjectedFaults();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "All checks passed\n");
+    return 0;
+}